@@ -0,0 +1,248 @@
+/*
+ * Accuracy-versus-cost regression harness
+ *
+ * Integrates a library of expressions whose integrals are known exactly, with every integration
+ * method, at 2, 4, 8, ... strips, and records how many evaluations of the expression each method
+ * needed before its relative error first fell below each of a set of tolerances. Those counts
+ * are compared against a stored baseline, and the harness fails if any method now needs more
+ * evaluations than it used to (or can no longer reach a tolerance at all), so that changes made
+ * for speed can't quietly cost accuracy.
+ *
+ * Usage: accuracy.out [--baseline file] [--curves]
+ *          --baseline file   compare against a previous run's output, exiting with a failure code
+ *                            on any regression
+ *          --curves          instead of the summary, print every (strips, evaluations, error)
+ *                            point as a line of JSON, e.g. for plotting
+ *
+ * The summary printed on stdout is in the same format as the baseline, so the baseline is
+ * regenerated with: ./accuracy.out > accuracy_baseline.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "parser.h"
+#include "integrate.h"
+#include "arena.h"
+
+#define MIN_STRIPS 2
+#define MAX_STRIPS (1L << 20) // give up on a tolerance past this many strips
+#define MAX_BASELINE_ENTRIES 1024
+
+// --- Type declarations ---
+
+struct Reference_Integral {
+    const char *name;
+    const char *expression;
+    double start, end;
+    double exact; // The value of the integral, worked out analytically
+};
+
+struct Method_Entry {
+    const char *name;
+    enum Integration_Method method;
+};
+
+struct Baseline_Entry {
+    char integral[64];
+    char method[32];
+    double tolerance;
+    long evaluations; // -1 if the tolerance wasn't reached
+};
+
+// --- Variable declarations ---
+
+// Integrals with closed forms. Between them they cover polynomials (which Simpson's rule
+// integrates exactly up to cubics), smooth transcendental functions, rapidly growing ones, a
+// derivative singularity at an end (sqrt) and a kink (abs).
+static const struct Reference_Integral integrals[] = {
+    { "linear", "x", 0, 100, 5000 },
+    { "quadratic", "4x^2 - 24x + 4.2", -2, 4, -22.8 },
+    { "quintic", "x^5 - 3x^3 + x", -1, 2, 0.75 },
+    { "sin_squared", "4(sin(x))^2 + 2", 4, 6, 9.525931164623817 }, // 8 - sin(12) + sin(8)
+    { "ln_exp", "4ln(x) + exp(2x)", 4, 10, 242581153.14859557 },
+    { "gaussian", "exp(-x^2)", 0, 1, 0.746824132812427 }, // sqrt(pi)/2 erf(1)
+    { "arctan_derivative", "1/(1 + x^2)", 0, 1, 0.7853981633974483 }, // pi/4
+    { "cos", "cos(x)", 0, 1.5707963267948966, 1 },
+    { "reciprocal", "1/x", 1, 2.718281828459045, 1 },
+    { "tanh", "tanh(x)", 0, 3, 2.309328504577785 }, // ln(cosh(3))
+    { "exp_cos", "exp(x)cos(x)", 0, 3.141592653589793, -12.070346316389633 }, // -(e^pi + 1)/2
+    { "sqrt", "sqrt(x)", 0, 1, 0.6666666666666666 },
+    { "abs", "abs(x)", -1, 2, 2.5 },
+};
+
+// Every integration method
+static const struct Method_Entry methods[] = {
+    { "simpson", Method_Simpson },
+    { "trapezium", Method_Trapezium },
+    { "richardson", Method_Richardson },
+    { "clenshaw-curtis", Method_Clenshaw_Curtis }, // strips is only its most intervals
+};
+
+// Relative errors that each method is asked to reach
+static const double tolerances[] = { 1e-3, 1e-6, 1e-9 };
+
+#define COUNT(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+/*
+ * ----------------------------------------------
+ * Function definitions
+ * ----------------------------------------------
+ */
+
+/*
+ * Function: load_baseline(path, entries)
+ *
+ * Description: Reads a baseline written by a previous run
+ * Parameters: path - the file
+ *             entries - array of MAX_BASELINE_ENTRIES entries to fill
+ * Returns: The number of entries read, or -1 if the file couldn't be opened
+ */
+
+static int load_baseline(const char *path, struct Baseline_Entry *entries) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) { return -1; }
+
+    char line[256];
+    int count = 0;
+    while (count < MAX_BASELINE_ENTRIES && fgets(line, sizeof(line), file) != NULL) {
+        struct Baseline_Entry *entry = &entries[count];
+        if (line[0] == '#') { continue; }
+        if (sscanf(line, "%63s %31s %lf %ld", entry->integral, entry->method, &entry->tolerance,
+                   &entry->evaluations) == 4) {
+            count++;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+/*
+ * Function: find_baseline(entries, count, integral, method, tolerance)
+ *
+ * Description: Finds the baseline entry for one integral, method and tolerance
+ * Parameters: entries, count - the baseline
+ *             integral, method, tolerance - what to look for
+ * Returns: Pointer to the entry, or NULL if there isn't one
+ */
+
+static const struct Baseline_Entry *find_baseline(const struct Baseline_Entry *entries, int count,
+                                                  const char *integral, const char *method,
+                                                  double tolerance) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(entries[i].integral, integral) == 0 && strcmp(entries[i].method, method) == 0 &&
+            fabs(entries[i].tolerance / tolerance - 1) < 1e-9) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    const char *baseline_path = NULL;
+    int print_curves = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--curves") == 0) {
+            print_curves = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--baseline file] [--curves]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    static struct Baseline_Entry baseline[MAX_BASELINE_ENTRIES];
+    int baseline_count = 0;
+    if (baseline_path != NULL) {
+        baseline_count = load_baseline(baseline_path, baseline);
+        if (baseline_count < 0) {
+            fprintf(stderr, "Could not read baseline '%s'\n", baseline_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct Arena arena;
+    if (arena_init(&arena, 64 * 1024) != 0) { return EXIT_FAILURE; }
+
+    int regressions = 0;
+    if (!print_curves) { printf("# integral method tolerance evaluations (-1: not reached)\n"); }
+
+    for (int i = 0; i < COUNT(integrals); i++) {
+        const struct Reference_Integral *integral = &integrals[i];
+
+        arena_reset(&arena);
+        struct Program program;
+        if (compile_expression(integral->expression, strlen(integral->expression), &arena,
+                               &program) <= 0) {
+            fprintf(stderr, "%s: could not compile '%s'\n", integral->name, integral->expression);
+            regressions++;
+            continue;
+        }
+
+        for (int m = 0; m < COUNT(methods); m++) {
+            long needed[COUNT(tolerances)]; // evaluations to reach each tolerance
+            int reached = 0;
+            for (int t = 0; t < COUNT(tolerances); t++) { needed[t] = -1; }
+
+            // Double the strips until every tolerance has been reached (or it is hopeless)
+            for (long strips = MIN_STRIPS; strips <= MAX_STRIPS && reached < COUNT(tolerances);
+                 strips *= 2) {
+                struct Integration_Options options = {
+                    .method = methods[m].method,
+                    .strips = strips,
+                    .force_numeric = 1 // the point is to measure the method
+                };
+                struct Integration_Result result;
+                integrate(&program, integral->start, integral->end, &options, &result, &arena);
+
+                double error = fabs(result.value - integral->exact) / fabs(integral->exact);
+
+                if (print_curves) {
+                    printf("{\"integral\": \"%s\", \"method\": \"%s\", \"strips\": %ld, "
+                           "\"evaluations\": %ld, \"relative_error\": %.3e}\n", integral->name,
+                           methods[m].name, strips, result.evaluations, error);
+                }
+
+                for (int t = 0; t < COUNT(tolerances); t++) {
+                    if (needed[t] < 0 && error <= tolerances[t]) {
+                        needed[t] = result.evaluations;
+                        reached++;
+                    }
+                }
+            }
+
+            for (int t = 0; t < COUNT(tolerances); t++) {
+                if (!print_curves) {
+                    printf("%-18s %-10s %.0e %8ld\n", integral->name, methods[m].name,
+                           tolerances[t], needed[t]);
+                }
+                if (baseline_path == NULL) { continue; }
+
+                const struct Baseline_Entry *entry = find_baseline(
+                    baseline, baseline_count, integral->name, methods[m].name, tolerances[t]);
+                if (entry == NULL) {
+                    fprintf(stderr, "note: %s/%s/%.0e is not in the baseline\n", integral->name,
+                            methods[m].name, tolerances[t]);
+                } else if (entry->evaluations >= 0 &&
+                           (needed[t] < 0 || needed[t] > entry->evaluations)) {
+                    fprintf(stderr, "REGRESSION %s/%s/%.0e: needed %ld evaluations, "
+                                    "baseline %ld\n", integral->name, methods[m].name,
+                            tolerances[t], needed[t], entry->evaluations);
+                    regressions++;
+                }
+            }
+        }
+    }
+
+    arena_free(&arena);
+
+    if (regressions > 0) {
+        fprintf(stderr, "%d regression(s)\n", regressions);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
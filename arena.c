@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include "arena.h"
+
+// Every allocation is rounded up to this so that any type can be stored at the returned address
+#define ARENA_ALIGNMENT 16
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/*
+ * ----------------------------------------------
+ * Function definitions
+ * ----------------------------------------------
+ */
+
+/*
+ * Function: new_block(arena, needed, capacity)
+ *
+ * Description: Makes a block the one that allocations come from: a spare one, if one has room for
+ *              what is needed, or else a new one
+ * Parameters: arena, the arena to add a block to
+ *             needed, the bytes the block must have room for
+ *             capacity, the size in bytes of a new block, if one is allocated (at least needed)
+ * Returns: 0 on success, -1 if the memory could not be allocated
+ */
+
+static int new_block(struct Arena *arena, size_t needed, size_t capacity) {
+    // Spare blocks first, so that repeatedly marking and releasing never calls malloc
+    struct Arena_Block **link = &arena->spare;
+    while (*link != NULL) {
+        if ((*link)->capacity >= needed) {
+            struct Arena_Block *block = *link;
+            *link = block->previous;
+            block->previous = arena->block;
+            block->used = 0;
+            arena->block = block;
+            return 0;
+        }
+        link = &(*link)->previous;
+    }
+
+    struct Arena_Block *block = malloc(sizeof(struct Arena_Block) + capacity);
+    if (block == NULL) { return -1; }
+
+    block->previous = arena->block;
+    block->used = 0;
+    block->capacity = capacity;
+
+    arena->block = block;
+    arena->total_capacity += capacity;
+    arena->block_allocations++;
+    return 0;
+}
+
+/*
+ * Function: free_blocks(block)
+ *
+ * Description: Frees a chain of blocks
+ * Parameters: block, the newest block of the chain
+ * Returns: none
+ */
+
+static void free_blocks(struct Arena_Block *block) {
+    while (block != NULL) {
+        struct Arena_Block *previous = block->previous;
+        free(block);
+        block = previous;
+    }
+}
+
+/*
+ * Function: arena_init(arena, capacity)
+ *
+ * Description: Allocates the first block of memory that an arena hands out
+ * Parameters: arena, the arena to initialize
+ *             capacity, the size of the first block in bytes (the arena grows past this if needed)
+ * Returns: 0 on success, -1 if the memory could not be allocated
+ */
+
+int arena_init(struct Arena *arena, size_t capacity) {
+    arena->block = NULL;
+    arena->spare = NULL;
+    arena->total_capacity = 0;
+    arena->block_allocations = 0;
+
+    return new_block(arena, ALIGN_UP(capacity), ALIGN_UP(capacity));
+}
+
+/*
+ * Function: arena_alloc(arena, size)
+ *
+ * Description: Hands out the next `size` bytes of the arena, moving on to a spare block if the
+ *              current one is full, or else adding one (at least twice the size of the current
+ *              one, so that blocks are added O(log n) times). The size comes from the current block
+ *              rather than the arena's total capacity, which counts the spares: otherwise every
+ *              mark, allocate and release on a full block would add a block bigger than all the
+ *              spares, and never reuse them.
+ * Parameters: arena, the arena to allocate from
+ *             size, the number of bytes wanted
+ * Returns: Pointer to the memory, or NULL if it couldn't be allocated
+ */
+
+void *arena_alloc(struct Arena *arena, size_t size) {
+    size_t aligned = ALIGN_UP(size);
+
+    if (arena->block == NULL || aligned > arena->block->capacity - arena->block->used) {
+        size_t capacity = (arena->block != NULL) ? 2 * arena->block->capacity : 0;
+        if (capacity < aligned) { capacity = aligned; }
+        if (new_block(arena, aligned, capacity) != 0) { return NULL; }
+    }
+
+    void *ptr = arena->block->memory + arena->block->used;
+    arena->block->used += aligned;
+
+    return ptr;
+}
+
+/*
+ * Function: arena_mark(arena)
+ *
+ * Description: Records the current position of an arena, so that scratch memory allocated after
+ *              this point can be handed back with arena_release()
+ * Parameters: arena, the arena
+ * Returns: The position
+ */
+
+struct Arena_Mark arena_mark(struct Arena *arena) {
+    struct Arena_Mark mark = {
+        .block = arena->block,
+        .used = (arena->block == NULL) ? 0 : arena->block->used
+    };
+    return mark;
+}
+
+/*
+ * Function: arena_release(arena, mark)
+ *
+ * Description: Hands back everything allocated since arena_mark() returned `mark`. Blocks that
+ *              were added since then are kept as spares rather than freed.
+ * Parameters: arena, the arena
+ *             mark, a position returned by arena_mark() on this arena since its last reset
+ * Returns: none
+ */
+
+void arena_release(struct Arena *arena, struct Arena_Mark mark) {
+    while (arena->block != mark.block) {
+        struct Arena_Block *block = arena->block;
+        arena->block = block->previous;
+        block->previous = arena->spare;
+        arena->spare = block;
+    }
+
+    if (arena->block != NULL) { arena->block->used = mark.used; }
+}
+
+/*
+ * Function: arena_reset(arena)
+ *
+ * Description: Hands back everything allocated from an arena, ready for the next request. This is
+ *              O(1) unless the arena had to grow, in which case its blocks are replaced by one
+ *              block big enough for all of them, so that the next request of the same size fits
+ *              without growing.
+ * Parameters: arena, the arena to reset
+ * Returns: none
+ */
+
+void arena_reset(struct Arena *arena) {
+    if (arena->block != NULL && arena->block->previous == NULL && arena->spare == NULL) {
+        arena->block->used = 0;
+        return;
+    }
+
+    size_t capacity = arena->total_capacity;
+    long block_allocations = arena->block_allocations;
+
+    free_blocks(arena->block);
+    free_blocks(arena->spare);
+
+    if (arena_init(arena, capacity) != 0) {
+        arena_init(arena, 0); // keep the arena usable, if empty
+    }
+    arena->block_allocations += block_allocations;
+}
+
+/*
+ * Function: arena_free(arena)
+ *
+ * Description: Frees all of an arena's memory, and with it everything that was allocated from it
+ * Parameters: arena, the arena to free
+ * Returns: none
+ */
+
+void arena_free(struct Arena *arena) {
+    free_blocks(arena->block);
+    free_blocks(arena->spare);
+    arena->block = NULL;
+    arena->spare = NULL;
+    arena->total_capacity = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED // Include guards
+
+#include <stddef.h> // size_t
+
+// ------ Arena (bump) allocator ------
+// Memory handed out front to back from large blocks. Nothing is freed individually: everything
+// allocated from an arena goes away together when the arena is reset (to be reused for the next
+// request) or freed. An arena grows by adding blocks when it runs out, and a reset merges those
+// into a single block, so once an arena has seen its largest request it never calls malloc again.
+
+// --- Type declarations ---
+
+struct Arena_Block {
+    struct Arena_Block *previous; // Block that was current before this one
+    size_t used; // Bytes handed out so far
+    size_t capacity; // Bytes available in memory[]
+    char memory[];
+};
+
+struct Arena {
+    struct Arena_Block *block; // Block currently being allocated from
+    struct Arena_Block *spare; // Emptied blocks kept for reuse (see arena_release)
+    size_t total_capacity; // Sum of the capacity of every block, including spares
+    long block_allocations; // Number of times the arena has called malloc
+};
+
+// Position in an arena to return to with arena_release()
+struct Arena_Mark {
+    struct Arena_Block *block;
+    size_t used;
+};
+
+// --- Function declarations ---
+
+int arena_init(struct Arena *arena, size_t capacity);
+void *arena_alloc(struct Arena *arena, size_t size);
+struct Arena_Mark arena_mark(struct Arena *arena);
+void arena_release(struct Arena *arena, struct Arena_Mark mark);
+void arena_reset(struct Arena *arena);
+void arena_free(struct Arena *arena);
+
+#endif
@@ -0,0 +1,764 @@
+/*
+ * Microbenchmarks for the integration pipeline
+ *
+ * Times each stage of the pipeline (exp_to_tokens, shunting_yard, the fused compile_expression,
+ * evaluate_rpn) and whole integrations over a corpus of representative expressions, from short
+ * polynomials to generated expressions over 100KB long.
+ *
+ * Each benchmark is run for a few warmup repetitions, then for a number of timed repetitions. A
+ * repetition times a batch of operations sized so that it takes roughly REP_TARGET_NS, and the
+ * median and 99th percentile of the per-repetition ns/op are reported. Output is one JSON object
+ * per line on stdout, so that results from two releases can be compared by a script, or by this
+ * program itself with --baseline.
+ *
+ * Usage: bench.out [--reps N] [--filter text] [--baseline file] [--threshold percent]
+ *          --reps N          timed repetitions per benchmark (default 31)
+ *          --filter text     only run benchmarks whose name or expression name contains text
+ *          --baseline file   compare medians against a previous run's output, and exit with
+ *                            a failure code if any got slower by more than the threshold
+ *          --threshold p     allowed slowdown in percent for --baseline (default 10)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tokenize.h"
+#include "shunting.h"
+#include "parser.h"
+#include "integrate.h"
+#include "chebyshev.h"
+#include "program_file.h"
+#include "fused.h"
+#include "sweep.h"
+#include "codegen.h"
+#include "threaded.h"
+#include "result_cache.h"
+#include "arena.h"
+#include "token.h"
+
+#define WARMUP_REPS 3
+#define DEFAULT_REPS 31
+#define REP_TARGET_NS 2000000.0 // aim for ~2ms per repetition
+#define MAX_REPS 1001
+#define MAX_BASELINE_ENTRIES 1024
+#define BENCH_STRIPS 100 // strips per integration, kept low so that the longest expressions finish
+#define FAMILY_SIZE 100 // expressions integrated together by the fused benchmarks
+#define SWEEP_SETS 64 // sets of parameter values integrated by the sweep benchmarks
+
+// --- Type declarations ---
+
+struct Corpus_Entry {
+    const char *name;
+    char *expression;
+    size_t length;
+};
+
+// One operation to time. `run` performs it `iterations` times and returns how many evaluations of
+// the expression that took (0 for stages that don't evaluate).
+struct Benchmark {
+    const char *name;
+    long (*run)(struct Corpus_Entry *entry, long iterations);
+};
+
+struct Baseline_Entry {
+    char key[160];
+    double median;
+};
+
+// --- Variable declarations ---
+
+// Working memory shared by the benchmarks, reset between repetitions
+static struct Arena bench_arena;
+
+// Holds the expressions compiled by compile_family(), which outlive the repetitions
+static struct Arena family_arena;
+
+// Native kernels for integrate_aot, kept in the usual cache directory so that only the first run
+// compiles them (NULL if it couldn't be opened)
+static struct Kernel_Cache *kernel_cache;
+
+// Results for integrate_cached, in a file of its own that is deleted at the end
+static struct Result_Cache result_cache;
+static char result_cache_path[64];
+
+// Keeps the compiler from optimizing away results that are otherwise unused
+static volatile double sink;
+
+/*
+ * ----------------------------------------------
+ * Corpus
+ * ----------------------------------------------
+ */
+
+/*
+ * Function: generate_polynomial(terms)
+ *
+ * Description: Generates an expanded polynomial such as a fitted series would produce,
+ *              e.g. "0.5 + 1.25x - 0.75x^2 + ..."
+ * Parameters: terms - number of terms
+ * Returns: Heap-allocated expression string
+ */
+
+static char *generate_polynomial(int terms) {
+    size_t capacity = (size_t)terms * 32 + 1;
+    char *buffer = malloc(capacity);
+    size_t used = 0;
+
+    for (int i = 0; i < terms; i++) {
+        double coefficient = ((i * 7919) % 1000) / 1000.0 + 0.001;
+        used += snprintf(buffer + used, capacity - used, "%s%.3fx^%d",
+                         (i == 0) ? "" : ((i % 2) ? " - " : " + "), coefficient, i % 12);
+    }
+
+    return buffer;
+}
+
+/*
+ * Function: generate_series(terms)
+ *
+ * Description: Generates a long transcendental series,
+ *              e.g. "0.5sin(1x) + 0.25cos(2x) + exp(-x/3)/4 + ..."
+ * Parameters: terms - number of terms
+ * Returns: Heap-allocated expression string
+ */
+
+static char *generate_series(int terms) {
+    size_t capacity = (size_t)terms * 48 + 1;
+    char *buffer = malloc(capacity);
+    size_t used = 0;
+
+    for (int i = 0; i < terms; i++) {
+        const char *separator = (i == 0) ? "" : " + ";
+        switch (i % 3) {
+            case 0:
+                used += snprintf(buffer + used, capacity - used, "%s0.%dsin(%dx)", separator,
+                                 (i % 9) + 1, i % 17 + 1);
+                break;
+            case 1:
+                used += snprintf(buffer + used, capacity - used, "%s0.%dcos(%dx)", separator,
+                                 (i % 7) + 1, i % 13 + 1);
+                break;
+            default:
+                used += snprintf(buffer + used, capacity - used, "%sexp(-x/%d)/%d", separator,
+                                 i % 11 + 1, i % 5 + 2);
+                break;
+        }
+    }
+
+    return buffer;
+}
+
+/*
+ * Function: build_corpus(count)
+ *
+ * Description: Builds the corpus of expressions to benchmark
+ * Parameters: count - where the number of entries is written
+ * Returns: Heap-allocated array of entries
+ */
+
+static struct Corpus_Entry *build_corpus(int *count) {
+    static const struct { const char *name; const char *expression; } fixed[] = {
+        { "linear", "x" },
+        { "quadratic", "4x^2 - 24x + 4.2" },
+        { "cubic_nested", "((2x - 3)x + 1)x - 5" },
+        { "trig", "4(sin(x))^2 + 2" },
+        { "transcendental", "4ln(x) + exp(2x)" },
+        { "mixed", "sqrt(x)exp(-x^2/2)cos(3x) + atan(x)/(1 + x^2)" },
+        { "hyperbolic", "tanh(x) - sinh(x/2)cosh(x/2) + pi*e" },
+    };
+    int fixed_count = sizeof(fixed) / sizeof(fixed[0]);
+
+    *count = fixed_count + 3;
+    struct Corpus_Entry *corpus = malloc(*count * sizeof(struct Corpus_Entry));
+
+    for (int i = 0; i < fixed_count; i++) {
+        corpus[i].name = fixed[i].name;
+        corpus[i].expression = strdup(fixed[i].expression);
+    }
+    corpus[fixed_count].name = "poly_100_terms";
+    corpus[fixed_count].expression = generate_polynomial(100);
+    corpus[fixed_count + 1].name = "series_2k_terms";
+    corpus[fixed_count + 1].expression = generate_series(2000);
+    corpus[fixed_count + 2].name = "poly_10k_terms"; // over 100KB
+    corpus[fixed_count + 2].expression = generate_polynomial(10000);
+
+    for (int i = 0; i < *count; i++) {
+        corpus[i].length = strlen(corpus[i].expression);
+    }
+
+    return corpus;
+}
+
+/*
+ * ----------------------------------------------
+ * Benchmarks
+ * ----------------------------------------------
+ */
+
+static long run_tokenize(struct Corpus_Entry *entry, long iterations) {
+    size_t size = max_tokens_for_length(entry->length) * sizeof(struct Token);
+    struct Token *tokens = arena_alloc(&bench_arena, size);
+    for (long i = 0; i < iterations; i++) {
+        sink = exp_to_tokens(entry->expression, entry->length, tokens);
+    }
+    return 0;
+}
+
+static long run_shunting(struct Corpus_Entry *entry, long iterations) {
+    size_t size = max_tokens_for_length(entry->length) * sizeof(struct Token);
+    struct Token *tokens = arena_alloc(&bench_arena, size);
+    struct Token *rpn = arena_alloc(&bench_arena, size);
+    int count = exp_to_tokens(entry->expression, entry->length, tokens);
+
+    for (long i = 0; i < iterations; i++) {
+        struct Arena_Mark mark = arena_mark(&bench_arena);
+        sink = shunting_yard(tokens, count, rpn, &bench_arena);
+        arena_release(&bench_arena, mark);
+    }
+    return 0;
+}
+
+static long run_compile(struct Corpus_Entry *entry, long iterations) {
+    struct Program program;
+    for (long i = 0; i < iterations; i++) {
+        struct Arena_Mark mark = arena_mark(&bench_arena);
+        sink = compile_expression(entry->expression, entry->length, &bench_arena, &program);
+        arena_release(&bench_arena, mark);
+    }
+    return 0;
+}
+
+// Times taking the expression out of a program file, which is what a batch job using --programs
+// costs instead of compile_expression. The file is saved once per expression, not per run, and
+// deleted as soon as it is mapped.
+static long run_load_program(struct Corpus_Entry *entry, long iterations) {
+    static const char *path = "bench_programs.tmp";
+    static struct Corpus_Entry *saved_entry = NULL;
+    static struct Program_File file;
+    struct Program program;
+
+    if (entry != saved_entry) {
+        if (saved_entry != NULL) { program_file_close(&file); }
+        saved_entry = NULL;
+        compile_expression(entry->expression, entry->length, &bench_arena, &program);
+        const char *text = entry->expression;
+        int error = program_file_write(path, &program, &text, &entry->length, 1);
+        if (error == 0) { error = program_file_open(path, &file); }
+        remove(path);
+        if (error != 0) { return 0; }
+        saved_entry = entry;
+    }
+
+    for (long i = 0; i < iterations; i++) {
+        sink = program_file_program(&file, 0, &program);
+    }
+    return 0;
+}
+
+static long run_evaluate(struct Corpus_Entry *entry, long iterations) {
+    struct Program program;
+    compile_expression(entry->expression, entry->length, &bench_arena, &program);
+
+    double x = 0.5;
+    double total = 0;
+    for (long i = 0; i < iterations; i++) {
+        total += evaluate_rpn(program.code, program.length, x, &bench_arena);
+        x += 1e-6; // don't let the same x be evaluated every time
+    }
+    sink = total;
+    return iterations;
+}
+
+// The same with the threaded evaluator, translating once as a caller evaluating often would
+static long run_threaded(struct Corpus_Entry *entry, long iterations) {
+    struct Program program;
+    compile_expression(entry->expression, entry->length, &bench_arena, &program);
+    struct Threaded_Instruction *code = arena_alloc(&bench_arena, (program.length + 1) *
+                                                    sizeof(struct Threaded_Instruction));
+    struct Threaded_Program threaded;
+    threaded_compile(&program, code, &threaded);
+
+    double x = 0.5;
+    double total = 0;
+    for (long i = 0; i < iterations; i++) {
+        total += evaluate_threaded(&threaded, x, &bench_arena);
+        x += 1e-6;
+    }
+    sink = total;
+    return iterations;
+}
+
+static long run_integrate(struct Corpus_Entry *entry, long iterations,
+                          enum Integration_Method method, enum Integration_Precision precision,
+                          int force_numeric) {
+    struct Program program;
+    compile_expression(entry->expression, entry->length, &bench_arena, &program);
+
+    struct Integration_Options options = {
+        .method = method,
+        .strips = BENCH_STRIPS,
+        .precision = precision,
+        .force_numeric = force_numeric
+    };
+    struct Integration_Result result;
+    long evaluations = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        integrate(&program, 1, 2, &options, &result, &bench_arena);
+        sink = result.value;
+        evaluations += result.evaluations;
+    }
+    return evaluations;
+}
+
+// integrate_simpson with the expression compiled to native code (see codegen.h). Getting the
+// kernel is timed too, but after the first repetition it is only a lookup.
+static long run_aot(struct Corpus_Entry *entry, long iterations) {
+    struct Program program;
+    compile_expression(entry->expression, entry->length, &bench_arena, &program);
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS,
+        .force_numeric = 1,
+        .kernel = kernel_cache_get(kernel_cache, &program, 1, 2, &bench_arena)
+    };
+    struct Integration_Result result;
+    long evaluations = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        integrate(&program, 1, 2, &options, &result, &bench_arena);
+        sink = result.value;
+        evaluations += result.evaluations;
+    }
+    return evaluations;
+}
+
+// integrate_simpson answered from the result cache (see result_cache.h), as a job repeated from an
+// earlier run would be: making the key and looking it up, without evaluating anything
+static long run_cached(struct Corpus_Entry *entry, long iterations) {
+    struct Program program;
+    compile_expression(entry->expression, entry->length, &bench_arena, &program);
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS,
+        .force_numeric = 1
+    };
+    struct Integration_Result result;
+    struct Result_Cache_Key key;
+    int status;
+
+    result_cache_key(&key, &program, 1, 2, &options);
+    if (result_cache.memory != NULL &&
+        !result_cache_lookup(&result_cache, &key, &result, &status)) {
+        status = integrate(&program, 1, 2, &options, &result, &bench_arena);
+        result_cache_store(&result_cache, &key, &result, status);
+    }
+
+    for (long i = 0; i < iterations && result_cache.memory != NULL; i++) {
+        result_cache_key(&key, &program, 1, 2, &options);
+        result_cache_lookup(&result_cache, &key, &result, &status);
+        sink = result.value;
+    }
+    return 0; // nothing was evaluated
+}
+
+static long run_simpson(struct Corpus_Entry *entry, long iterations) {
+    return run_integrate(entry, iterations, Method_Simpson, Precision_Double, 1);
+}
+
+static long run_trapezium(struct Corpus_Entry *entry, long iterations) {
+    return run_integrate(entry, iterations, Method_Trapezium, Precision_Double, 1);
+}
+
+static long run_simpson_float(struct Corpus_Entry *entry, long iterations) {
+    return run_integrate(entry, iterations, Method_Simpson, Precision_Float, 1);
+}
+
+// Clenshaw-Curtis quadrature stops once it has converged, so this usually evaluates far fewer
+// points than BENCH_STRIPS
+static long run_clenshaw_curtis(struct Corpus_Entry *entry, long iterations) {
+    return run_integrate(entry, iterations, Method_Clenshaw_Curtis, Precision_Double, 1);
+}
+
+// Polynomials take the exact path; anything else is the same as integrate_simpson
+static long run_exact(struct Corpus_Entry *entry, long iterations) {
+    return run_integrate(entry, iterations, Method_Simpson, Precision_Double, 0);
+}
+
+// Integrates over sub-ranges of [1, 2] with a surrogate fitted once per run, so this is the cost
+// of a repeated query (plus the fit, spread over the iterations)
+static long run_surrogate(struct Corpus_Entry *entry, long iterations) {
+    struct Program program;
+    compile_expression(entry->expression, entry->length, &bench_arena, &program);
+
+    struct Chebyshev_Surrogate surrogate;
+    int fitted = chebyshev_fit(&program, 1, 2, 0, &surrogate, &bench_arena) == 0;
+    long evaluations = surrogate.evaluations;
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS,
+        .surrogate = fitted ? &surrogate : NULL,
+        .force_numeric = 1 // or polynomials would skip the surrogate
+    };
+    struct Integration_Result result;
+
+    for (long i = 0; i < iterations; i++) {
+        integrate(&program, 1, 2 - (i % 1000) * 1e-4, &options, &result, &bench_arena);
+        sink = result.value;
+        evaluations += result.evaluations;
+    }
+
+    chebyshev_free(&surrogate);
+    return evaluations;
+}
+
+// Compiles a family of FAMILY_SIZE related expressions, (expression) x^k for k = 0, 1, ..., like
+// the basis functions of a fit, and fuses them. As with run_load_program, this is done once per
+// expression rather than per run, so that only the integrations are timed.
+static const struct Program *compile_family(struct Corpus_Entry *entry,
+                                            const struct Fused_Program **fused) {
+    static struct Corpus_Entry *compiled_entry = NULL;
+    static struct Program programs[FAMILY_SIZE];
+    static struct Fused_Program fused_program;
+
+    if (entry != compiled_entry) {
+        arena_reset(&family_arena);
+        char *text = arena_alloc(&family_arena, entry->length + 32);
+        for (int k = 0; k < FAMILY_SIZE; k++) {
+            int length = snprintf(text, entry->length + 32, "(%s) x^%d", entry->expression, k);
+            compile_expression(text, length, &family_arena, &programs[k]);
+        }
+        fused_compile(programs, FAMILY_SIZE, &fused_program, &family_arena);
+        compiled_entry = entry;
+    }
+
+    *fused = &fused_program;
+    return programs;
+}
+
+// Integrates the family one expression at a time, to compare with run_fused
+static long run_separate(struct Corpus_Entry *entry, long iterations) {
+    const struct Fused_Program *fused;
+    const struct Program *programs = compile_family(entry, &fused);
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS,
+        .force_numeric = 1
+    };
+    struct Integration_Result result;
+    long evaluations = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        for (int k = 0; k < FAMILY_SIZE; k++) {
+            integrate(&programs[k], 1, 2, &options, &result, &bench_arena);
+            sink = result.value;
+            evaluations += result.evaluations;
+        }
+    }
+    return evaluations;
+}
+
+// Integrates the family all at once, so the expression they share is evaluated once per point
+static long run_fused(struct Corpus_Entry *entry, long iterations) {
+    const struct Fused_Program *fused;
+    compile_family(entry, &fused);
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS
+    };
+    struct Integration_Result results[FAMILY_SIZE];
+    long evaluations = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        integrate_fused(fused, 1, 2, &options, results, NULL, &bench_arena);
+        sink = results[FAMILY_SIZE - 1].value;
+        for (int k = 0; k < FAMILY_SIZE; k++) { evaluations += results[k].evaluations; }
+    }
+    return evaluations;
+}
+
+// The parameter values used by the sweep benchmarks: set i is a = 1 + i/64, b = i/64
+static void sweep_parameters(double *parameters) {
+    for (int i = 0; i < SWEEP_SETS; i++) {
+        parameters[2 * i] = 1 + i / 64.0;
+        parameters[2 * i + 1] = i / 64.0;
+    }
+}
+
+// What a sweep replaces: writing each set's values into a (expression) + b x, compiling it and
+// integrating it
+static long run_sweep_strings(struct Corpus_Entry *entry, long iterations) {
+    double parameters[2 * SWEEP_SETS];
+    sweep_parameters(parameters);
+    size_t size = entry->length + 64;
+    char *text = arena_alloc(&bench_arena, size);
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS,
+        .force_numeric = 1
+    };
+    struct Integration_Result result;
+    long evaluations = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        for (int set = 0; set < SWEEP_SETS; set++) {
+            struct Arena_Mark mark = arena_mark(&bench_arena);
+            int length = snprintf(text, size, "%.17g (%s) + %.17g x", parameters[2 * set],
+                                  entry->expression, parameters[2 * set + 1]);
+            struct Program program;
+            compile_expression(text, length, &bench_arena, &program);
+            integrate(&program, 1, 2, &options, &result, &bench_arena);
+            sink = result.value;
+            evaluations += result.evaluations;
+            arena_release(&bench_arena, mark);
+        }
+    }
+    return evaluations;
+}
+
+// The same integrals as one sweep, in one thread, compiling the expression once
+static long run_sweep(struct Corpus_Entry *entry, long iterations) {
+    double parameters[2 * SWEEP_SETS];
+    sweep_parameters(parameters);
+    static const char *const names[] = { "a", "b" };
+    size_t size = entry->length + 16;
+    char *text = arena_alloc(&bench_arena, size);
+
+    struct Integration_Options options = {
+        .method = Method_Simpson,
+        .strips = BENCH_STRIPS
+    };
+    double values[SWEEP_SETS];
+    struct Sweep_Summary summary;
+    long evaluations = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        struct Arena_Mark mark = arena_mark(&bench_arena);
+        int length = snprintf(text, size, "a (%s) + b x", entry->expression);
+        struct Program program;
+        compile_parameterized(text, length, names, 2, &bench_arena, &program);
+        sweep_integrate(&program, parameters, 2, SWEEP_SETS, 1, 2, &options, 1, values, NULL,
+                        &summary);
+        sink = values[SWEEP_SETS - 1];
+        evaluations += summary.evaluations;
+        arena_release(&bench_arena, mark);
+    }
+    return evaluations;
+}
+
+static const struct Benchmark benchmarks[] = {
+    { "exp_to_tokens", run_tokenize },
+    { "shunting_yard", run_shunting },
+    { "compile_expression", run_compile },
+    { "load_program", run_load_program },
+    { "evaluate_rpn", run_evaluate },
+    { "evaluate_threaded", run_threaded },
+    { "integrate_simpson", run_simpson },
+    { "integrate_trapezium", run_trapezium },
+    { "integrate_simpson_float", run_simpson_float },
+    { "integrate_clenshaw_curtis", run_clenshaw_curtis },
+    { "integrate_aot", run_aot },
+    { "integrate_cached", run_cached },
+    { "integrate_surrogate", run_surrogate },
+    { "integrate_exact", run_exact },
+    { "integrate_separate", run_separate },
+    { "integrate_fused", run_fused },
+    { "sweep_strings", run_sweep_strings },
+    { "sweep", run_sweep },
+};
+
+/*
+ * ----------------------------------------------
+ * Timing and reporting
+ * ----------------------------------------------
+ */
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/*
+ * Function: time_repetition(benchmark, entry, iterations, ns_per_op, evaluations)
+ *
+ * Description: Times one repetition of a benchmark
+ * Parameters: benchmark, entry - what to run
+ *             iterations - how many operations to time
+ *             ns_per_op - where the average time per operation is written
+ *             evaluations - where the number of evaluations per operation is written
+ * Returns: none
+ */
+
+static void time_repetition(const struct Benchmark *benchmark, struct Corpus_Entry *entry,
+                            long iterations, double *ns_per_op, double *evaluations) {
+    arena_reset(&bench_arena);
+    double begin = now_ns();
+    long evals = benchmark->run(entry, iterations);
+    double elapsed = now_ns() - begin;
+
+    *ns_per_op = elapsed / iterations;
+    *evaluations = (double)evals / iterations;
+}
+
+/*
+ * Function: load_baseline(path, entries)
+ *
+ * Description: Reads the medians out of a previous run's output
+ * Parameters: path - the file written by a previous run
+ *             entries - array of MAX_BASELINE_ENTRIES entries to fill
+ * Returns: The number of entries read, or -1 if the file couldn't be opened
+ */
+
+static int load_baseline(const char *path, struct Baseline_Entry *entries) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) { return -1; }
+
+    char line[1024];
+    char benchmark[64], expression[64];
+    int count = 0;
+
+    while (count < MAX_BASELINE_ENTRIES && fgets(line, sizeof(line), file) != NULL) {
+        double median;
+        if (sscanf(line, "{\"benchmark\": \"%63[^\"]\", \"expression\": \"%63[^\"]\", "
+                         "\"length\": %*d, \"reps\": %*d, \"iterations\": %*d, "
+                         "\"ns_per_op_median\": %lf", benchmark, expression, &median) == 3) {
+            snprintf(entries[count].key, sizeof(entries[count].key), "%s/%s", benchmark,
+                     expression);
+            entries[count].median = median;
+            count++;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    int reps = DEFAULT_REPS;
+    const char *filter = NULL;
+    const char *baseline_path = NULL;
+    double threshold = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--reps N] [--filter text] [--baseline file] "
+                            "[--threshold percent]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (reps < 1) { reps = 1; }
+    if (reps > MAX_REPS) { reps = MAX_REPS; }
+
+    static struct Baseline_Entry baseline[MAX_BASELINE_ENTRIES];
+    int baseline_count = 0;
+    if (baseline_path != NULL) {
+        baseline_count = load_baseline(baseline_path, baseline);
+        if (baseline_count < 0) {
+            fprintf(stderr, "Could not read baseline '%s'\n", baseline_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arena_init(&bench_arena, 1 << 20) != 0 || arena_init(&family_arena, 1 << 20) != 0) {
+        return EXIT_FAILURE;
+    }
+    kernel_cache = kernel_cache_open(NULL);
+    snprintf(result_cache_path, sizeof(result_cache_path), "/tmp/integration-bench-%ld.cache",
+             (long)getpid());
+    result_cache_open(result_cache_path, 1 << 20, &result_cache);
+
+    int corpus_count;
+    struct Corpus_Entry *corpus = build_corpus(&corpus_count);
+    int regressions = 0;
+
+    double samples[MAX_REPS];
+    int benchmark_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+    for (int b = 0; b < benchmark_count; b++) {
+        for (int c = 0; c < corpus_count; c++) {
+            const struct Benchmark *benchmark = &benchmarks[b];
+            struct Corpus_Entry *entry = &corpus[c];
+
+            if (filter != NULL && strstr(benchmark->name, filter) == NULL &&
+                strstr(entry->name, filter) == NULL) {
+                continue;
+            }
+
+            // Calibrate: double the batch size until one repetition takes long enough to time
+            double ns_per_op, evaluations;
+            long iterations = 1;
+            time_repetition(benchmark, entry, iterations, &ns_per_op, &evaluations);
+            while (ns_per_op * iterations < REP_TARGET_NS / 2 && iterations < (1L << 30)) {
+                iterations *= 2;
+                time_repetition(benchmark, entry, iterations, &ns_per_op, &evaluations);
+            }
+
+            for (int r = 0; r < WARMUP_REPS; r++) {
+                time_repetition(benchmark, entry, iterations, &ns_per_op, &evaluations);
+            }
+            for (int r = 0; r < reps; r++) {
+                time_repetition(benchmark, entry, iterations, &samples[r], &evaluations);
+            }
+
+            qsort(samples, reps, sizeof(double), compare_doubles);
+            double median = samples[reps / 2];
+            int p99_index = (int)(0.99 * (reps - 1) + 0.5);
+            double p99 = samples[p99_index];
+
+            printf("{\"benchmark\": \"%s\", \"expression\": \"%s\", \"length\": %zu, "
+                   "\"reps\": %d, \"iterations\": %ld, \"ns_per_op_median\": %.2f, "
+                   "\"ns_per_op_p99\": %.2f, \"ops_per_sec\": %.1f, \"evals_per_op\": %.0f, "
+                   "\"evals_per_sec\": %.1f}\n",
+                   benchmark->name, entry->name, entry->length, reps, iterations, median, p99,
+                   1e9 / median, evaluations, evaluations * 1e9 / median);
+            fflush(stdout);
+
+            // Compare against the baseline, if there is one
+            char key[160];
+            snprintf(key, sizeof(key), "%s/%s", benchmark->name, entry->name);
+            for (int i = 0; i < baseline_count; i++) {
+                if (strcmp(baseline[i].key, key) != 0) { continue; }
+
+                double change = (median / baseline[i].median - 1) * 100;
+                if (change > threshold) {
+                    fprintf(stderr, "REGRESSION %s: %.2f -> %.2f ns/op (+%.1f%%)\n", key,
+                            baseline[i].median, median, change);
+                    regressions++;
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < corpus_count; c++) { free(corpus[c].expression); }
+    free(corpus);
+    arena_free(&bench_arena);
+    arena_free(&family_arena);
+    kernel_cache_close(kernel_cache);
+    result_cache_close(&result_cache);
+    unlink(result_cache_path);
+
+    return (regressions > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
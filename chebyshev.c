@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <math.h>
+#include "chebyshev.h"
+#include "vector.h"
+
+// Accuracy used if the caller doesn't ask for one, relative to the largest |f| in the range
+#define DEFAULT_CHEBYSHEV_TOLERANCE 1e-12
+// Points used to estimate the largest |f| before fitting
+#define SCALE_POINTS 129
+// Most pieces a surrogate may have, and how many times a piece may be halved. A piece that still
+// isn't accurate enough at the deepest level (around a jump, say) is kept anyway, since it is
+// then too small to matter; running out of pieces means the function is too wiggly to bother.
+#define MAX_PIECES 4096
+#define MAX_DEPTH 40
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// State shared by the recursive calls of fit_piece()
+struct Fit_State {
+    const struct Program *program;
+    struct Arena *scratch;
+    struct Chebyshev_Surrogate *surrogate;
+    int capacity; // Pieces allocated
+    double scale; // Largest |f| seen so far
+    double nodes[CHEBYSHEV_TERMS]; // The Chebyshev points on [-1, 1]
+    double transform[CHEBYSHEV_TERMS][CHEBYSHEV_TERMS]; // From values at the nodes to coefficients
+};
+
+// ------ Chebyshev definitions ------
+
+/*
+ * Function: clenshaw(coefficients, terms, t)
+ *
+ * Description: Evaluates sum(c_k T_k(t)) with Clenshaw's recurrence, which needs neither the
+ *              T_k themselves nor more than a multiply-add per term
+ * Parameters: coefficients - c_0 to c_(terms-1)
+ *             terms - the number of coefficients
+ *             t - where to evaluate the series, in [-1, 1]
+ * Returns: The value of the series
+ */
+
+static inline double clenshaw(const double *coefficients, int terms, double t) {
+    double b1 = 0; // b_(k+1)
+    double b2 = 0; // b_(k+2)
+    for (int k = terms - 1; k >= 1; k--) {
+        double b0 = coefficients[k] + 2 * t * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+    return coefficients[0] + t * b1 - b2;
+}
+
+/*
+ * Function: to_unit(piece, x)
+ *
+ * Description: Maps x from a piece's range onto [-1, 1], where its series is defined
+ * Parameters: piece - the piece
+ *             x - a value in the piece's range
+ * Returns: The mapped value
+ */
+
+static inline double to_unit(const struct Chebyshev_Piece *piece, double x) {
+    double t = (2 * x - (piece->start + piece->end)) / (piece->end - piece->start);
+    if (t < -1) { return -1; }
+    if (t > 1) { return 1; }
+    return t;
+}
+
+/*
+ * Function: find_piece(surrogate, x)
+ *
+ * Description: Finds the piece whose range contains x, by binary search
+ * Parameters: surrogate - the surrogate
+ *             x - a value in the surrogate's range
+ * Returns: The index of the piece
+ */
+
+static int find_piece(const struct Chebyshev_Surrogate *surrogate, double x) {
+    int low = 0;
+    int high = surrogate->piece_count - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (surrogate->pieces[middle].start <= x) { low = middle; }
+        else { high = middle - 1; }
+    }
+    return low;
+}
+
+/*
+ * Function: integrate_series(piece)
+ *
+ * Description: Works out the Chebyshev series of the integral of a piece from its start, using
+ *              the integral of T_k being T_(k+1)/2(k+1) - T_(k-1)/2(k-1). The constant term is
+ *              chosen so that the integral is 0 at the piece's start.
+ * Parameters: piece - the piece, whose coefficients are set
+ * Returns: none
+ */
+
+static void integrate_series(struct Chebyshev_Piece *piece) {
+    const double *c = piece->coefficients;
+    double *integral = piece->antiderivative;
+    double half_width = (piece->end - piece->start) / 2; // dx/dt
+
+    for (int k = 1; k <= CHEBYSHEV_TERMS; k++) {
+        double before = c[k - 1];
+        double after = (k + 1 < CHEBYSHEV_TERMS) ? c[k + 1] : 0;
+        // T_0 integrates to T_1 with no halving, so c_0 counts double in the first term
+        integral[k] = (k == 1) ? before - after / 2 : (before - after) / (2 * k);
+        integral[k] *= half_width;
+    }
+
+    // T_k(-1) = (-1)^k
+    double at_start = 0;
+    for (int k = 1; k <= CHEBYSHEV_TERMS; k++) {
+        at_start += (k % 2 == 0) ? integral[k] : -integral[k];
+    }
+    integral[0] = -at_start;
+}
+
+/*
+ * Function: fit_piece(state, start, end, depth)
+ *
+ * Description: Fits a Chebyshev series to the expression over [start, end] by interpolating it
+ *              at the Chebyshev points (the roots of T_CHEBYSHEV_TERMS). If the last few
+ *              coefficients aren't negligible, the series hasn't converged, so the range is
+ *              halved and each half fitted on its own. Pieces are added to the surrogate in order.
+ * Parameters: state - the fit so far
+ *             start, end - the range to fit
+ *             depth - how many times the range has been halved
+ * Returns: 0 on success, or a (negative) enum Chebyshev_Error
+ */
+
+static int fit_piece(struct Fit_State *state, double start, double end, int depth) {
+    double x[CHEBYSHEV_TERMS];
+    double y[CHEBYSHEV_TERMS];
+    double middle = (start + end) / 2;
+    double half_width = (end - start) / 2;
+
+    for (int j = 0; j < CHEBYSHEV_TERMS; j++) { x[j] = middle + half_width * state->nodes[j]; }
+    if (evaluate_rpn_block(state->program, x, y, CHEBYSHEV_TERMS, state->scratch) != 0) {
+        return Chebyshev_Out_Of_Memory;
+    }
+    state->surrogate->evaluations += CHEBYSHEV_TERMS;
+
+    for (int j = 0; j < CHEBYSHEV_TERMS; j++) {
+        if (!isfinite(y[j])) { return Chebyshev_Not_Finite; }
+        if (fabs(y[j]) > state->scale) { state->scale = fabs(y[j]); }
+    }
+
+    // Discrete cosine transform of the values gives the coefficients
+    double c[CHEBYSHEV_TERMS];
+    for (int k = 0; k < CHEBYSHEV_TERMS; k++) {
+        double sum = 0;
+        for (int j = 0; j < CHEBYSHEV_TERMS; j++) { sum += state->transform[k][j] * y[j]; }
+        c[k] = sum;
+    }
+
+    // Three coefficients, since an odd or even function has every other one 0
+    double tail = fmax(fabs(c[CHEBYSHEV_TERMS - 1]),
+                       fmax(fabs(c[CHEBYSHEV_TERMS - 2]), fabs(c[CHEBYSHEV_TERMS - 3])));
+    int converged = tail <= state->surrogate->tolerance * state->scale;
+
+    if (!converged && depth < MAX_DEPTH && start < middle && middle < end) {
+        int rc = fit_piece(state, start, middle, depth + 1);
+        if (rc != 0) { return rc; }
+        return fit_piece(state, middle, end, depth + 1);
+    }
+
+    // Keep this piece
+    struct Chebyshev_Surrogate *surrogate = state->surrogate;
+    if (surrogate->piece_count == state->capacity) {
+        if (state->capacity >= MAX_PIECES) { return Chebyshev_Too_Many_Pieces; }
+        int capacity = (state->capacity == 0) ? 16 : state->capacity * 2;
+        struct Chebyshev_Piece *pieces = realloc(surrogate->pieces,
+                                                 capacity * sizeof(struct Chebyshev_Piece));
+        if (pieces == NULL) { return Chebyshev_Out_Of_Memory; }
+        surrogate->pieces = pieces;
+        state->capacity = capacity;
+    }
+
+    struct Chebyshev_Piece *piece = &surrogate->pieces[surrogate->piece_count++];
+    piece->start = start;
+    piece->end = end;
+    for (int k = 0; k < CHEBYSHEV_TERMS; k++) { piece->coefficients[k] = c[k]; }
+    integrate_series(piece);
+    return 0;
+}
+
+/*
+ * Function: chebyshev_fit(program, start, end, tolerance, surrogate, scratch)
+ *
+ * Description: Fits a piecewise Chebyshev approximation to a compiled expression over a range.
+ *              This evaluates the expression a few dozen times per piece; afterwards, the
+ *              surrogate can be evaluated and integrated without it.
+ * Parameters: program - the compiled expression
+ *             start, end - the range (in either order), which must be finite
+ *             tolerance - the accuracy to fit to, relative to the largest |f| in the range (0 for
+ *                         the default, 1e-12)
+ *             surrogate - where the surrogate is written, to be freed with chebyshev_free()
+ *                         (even if fitting failed)
+ *             scratch - arena for the evaluator's working memory
+ * Returns: 0 on success, or a (negative) enum Chebyshev_Error
+ */
+
+int chebyshev_fit(const struct Program *program, double start, double end, double tolerance,
+                  struct Chebyshev_Surrogate *surrogate, struct Arena *scratch) {
+    if (start > end) {
+        double tmp = start;
+        start = end;
+        end = tmp;
+    }
+
+    surrogate->start = start;
+    surrogate->end = end;
+    surrogate->tolerance = (tolerance > 0) ? tolerance : DEFAULT_CHEBYSHEV_TOLERANCE;
+    surrogate->piece_count = 0;
+    surrogate->pieces = NULL;
+    surrogate->cumulative = NULL;
+    surrogate->evaluations = 0;
+
+    struct Fit_State state = { .program = program, .scratch = scratch, .surrogate = surrogate };
+
+    // Every piece uses the same nodes and transform, so the cosines are only worked out once
+    for (int j = 0; j < CHEBYSHEV_TERMS; j++) {
+        state.nodes[j] = cos(M_PI * (j + 0.5) / CHEBYSHEV_TERMS);
+    }
+    for (int k = 0; k < CHEBYSHEV_TERMS; k++) {
+        for (int j = 0; j < CHEBYSHEV_TERMS; j++) {
+            state.transform[k][j] = cos(M_PI * k * (j + 0.5) / CHEBYSHEV_TERMS) *
+                                    ((k == 0) ? 1.0 : 2.0) / CHEBYSHEV_TERMS;
+        }
+    }
+
+    // The tolerance is relative to the size of f, so get an idea of that first. Otherwise the
+    // first pieces fitted would be held to whatever size f happens to be at that end.
+    double x[SCALE_POINTS];
+    double y[SCALE_POINTS];
+    for (int i = 0; i < SCALE_POINTS; i++) {
+        x[i] = start + i * (end - start) / (SCALE_POINTS - 1);
+    }
+    if (evaluate_rpn_block(program, x, y, SCALE_POINTS, scratch) != 0) {
+        return Chebyshev_Out_Of_Memory;
+    }
+    surrogate->evaluations += SCALE_POINTS;
+    for (int i = 0; i < SCALE_POINTS; i++) {
+        if (!isfinite(y[i])) { return Chebyshev_Not_Finite; }
+        if (fabs(y[i]) > state.scale) { state.scale = fabs(y[i]); }
+    }
+
+    int rc = fit_piece(&state, start, end, 0);
+    if (rc != 0) { return rc; }
+
+    // Integral up to the start of each piece, and of the whole range at the end
+    surrogate->cumulative = malloc((surrogate->piece_count + 1) * sizeof(double));
+    if (surrogate->cumulative == NULL) { return Chebyshev_Out_Of_Memory; }
+
+    surrogate->cumulative[0] = 0;
+    for (int i = 0; i < surrogate->piece_count; i++) {
+        const struct Chebyshev_Piece *piece = &surrogate->pieces[i];
+        surrogate->cumulative[i + 1] = surrogate->cumulative[i] +
+                                       clenshaw(piece->antiderivative, CHEBYSHEV_TERMS + 1, 1);
+    }
+
+    return 0;
+}
+
+/*
+ * Function: chebyshev_evaluate(surrogate, x)
+ *
+ * Description: Evaluates a surrogate
+ * Parameters: surrogate - the fitted surrogate
+ *             x - where to evaluate it
+ * Returns: The approximate value of the expression at x, or NaN if x is outside the surrogate's
+ *          range
+ */
+
+double chebyshev_evaluate(const struct Chebyshev_Surrogate *surrogate, double x) {
+    if (!(x >= surrogate->start && x <= surrogate->end)) { return NAN; }
+
+    const struct Chebyshev_Piece *piece = &surrogate->pieces[find_piece(surrogate, x)];
+    return clenshaw(piece->coefficients, CHEBYSHEV_TERMS, to_unit(piece, x));
+}
+
+/*
+ * Function: antiderivative(surrogate, x)
+ *
+ * Description: Integrates a surrogate from the start of its range to x
+ * Parameters: surrogate - the fitted surrogate
+ *             x - a value in the surrogate's range
+ * Returns: The integral
+ */
+
+static double antiderivative(const struct Chebyshev_Surrogate *surrogate, double x) {
+    int i = find_piece(surrogate, x);
+    const struct Chebyshev_Piece *piece = &surrogate->pieces[i];
+    return surrogate->cumulative[i] +
+           clenshaw(piece->antiderivative, CHEBYSHEV_TERMS + 1, to_unit(piece, x));
+}
+
+/*
+ * Function: chebyshev_integral(surrogate, start, end)
+ *
+ * Description: Integrates a surrogate over part of its range. The surrogate's integral is exact,
+ *              so this is as accurate as the fit, and costs the same however wide the range is.
+ * Parameters: surrogate - the fitted surrogate
+ *             start, end - the limits of integration (in either order)
+ * Returns: The integral, or NaN if the limits aren't within the surrogate's range
+ */
+
+double chebyshev_integral(const struct Chebyshev_Surrogate *surrogate, double start, double end) {
+    if (!chebyshev_covers(surrogate, start, end)) { return NAN; }
+    return antiderivative(surrogate, end) - antiderivative(surrogate, start);
+}
+
+/*
+ * Function: chebyshev_covers(surrogate, start, end)
+ *
+ * Description: Says whether a surrogate was fitted over a range, i.e. whether it can be used
+ *              for an integral between the given limits
+ * Parameters: surrogate - the surrogate
+ *             start, end - the limits (in either order)
+ * Returns: 1 if it can, 0 if not
+ */
+
+int chebyshev_covers(const struct Chebyshev_Surrogate *surrogate, double start, double end) {
+    return surrogate->cumulative != NULL &&
+           start >= surrogate->start && start <= surrogate->end &&
+           end >= surrogate->start && end <= surrogate->end;
+}
+
+/*
+ * Function: chebyshev_free(surrogate)
+ *
+ * Description: Frees the memory a surrogate holds (but not the struct itself)
+ * Parameters: surrogate - the surrogate
+ * Returns: none
+ */
+
+void chebyshev_free(struct Chebyshev_Surrogate *surrogate) {
+    free(surrogate->pieces);
+    free(surrogate->cumulative);
+    surrogate->pieces = NULL;
+    surrogate->cumulative = NULL;
+    surrogate->piece_count = 0;
+}
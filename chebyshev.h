@@ -0,0 +1,51 @@
+#ifndef CHEBYSHEV_H_INCLUDED
+#define CHEBYSHEV_H_INCLUDED // Include guards
+
+#include "parser.h" // struct Program
+#include "arena.h"
+
+// ------ Chebyshev surrogate ------
+// An expression that is integrated over and over (with different limits or methods) can be
+// replaced by a piecewise polynomial approximation of it, fitted once. Each piece is a Chebyshev
+// series, which converges very quickly for smooth functions; the range is split in two wherever
+// one series isn't accurate enough, so that kinks and steep regions get smaller pieces. After
+// that, evaluating the surrogate is a short Clenshaw recurrence, and integrating it over any
+// sub-range is exact: each piece's antiderivative is a Chebyshev series too, so an integral is
+// two Clenshaw evaluations plus a prefix sum of whole pieces, whatever the number of strips.
+
+// Terms of each piece's series (degree + 1)
+#define CHEBYSHEV_TERMS 17
+
+// --- Type declarations ---
+
+enum Chebyshev_Error {
+    Chebyshev_Not_Finite = -1, // The expression is NaN or infinite somewhere in the range
+    Chebyshev_Too_Many_Pieces = -2, // Couldn't reach the tolerance (e.g. the function jumps)
+    Chebyshev_Out_Of_Memory = -3
+};
+
+struct Chebyshev_Piece {
+    double start, end;
+    double coefficients[CHEBYSHEV_TERMS]; // f(x) = sum of c_k T_k(t), t mapped from [start, end]
+    double antiderivative[CHEBYSHEV_TERMS + 1]; // Integral from start to x, in the same form
+};
+
+struct Chebyshev_Surrogate {
+    double start, end; // The range the surrogate covers
+    double tolerance; // Accuracy asked for, relative to the largest |f| in the range
+    int piece_count;
+    struct Chebyshev_Piece *pieces; // In order from start to end
+    double *cumulative; // cumulative[i]: integral from start to the start of piece i
+    long evaluations; // Number of times the expression was evaluated to fit it
+};
+
+// --- Function declarations ---
+
+int chebyshev_fit(const struct Program *program, double start, double end, double tolerance,
+                  struct Chebyshev_Surrogate *surrogate, struct Arena *scratch);
+double chebyshev_evaluate(const struct Chebyshev_Surrogate *surrogate, double x);
+double chebyshev_integral(const struct Chebyshev_Surrogate *surrogate, double start, double end);
+int chebyshev_covers(const struct Chebyshev_Surrogate *surrogate, double start, double end);
+void chebyshev_free(struct Chebyshev_Surrogate *surrogate);
+
+#endif
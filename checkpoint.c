@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+// ------ Checkpoint definitions ------
+
+/*
+ * Function: write_file(writer, state)
+ *
+ * Description: Saves a checkpoint: writes it to the temporary file, makes sure it has reached the
+ *              disk, and renames it over the checkpoint file
+ * Parameters: writer - the checkpoint writer
+ *             state - the checkpoint
+ * Returns: 0 on success, or errno
+ */
+
+static int write_file(const struct Checkpoint_Writer *writer, const struct Checkpoint_State *state) {
+    FILE *file = fopen(writer->temporary_path, "wb");
+    if (file == NULL) { return errno; }
+
+    int ok = fwrite(state, sizeof(struct Checkpoint_State), 1, file) == 1 && fflush(file) == 0 &&
+             fsync(fileno(file)) == 0;
+    int error = ok ? 0 : errno;
+    if (fclose(file) != 0 && error == 0) { error = errno; }
+    if (error == 0 && rename(writer->temporary_path, writer->path) != 0) { error = errno; }
+
+    return error;
+}
+
+/*
+ * Function: writer_thread(argument)
+ *
+ * Description: The checkpoint writer's thread: waits for checkpoints to be handed over, and writes
+ *              them, until told to stop. Only the latest one handed over is written, so if the
+ *              disk is slow, checkpoints are skipped rather than queued up.
+ * Parameters: argument - the checkpoint writer
+ * Returns: NULL
+ */
+
+static void *writer_thread(void *argument) {
+    struct Checkpoint_Writer *writer = argument;
+    struct Checkpoint_State state;
+
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        while (!writer->pending && !writer->stopping) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (!writer->pending) { break; } // stopping, with nothing left to write
+
+        state = writer->snapshot;
+        writer->pending = 0;
+        writer->writing = 1;
+        pthread_mutex_unlock(&writer->lock);
+
+        int error = write_file(writer, &state);
+
+        pthread_mutex_lock(&writer->lock);
+        writer->writing = 0;
+        writer->error = error;
+        if (error == 0) { writer->written++; }
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+/*
+ * Function: checkpoint_open(path, interval)
+ *
+ * Description: Creates a checkpoint writer, with its thread
+ * Parameters: path - the checkpoint file, which is read by checkpoint_load() and written by the
+ *                    writer's thread
+ *             interval - seconds between checkpoints (0 for the default, CHECKPOINT_INTERVAL)
+ * Returns: The writer, or NULL if it couldn't be created
+ */
+
+struct Checkpoint_Writer *checkpoint_open(const char *path, double interval) {
+    struct Checkpoint_Writer *writer = calloc(1, sizeof(struct Checkpoint_Writer));
+    if (writer == NULL) { return NULL; }
+
+    size_t length = strlen(path);
+    writer->path = malloc(length + 1);
+    writer->temporary_path = malloc(length + sizeof(".tmp"));
+    if (writer->path == NULL || writer->temporary_path == NULL) {
+        free(writer->path);
+        free(writer->temporary_path);
+        free(writer);
+        return NULL;
+    }
+    memcpy(writer->path, path, length + 1);
+    memcpy(writer->temporary_path, path, length);
+    memcpy(writer->temporary_path + length, ".tmp", sizeof(".tmp"));
+
+    writer->interval = (interval > 0) ? interval : CHECKPOINT_INTERVAL;
+    writer->next_due = checkpoint_now() + writer->interval;
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->changed);
+        free(writer->path);
+        free(writer->temporary_path);
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+/*
+ * Function: checkpoint_load(writer, state)
+ *
+ * Description: Reads the checkpoint file, if there is one. It's up to the caller to check that
+ *              it is for the same integration.
+ * Parameters: writer - the checkpoint writer
+ *             state - where the checkpoint is written
+ * Returns: 1 if a checkpoint was read, 0 if there isn't one (or it isn't a checkpoint file, or
+ *          is from a different version)
+ */
+
+int checkpoint_load(const struct Checkpoint_Writer *writer, struct Checkpoint_State *state) {
+    FILE *file = fopen(writer->path, "rb");
+    if (file == NULL) { return 0; }
+
+    int ok = fread(state, sizeof(struct Checkpoint_State), 1, file) == 1;
+    fclose(file);
+
+    return ok && state->magic == CHECKPOINT_MAGIC && state->version == CHECKPOINT_VERSION;
+}
+
+/*
+ * Function: checkpoint_now()
+ *
+ * Description: Reads the clock that checkpoint intervals are timed with
+ * Parameters: none
+ * Returns: The time, in seconds
+ */
+
+double checkpoint_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Function: checkpoint_submit(writer, state)
+ *
+ * Description: Hands a checkpoint over to the writer's thread to be written, and starts timing the
+ *              next interval. This only copies the state, so it doesn't wait for the disk.
+ * Parameters: writer - the checkpoint writer
+ *             state - the checkpoint
+ * Returns: none
+ */
+
+void checkpoint_submit(struct Checkpoint_Writer *writer, const struct Checkpoint_State *state) {
+    pthread_mutex_lock(&writer->lock);
+    writer->snapshot = *state;
+    writer->snapshot.magic = CHECKPOINT_MAGIC;
+    writer->snapshot.version = CHECKPOINT_VERSION;
+    writer->pending = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+
+    writer->next_due = checkpoint_now() + writer->interval;
+}
+
+/*
+ * Function: checkpoint_flush(writer)
+ *
+ * Description: Waits until every checkpoint handed over has been written
+ * Parameters: writer - the checkpoint writer
+ * Returns: none
+ */
+
+void checkpoint_flush(struct Checkpoint_Writer *writer) {
+    pthread_mutex_lock(&writer->lock);
+    while (writer->pending || writer->writing) {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/*
+ * Function: checkpoint_remove(writer)
+ *
+ * Description: Deletes the checkpoint file, once the integration it was for has finished
+ * Parameters: writer - the checkpoint writer
+ * Returns: none
+ */
+
+void checkpoint_remove(struct Checkpoint_Writer *writer) {
+    checkpoint_flush(writer);
+    remove(writer->path);
+}
+
+/*
+ * Function: checkpoint_close(writer)
+ *
+ * Description: Writes any checkpoint still waiting to be written, stops the writer's thread and
+ *              frees the writer. The checkpoint file is left where it is.
+ * Parameters: writer - the checkpoint writer, or NULL
+ * Returns: none
+ */
+
+void checkpoint_close(struct Checkpoint_Writer *writer) {
+    if (writer == NULL) { return; }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->changed);
+    free(writer->path);
+    free(writer->temporary_path);
+    free(writer);
+}
@@ -0,0 +1,88 @@
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED // Include guards
+
+#include <stdint.h>
+#include <pthread.h>
+
+// ------ Checkpoints ------
+// An integration with billions of strips takes hours, and would have to start again from nothing
+// if it were stopped. Instead, every so often the integrator hands its progress (how far along the
+// grid it has got, and its sums so far) to a checkpoint writer, whose own thread saves it to a
+// small file, so the integration itself never waits for the disk. An integration of the same
+// expression over the same grid carries on from the file instead of starting again.
+//
+// The file is written to a temporary file which is then renamed over the old one, so it is always
+// either the previous checkpoint or the new one, never half of each.
+
+// Identifies a checkpoint file, and the layout of struct Checkpoint_State in it
+#define CHECKPOINT_MAGIC 0x4b504349u // "ICPK"
+#define CHECKPOINT_VERSION 2
+
+// Default time between checkpoints, in seconds
+#define CHECKPOINT_INTERVAL 10.0
+
+// --- Type declarations ---
+
+// An integration's progress, as saved in the file
+struct Checkpoint_State {
+    uint32_t magic;
+    uint32_t version;
+    // What is being integrated, which must match to carry on from the checkpoint
+    uint64_t program_hash; // see program_hash()
+    double start, end;
+    long strips;
+    int method;
+    int non_finite; // enum Non_Finite_Policy, which decides what went into the sums
+    int precision; // enum Integration_Precision the sums were evaluated in
+    // How far it has got
+    long next; // The next grid point to evaluate (0 if the ends haven't been done yet)
+    long evaluations;
+    long nan_results, inf_results;
+    long first_bad, last_bad; // see integrate_double()
+    double sums[4]; // The sums so far (one for most methods, four for Method_Richardson)...
+    double compensations[4]; // ...and the low-order bits lost from them (see compensated_add())
+};
+
+struct Checkpoint_Writer {
+    char *path; // The checkpoint file
+    char *temporary_path; // Written and then renamed to path
+    double interval; // Seconds between checkpoints
+    double next_due; // When the next checkpoint is due (only used by the integrating thread)
+
+    pthread_t thread;
+    pthread_mutex_t lock; // Protects everything below
+    pthread_cond_t changed; // Signalled when pending, writing or stopping changes
+    struct Checkpoint_State snapshot; // The latest state handed over, waiting to be written
+    int pending; // 1 if snapshot hasn't been written yet
+    int writing; // 1 while the thread is writing a snapshot
+    int stopping; // 1 when the thread should finish
+    int error; // errno of the last failed write, or 0
+    long written; // Number of checkpoints written
+};
+
+// --- Function declarations ---
+
+struct Checkpoint_Writer *checkpoint_open(const char *path, double interval);
+int checkpoint_load(const struct Checkpoint_Writer *writer, struct Checkpoint_State *state);
+double checkpoint_now();
+void checkpoint_submit(struct Checkpoint_Writer *writer, const struct Checkpoint_State *state);
+void checkpoint_flush(struct Checkpoint_Writer *writer);
+void checkpoint_remove(struct Checkpoint_Writer *writer);
+void checkpoint_close(struct Checkpoint_Writer *writer);
+
+// --- Inline function definitions ---
+
+/*
+ * Function: checkpoint_due(writer)
+ *
+ * Description: Says whether it's time to hand over another checkpoint. This reads the clock, so
+ *              the integrator only asks every so many blocks of points.
+ * Parameters: writer - the checkpoint writer
+ * Returns: 1 if a checkpoint is due, 0 if not
+ */
+
+static inline int checkpoint_due(const struct Checkpoint_Writer *writer) {
+    return checkpoint_now() >= writer->next_due;
+}
+
+#endif
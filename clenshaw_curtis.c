@@ -0,0 +1,173 @@
+#include <math.h>
+#include "clenshaw_curtis.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Fewest coefficients at the end of the series looked at to decide whether it has converged (one
+// odd one isn't enough: for a function that is even about the middle of the range, every odd
+// coefficient is 0 whatever n is)
+#define TAIL_TERMS 3
+
+// ------ Clenshaw-Curtis definitions ------
+
+/*
+ * Function: clenshaw_curtis_node(j, n)
+ *
+ * Description: Works out the j'th Chebyshev point, cos(j pi / n), as sin(pi (n - 2j) / 2n), which
+ *              is exactly symmetric about 0 and accurate near the ends. The j'th point for n is
+ *              exactly the 2j'th point for 2n.
+ * Parameters: j - which point, from 0 (1) to n (-1)
+ *             n - the number of intervals between the points
+ * Returns: The point, in [-1, 1]
+ */
+
+double clenshaw_curtis_node(long j, long n) {
+    return sin(M_PI * (double)(n - 2 * j) / (2.0 * (double)n));
+}
+
+/*
+ * Function: fft(real, imaginary, size, cosines, sines)
+ *
+ * Description: Fourier transforms a sequence in place (radix 2, decimation in time): X_k is the
+ *              sum of x_j e^(-2 pi i j k / size)
+ * Parameters: real, imaginary - the sequence, overwritten by its transform
+ *             size - its length, a power of two
+ *             cosines, sines - cos and sin of 2 pi k / size, for k from 0 to size / 2 - 1
+ * Returns: none
+ */
+
+static void fft(double *real, double *imaginary, long size, const double *cosines,
+                const double *sines) {
+    // Put the sequence in bit-reversed order
+    for (long i = 1, j = 0; i < size; i++) {
+        long bit = size >> 1;
+        for (; j & bit; bit >>= 1) { j ^= bit; }
+        j |= bit;
+        if (i < j) {
+            double tmp = real[i];
+            real[i] = real[j];
+            real[j] = tmp;
+            tmp = imaginary[i];
+            imaginary[i] = imaginary[j];
+            imaginary[j] = tmp;
+        }
+    }
+
+    // Then combine transforms of length half into ones of twice that, until there's one
+    for (long half = 1; half < size; half *= 2) {
+        long stride = size / (2 * half); // through the table of cosines and sines
+        for (long start = 0; start < size; start += 2 * half) {
+            for (long k = 0; k < half; k++) {
+                double c = cosines[k * stride], s = sines[k * stride];
+                long a = start + k, b = a + half;
+                double b_real = real[b] * c + imaginary[b] * s; // x_b e^(-i theta)
+                double b_imaginary = imaginary[b] * c - real[b] * s;
+                real[b] = real[a] - b_real;
+                imaginary[b] = imaginary[a] - b_imaginary;
+                real[a] += b_real;
+                imaginary[a] += b_imaginary;
+            }
+        }
+    }
+}
+
+/*
+ * Function: clenshaw_curtis_coefficients(values, n, coefficients, scratch)
+ *
+ * Description: Works out the Chebyshev series of the polynomial through values at the Chebyshev
+ *              points, with a DCT-I: the values, extended to an even sequence of period 2n
+ *              (f_0 ... f_n ... f_1), are Fourier transformed, which leaves
+ *              X_k = f_0 + (-1)^k f_n + 2 sum(f_j cos(j k pi / n)) for 0 < j < n, and
+ *              c_k = X_k / n, halved for c_0 and c_n.
+ * Parameters: values - the values at clenshaw_curtis_node(j, n), for j from 0 to n
+ *             n - the number of intervals, a power of two
+ *             coefficients - where c_0 to c_n are written
+ *             scratch - arena for working memory, handed back before returning
+ * Returns: 0 on success, -1 if there wasn't enough memory
+ */
+
+int clenshaw_curtis_coefficients(const double *values, long n, double *coefficients,
+                                 struct Arena *scratch) {
+    if (n == 1) { // too short for the transform
+        coefficients[0] = (values[0] + values[1]) / 2;
+        coefficients[1] = (values[0] - values[1]) / 2;
+        return 0;
+    }
+
+    struct Arena_Mark mark = arena_mark(scratch);
+    long size = 2 * n;
+    double *real = arena_alloc(scratch, size * sizeof(double));
+    double *imaginary = arena_alloc(scratch, size * sizeof(double));
+    double *cosines = arena_alloc(scratch, n * sizeof(double));
+    double *sines = arena_alloc(scratch, n * sizeof(double));
+    if (real == NULL || imaginary == NULL || cosines == NULL || sines == NULL) {
+        arena_release(scratch, mark);
+        return -1;
+    }
+
+    for (long k = 0; k < n; k++) {
+        cosines[k] = clenshaw_curtis_node(k, n); // cos(2 pi k / 2n)
+        sines[k] = sin(M_PI * (double)k / (double)n);
+    }
+    for (long j = 0; j <= n; j++) {
+        real[j] = values[j];
+        imaginary[j] = 0;
+    }
+    for (long j = 1; j < n; j++) {
+        real[size - j] = values[j];
+        imaginary[size - j] = 0;
+    }
+
+    fft(real, imaginary, size, cosines, sines);
+
+    // The transform of a real, even sequence is real, so the imaginary parts are just rounding
+    for (long k = 0; k <= n; k++) { coefficients[k] = real[k] / (double)n; }
+    coefficients[0] /= 2;
+    coefficients[n] /= 2;
+
+    arena_release(scratch, mark);
+    return 0;
+}
+
+/*
+ * Function: clenshaw_curtis_sum(coefficients, n)
+ *
+ * Description: Integrates a Chebyshev series over [-1, 1]: the sum of c_k 2 / (1 - k^2) over even
+ *              k. The terms are added smallest (highest k) first.
+ * Parameters: coefficients - c_0 to c_n
+ *             n - the degree of the series
+ * Returns: The integral
+ */
+
+double clenshaw_curtis_sum(const double *coefficients, long n) {
+    double sum = 0;
+    for (long k = n - n % 2; k >= 0; k -= 2) {
+        sum += coefficients[k] * 2 / (1 - (double)k * (double)k);
+    }
+    return sum;
+}
+
+/*
+ * Function: clenshaw_curtis_converged(coefficients, n, tolerance)
+ *
+ * Description: Decides whether a Chebyshev series has converged: whether its last n / 8 (at least
+ *              TAIL_TERMS) coefficients are all within the tolerance of the largest
+ * Parameters: coefficients - c_0 to c_n
+ *             n - the degree of the series
+ *             tolerance - how small the last coefficients have to be, relative to the largest
+ * Returns: 1 if it has converged, 0 if not (including if any coefficient is NaN)
+ */
+
+int clenshaw_curtis_converged(const double *coefficients, long n, double tolerance) {
+    long tail = (n / 8 > TAIL_TERMS) ? n / 8 : TAIL_TERMS;
+    double largest = 0, last = 0;
+    for (long k = 0; k <= n; k++) {
+        double size = fabs(coefficients[k]);
+        if (isnan(size)) { return 0; }
+        if (size > largest) { largest = size; }
+        if (k > n - tail && size > last) { last = size; }
+    }
+    return last <= tolerance * largest;
+}
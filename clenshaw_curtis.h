@@ -0,0 +1,35 @@
+#ifndef CLENSHAW_CURTIS_H_INCLUDED
+#define CLENSHAW_CURTIS_H_INCLUDED // Include guards
+
+#include "arena.h"
+
+// ------ Clenshaw-Curtis quadrature ------
+// Integrates the polynomial that goes through the integrand's values at the n + 1 Chebyshev
+// points x_j = cos(j pi / n) (mapped onto the range), rather than a piecewise one like Simpson's
+// rule. For smooth functions that converges far faster than any fixed-order rule: exponentially
+// in n, for anything analytic over the range.
+//
+// The polynomial is worked out as a Chebyshev series, sum of c_k T_k(x), and its coefficients
+// from the values are a discrete cosine transform (DCT-I), which is done as a fast Fourier
+// transform of the values extended to a period of 2n: O(n log n), where working out the weights of
+// the quadrature rule directly would be O(n^2). The integral of T_k over [-1, 1] is 2 / (1 - k^2)
+// for even k and 0 for odd k, so the integral is then a sum over the coefficients.
+//
+// The points for n are every other point for 2n, so doubling n only needs the integrand at the n
+// new points in between. n is doubled until the last coefficients of the series are small next to
+// the largest, i.e. the series (and so the integral) has converged.
+
+// n for the first estimate (n + 1 points)
+#define CLENSHAW_CURTIS_FIRST 16
+// How small the last coefficients have to be, relative to the largest, if the caller doesn't say
+#define CLENSHAW_CURTIS_TOLERANCE 1e-14
+
+// --- Function declarations ---
+
+double clenshaw_curtis_node(long j, long n);
+int clenshaw_curtis_coefficients(const double *values, long n, double *coefficients,
+                                 struct Arena *scratch);
+double clenshaw_curtis_sum(const double *coefficients, long n);
+int clenshaw_curtis_converged(const double *coefficients, long n, double tolerance);
+
+#endif
@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "codegen.h"
+#include "functions.h"
+#include "shunting.h"
+#include "token.h"
+
+// What the generated code's symbols are called
+#define KERNEL_SYMBOL "integration_kernel"
+#define KERNEL_HASH_SYMBOL "integration_kernel_hash"
+#define KERNEL_FORMAT_SYMBOL "integration_kernel_format"
+
+extern char **environ;
+
+// ------ Native kernel definitions ------
+
+/*
+ * Function: write_number(value, file)
+ *
+ * Description: Writes a number as a C expression with exactly its value: finite numbers in
+ *              hexadecimal floating point, which can't be rounded on the way back in
+ * Parameters: value - the number
+ *             file - where it is written
+ * Returns: none
+ */
+
+static void write_number(double value, FILE *file) {
+    if (isnan(value)) {
+        fprintf(file, "NAN");
+    } else if (isinf(value)) {
+        fprintf(file, (value > 0) ? "INFINITY" : "(-INFINITY)");
+    } else {
+        fprintf(file, signbit(value) ? "(%a)" : "%a", value);
+    }
+}
+
+/*
+ * Function: kernel_write_source(program, file)
+ *
+ * Description: Writes a program out as C: a function taking an array of x, working out the
+ *              expression at each one in straight-line code (one variable per entry of the
+ *              evaluation stack, which the C compiler then puts in registers), and writing the
+ *              values to another array. The arrays can be the same one.
+ * Parameters: program - the compiled expression, which must not have parameters
+ *             file - where the source is written
+ * Returns: 0 on success, -1 if the program can't be written as C
+ */
+
+int kernel_write_source(const struct Program *program, FILE *file) {
+    fprintf(file, "// Generated from a compiled expression: changes to it will be overwritten\n");
+    fprintf(file, "#include <math.h>\n\n");
+    fprintf(file, "const int " KERNEL_FORMAT_SYMBOL " = %d;\n", KERNEL_FORMAT_VERSION);
+    fprintf(file, "const unsigned long long " KERNEL_HASH_SYMBOL " = 0x%016llxULL;\n\n",
+            (unsigned long long)program_hash(program));
+    fprintf(file, "void " KERNEL_SYMBOL "(const double *x, double *y, int count) {\n");
+    fprintf(file, "    for (int i = 0; i < count; i++) {\n");
+    fprintf(file, "        const double v = x[i];\n");
+    for (int s = 0; s < program->max_depth; s++) { fprintf(file, "        double s%d;\n", s); }
+
+    int depth = 0;
+    for (int t = 0; t < program->length; t++) {
+        const struct Token *token = &program->code[t];
+        fprintf(file, "        ");
+
+        if (token->type == Number) {
+            fprintf(file, "s%d = ", depth);
+            write_number(token->value, file);
+            depth++;
+        } else if (token->type == Variable) {
+            fprintf(file, "s%d = v", depth);
+            depth++;
+        } else if (token->type == Function) {
+            const char *c_name = function_table[token->function_type].c_name;
+            if (c_name == NULL || depth < 1) { return -1; }
+            fprintf(file, "s%d = %s(s%d)", depth - 1, c_name, depth - 1);
+        } else if (token->type == Operator && token->operator_type == Op_Negate) {
+            if (depth < 1) { return -1; }
+            fprintf(file, "s%d = -s%d", depth - 1, depth - 1);
+        } else if (token->type == Operator) {
+            if (depth < 2) { return -1; }
+            int a = depth - 2, b = depth - 1;
+            switch (token->operator_type) {
+                case Op_Add: fprintf(file, "s%d = s%d + s%d", a, a, b); break;
+                case Op_Subtract: fprintf(file, "s%d = s%d - s%d", a, a, b); break;
+                case Op_Multiply: fprintf(file, "s%d = s%d * s%d", a, a, b); break;
+                case Op_Divide: fprintf(file, "s%d = s%d / s%d", a, a, b); break;
+                case Op_Power: fprintf(file, "s%d = pow(s%d, s%d)", a, a, b); break;
+                default: return -1;
+            }
+            depth--;
+        } else {
+            return -1; // parameters (and brackets, which never make it into compiled code)
+        }
+        fprintf(file, ";\n");
+    }
+
+    // The same as the evaluators give for an empty program
+    fprintf(file, (depth == 0) ? "        y[i] = 0;\n" : "        y[i] = s0;\n");
+    fprintf(file, "    }\n}\n");
+    return ferror(file) ? -1 : 0;
+}
+
+/*
+ * Function: kernel_default_directory()
+ *
+ * Description: Finds where kernels are kept if the user doesn't say: integration-c in
+ *              $XDG_CACHE_HOME, or in ~/.cache
+ * Parameters: none
+ * Returns: The directory (in a static buffer), or NULL if there isn't a home directory to put it in
+ */
+
+const char *kernel_default_directory() {
+    static char directory[4096];
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int length;
+
+    if (cache != NULL && cache[0] == '/') {
+        length = snprintf(directory, sizeof(directory), "%s/integration-c", cache);
+    } else if (home != NULL && home[0] != '\0') {
+        length = snprintf(directory, sizeof(directory), "%s/.cache/integration-c", home);
+    } else {
+        return NULL;
+    }
+
+    return (length > 0 && (size_t)length < sizeof(directory)) ? directory : NULL;
+}
+
+/*
+ * Function: make_directory(path)
+ *
+ * Description: Creates a directory, and any directories it is in that don't exist yet. Only the
+ *              user can use ones that are created, since whatever is in them will be loaded and
+ *              run.
+ * Parameters: path - the directory
+ * Returns: 0 if the directory exists now, -1 if not
+ */
+
+static int make_directory(const char *path) {
+    char *copy = strdup(path);
+    if (copy == NULL) { return -1; }
+
+    for (char *slash = strchr(copy + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(copy, 0700); // it's fine if it's already there: the last mkdir() is checked
+        *slash = '/';
+    }
+    int made = mkdir(copy, 0700) == 0 || errno == EEXIST;
+    free(copy);
+
+    struct stat status;
+    return (made && stat(path, &status) == 0 && S_ISDIR(status.st_mode)) ? 0 : -1;
+}
+
+/*
+ * Function: kernel_cache_open(directory)
+ *
+ * Description: Starts using a directory of kernels, creating it if need be
+ * Parameters: directory - where kernels are kept, or NULL for kernel_default_directory()
+ * Returns: The cache, or NULL if the directory couldn't be created or there wasn't enough memory
+ */
+
+struct Kernel_Cache *kernel_cache_open(const char *directory) {
+    if (directory == NULL) { directory = kernel_default_directory(); }
+    if (directory == NULL || make_directory(directory) != 0) { return NULL; }
+
+    struct Kernel_Cache *cache = calloc(1, sizeof(struct Kernel_Cache));
+    if (cache == NULL) { return NULL; }
+    cache->directory = strdup(directory);
+    if (cache->directory == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    const char *compiler = getenv("CC");
+    cache->compiler = (compiler != NULL && compiler[0] != '\0') ? compiler : "cc";
+    return cache;
+}
+
+/*
+ * Function: run_compiler(cache, source, output)
+ *
+ * Description: Compiles a kernel's source into a shared object with the C compiler. Nothing that
+ *              would make it round differently from the evaluators is allowed: no contracting
+ *              a * b + c into a fused multiply-add, and no -ffast-math.
+ * Parameters: cache - the kernel cache, for the compiler
+ *             source - the source file
+ *             output - the shared object to write
+ * Returns: 0 on success, -1 if the compiler couldn't be run or failed
+ */
+
+static int run_compiler(const struct Kernel_Cache *cache, const char *source, const char *output) {
+    char *arguments[] = {
+        (char *)cache->compiler, "-O3", "-march=native", "-ffp-contract=off", "-fno-math-errno",
+        "-fPIC", "-shared", "-o", (char *)output, (char *)source, "-lm", NULL
+    };
+
+    // The compiler's complaints would only get mixed up with the results
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0) { return -1; }
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid;
+    int spawned = posix_spawnp(&pid, cache->compiler, &actions, NULL, arguments, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (spawned != 0) { return -1; }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) { return -1; }
+    }
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+/*
+ * Function: compile_kernel(cache, program, hash, path)
+ *
+ * Description: Writes out a program's kernel and compiles it into the cache directory. Both files
+ *              are written under names of their own first, and renamed into place once they are
+ *              finished, so another process never sees half of one.
+ * Parameters: cache - the kernel cache
+ *             program - the compiled expression
+ *             hash - its program_hash()
+ *             path - where the shared object goes
+ * Returns: 0 on success, -1 on failure
+ */
+
+static int compile_kernel(struct Kernel_Cache *cache, const struct Program *program,
+                          uint64_t hash, const char *path) {
+    size_t size = strlen(cache->directory) + 64;
+    char *source = malloc(size), *temporary_source = malloc(size), *temporary = malloc(size);
+    int result = -1;
+    if (source == NULL || temporary_source == NULL || temporary == NULL) { goto done; }
+
+    const char *directory = cache->directory;
+    int version = KERNEL_FORMAT_VERSION;
+    unsigned long long name = hash;
+    long pid = getpid();
+    snprintf(source, size, "%s/k%d-%016llx.c", directory, version, name);
+    snprintf(temporary_source, size, "%s/k%d-%016llx.%ld.c", directory, version, name, pid);
+    snprintf(temporary, size, "%s/k%d-%016llx.%ld.so", directory, version, name, pid);
+
+    FILE *file = fopen(temporary_source, "w");
+    if (file == NULL) { goto done; }
+    int written = kernel_write_source(program, file);
+    if (fclose(file) != 0 || written != 0) { goto cleanup; }
+
+    if (run_compiler(cache, temporary_source, temporary) != 0) { goto cleanup; }
+    if (rename(temporary, path) != 0) { goto cleanup; }
+    rename(temporary_source, source); // only kept to be looked at, so it doesn't matter if not
+    cache->compiled++;
+    result = 0;
+
+cleanup:
+    unlink(temporary);
+    unlink(temporary_source);
+done:
+    free(source);
+    free(temporary_source);
+    free(temporary);
+    return result;
+}
+
+/*
+ * Function: same_value(a, b)
+ *
+ * Description: Compares two values bit for bit, except that any NaN is the same as any other
+ * Parameters: a, b - the values
+ * Returns: 1 if they are the same, 0 if not
+ */
+
+static inline int same_value(double a, double b) {
+    if (isnan(a) || isnan(b)) { return isnan(a) && isnan(b); }
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+/*
+ * Function: check_kernel(function, program, start, end, scratch)
+ *
+ * Description: Checks that a kernel gives exactly what evaluate_rpn() gives at
+ *              KERNEL_CHECK_POINTS points spread over a range
+ * Parameters: function - the kernel
+ *             program - the compiled expression
+ *             start, end - the range
+ *             scratch - arena for evaluate_rpn()'s working memory
+ * Returns: 1 if it does, 0 if not
+ */
+
+static int check_kernel(Kernel_Function function, const struct Program *program, double start,
+                        double end, struct Arena *scratch) {
+    double x[KERNEL_CHECK_POINTS], y[KERNEL_CHECK_POINTS];
+    for (int i = 0; i < KERNEL_CHECK_POINTS; i++) {
+        x[i] = start + (end - start) * i / (KERNEL_CHECK_POINTS - 1);
+    }
+    function(x, y, KERNEL_CHECK_POINTS);
+    for (int i = 0; i < KERNEL_CHECK_POINTS; i++) {
+        if (!same_value(y[i], evaluate_rpn(program->code, program->length, x[i], scratch))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Function: same_program(kernel, program)
+ *
+ * Description: Checks that a kernel was made for a program, comparing what each token does (as
+ *              program_hash() hashes it), rather than trusting the hash alone
+ * Parameters: kernel - the kernel
+ *             program - the compiled expression
+ * Returns: 1 if it was, 0 if not
+ */
+
+static int same_program(const struct Kernel *kernel, const struct Program *program) {
+    if (kernel->length != program->length) { return 0; }
+    for (int t = 0; t < program->length; t++) {
+        const struct Token *a = &kernel->code[t], *b = &program->code[t];
+        if (a->type != b->type) { return 0; }
+        if (a->type == Number && memcmp(&a->value, &b->value, sizeof(double)) != 0) { return 0; }
+        if (a->type == Operator && a->operator_type != b->operator_type) { return 0; }
+        if (a->type == Function && a->function_type != b->function_type) { return 0; }
+    }
+    return 1;
+}
+
+/*
+ * Function: load_kernel(path, hash, program, start, end, scratch, kernel)
+ *
+ * Description: Loads a kernel's shared object and checks it: that it is the format this build
+ *              writes, for this program, and that it gives exactly what evaluate_rpn() gives at
+ *              KERNEL_CHECK_POINTS points spread over the range it is about to be used for
+ * Parameters: path - the shared object
+ *             hash - the program's program_hash()
+ *             program - the compiled expression
+ *             start, end - the range it will be evaluated over
+ *             scratch - arena for evaluate_rpn()'s working memory
+ *             kernel - where the kernel is written, if it passes
+ * Returns: 0 if the kernel passed, -1 if it couldn't be loaded or didn't pass
+ */
+
+static int load_kernel(const char *path, uint64_t hash, const struct Program *program,
+                       double start, double end, struct Arena *scratch, struct Kernel *kernel) {
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) { return -1; }
+
+    const int *format = dlsym(handle, KERNEL_FORMAT_SYMBOL);
+    const unsigned long long *kernel_hash = dlsym(handle, KERNEL_HASH_SYMBOL);
+    Kernel_Function function;
+    *(void **)&function = dlsym(handle, KERNEL_SYMBOL); // the way POSIX says to get a function
+    int valid = format != NULL && *format == KERNEL_FORMAT_VERSION && kernel_hash != NULL &&
+                *kernel_hash == hash && function != NULL;
+
+    if (valid) { valid = check_kernel(function, program, start, end, scratch); }
+
+    if (!valid) {
+        dlclose(handle);
+        return -1;
+    }
+    kernel->handle = handle;
+    kernel->function = function;
+    kernel->checked_start = start;
+    kernel->checked_end = end;
+    return 0;
+}
+
+/*
+ * Function: kernel_cache_get(cache, program, start, end, scratch)
+ *
+ * Description: Gets a program's kernel: one already loaded by this process, or from the cache
+ *              directory, or compiled now. A program whose kernel can't be made to work is
+ *              remembered, so it is only tried once. A loaded kernel is only used for the same
+ *              program (not just one with the same hash), and is checked again over any range
+ *              that isn't inside the one it was last checked over; one that fails is dropped.
+ * Parameters: cache - the kernel cache
+ *             program - the compiled expression
+ *             start, end - the range it is about to be evaluated over, which the kernel is
+ *                          checked over if it hasn't been already
+ *             scratch - arena for working memory while checking
+ * Returns: The kernel, or NULL if the program is to be evaluated as normal
+ */
+
+Kernel_Function kernel_cache_get(struct Kernel_Cache *cache, const struct Program *program,
+                                 double start, double end, struct Arena *scratch) {
+    if (cache == NULL || program->length > KERNEL_MAX_TOKENS) { return NULL; }
+    for (int t = 0; t < program->length; t++) {
+        if (program->code[t].type == Parameter) { return NULL; }
+    }
+
+    uint64_t hash = program_hash(program);
+    double low = (start < end) ? start : end, high = (start < end) ? end : start;
+    for (int i = 0; i < cache->count; i++) {
+        struct Kernel *kernel = &cache->kernels[i];
+        if (kernel->hash != hash) { continue; }
+        // Another program with the same hash shares its file too, so it just isn't compiled
+        if (!same_program(kernel, program)) { return NULL; }
+        if (kernel->function != NULL &&
+            (low < kernel->checked_start || high > kernel->checked_end)) {
+            if (check_kernel(kernel->function, program, low, high, scratch)) {
+                kernel->checked_start = low;
+                kernel->checked_end = high;
+            } else {
+                kernel->function = NULL;
+                cache->rejected++;
+            }
+        }
+        return kernel->function;
+    }
+
+    if (cache->count == cache->capacity) {
+        int capacity = (cache->capacity > 0) ? 2 * cache->capacity : 16;
+        struct Kernel *kernels = realloc(cache->kernels, capacity * sizeof(struct Kernel));
+        if (kernels == NULL) { return NULL; }
+        cache->kernels = kernels;
+        cache->capacity = capacity;
+    }
+    struct Token *code = malloc(program->length * sizeof(struct Token));
+    if (code == NULL) { return NULL; }
+    memcpy(code, program->code, program->length * sizeof(struct Token));
+    struct Kernel *kernel = &cache->kernels[cache->count++];
+    *kernel = (struct Kernel){ .hash = hash, .code = code, .length = program->length };
+
+    size_t size = strlen(cache->directory) + 64;
+    char *path = malloc(size);
+    if (path == NULL) { return NULL; }
+    snprintf(path, size, "%s/k%d-%016llx.so", cache->directory, KERNEL_FORMAT_VERSION,
+             (unsigned long long)hash);
+
+    if (load_kernel(path, hash, program, low, high, scratch, kernel) == 0) {
+        cache->loaded++;
+    } else {
+        // Not there, or left by a different compiler or program with the same hash: make it anew
+        if (compile_kernel(cache, program, hash, path) == 0 &&
+            load_kernel(path, hash, program, low, high, scratch, kernel) == 0) {
+            cache->loaded++;
+        } else {
+            cache->rejected++;
+        }
+    }
+
+    free(path);
+    return kernel->function;
+}
+
+/*
+ * Function: kernel_cache_close(cache)
+ *
+ * Description: Unloads every kernel and frees the cache. The cache directory is left as it is.
+ * Parameters: cache - the kernel cache, or NULL
+ * Returns: none
+ */
+
+void kernel_cache_close(struct Kernel_Cache *cache) {
+    if (cache == NULL) { return; }
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->kernels[i].handle != NULL) { dlclose(cache->kernels[i].handle); }
+        free(cache->kernels[i].code);
+    }
+    free(cache->kernels);
+    free(cache->directory);
+    free(cache);
+}
@@ -0,0 +1,69 @@
+#ifndef CODEGEN_H_INCLUDED
+#define CODEGEN_H_INCLUDED // Include guards
+
+#include <stdio.h> // FILE
+#include <stdint.h>
+#include "parser.h" // struct Program
+
+// ------ Native kernels ------
+// For an expression that is integrated over and over, across many jobs, it is worth handing it to
+// the system's C compiler. The program is written out as a C function: one straight line of
+// arithmetic and libm calls per value of x, with its numbers written in exactly, in a loop over
+// an array of x. That is compiled at -O3 for this machine into a shared object, which is loaded
+// with dlopen() and used in place of the block evaluator (see Integration_Options.kernel).
+//
+// Shared objects are kept in a cache directory, named by the program's hash, so each expression is
+// compiled once, ever, and later jobs (and later runs) just load it. Each is written under a
+// temporary name and renamed into place, so processes sharing the directory never load half of
+// one.
+//
+// A kernel has to give exactly what evaluate_rpn() gives: it is compiled without contracting
+// a * b + c into fused multiply-adds or anything else that rounds differently, and when it is
+// loaded, it is checked against evaluate_rpn() at KERNEL_CHECK_POINTS points, value for value.
+// It is checked again whenever it is wanted for a range outside the one it was checked over.
+// One that doesn't match (or doesn't compile) isn't used, and the expression is evaluated as
+// normal.
+
+// Changes whenever the generated code does, so that kernels from older builds aren't loaded
+#define KERNEL_FORMAT_VERSION 1
+
+// Points each kernel is checked at when it is loaded
+#define KERNEL_CHECK_POINTS 64
+
+// Longest program a kernel is made for: past this, the C compiler takes longer than the kernel
+// would ever save
+#define KERNEL_MAX_TOKENS 4096
+
+// --- Type declarations ---
+
+// Evaluates the expression at count values of x
+typedef void (*Kernel_Function)(const double *x, double *y, int count);
+
+struct Kernel {
+    uint64_t hash; // program_hash() of the program
+    struct Token *code; // A copy of the program's tokens, to tell it from another with its hash
+    int length;
+    Kernel_Function function; // NULL if there isn't a working kernel for the program
+    void *handle; // From dlopen()
+    double checked_start, checked_end; // The range it was last checked over
+};
+
+// The cache directory, and the kernels loaded from it so far
+struct Kernel_Cache {
+    char *directory;
+    const char *compiler; // $CC, or "cc"
+    struct Kernel *kernels;
+    int count, capacity;
+    long compiled, loaded, rejected; // Kernels compiled, loaded and turned down by this process
+};
+
+// --- Function declarations ---
+
+int kernel_write_source(const struct Program *program, FILE *file);
+struct Kernel_Cache *kernel_cache_open(const char *directory);
+Kernel_Function kernel_cache_get(struct Kernel_Cache *cache, const struct Program *program,
+                                 double start, double end, struct Arena *scratch);
+void kernel_cache_close(struct Kernel_Cache *cache);
+const char *kernel_default_directory();
+
+#endif
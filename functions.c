@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include "functions.h"
+#include "token.h"
+
+// ------ Function registry definitions ------
+
+// Block (vector) implementations: a plain loop over the block, which the compiler is free to
+// unroll/vectorize, rather than one indirect call per value. Each function has a double and a
+// single precision (float) version.
+#define DEFINE_VECTOR_FUNCTION(name, scalar_fn, float_fn)          \
+    static void name##_vector(double *values, int count) {         \
+        for (int i = 0; i < count; i++) {                          \
+            values[i] = scalar_fn(values[i]);                      \
+        }                                                          \
+    }                                                              \
+    static void name##_vector_float(float *values, int count) {    \
+        for (int i = 0; i < count; i++) {                          \
+            values[i] = float_fn(values[i]);                       \
+        }                                                          \
+    }
+
+DEFINE_VECTOR_FUNCTION(sin, sin, sinf)
+DEFINE_VECTOR_FUNCTION(cos, cos, cosf)
+DEFINE_VECTOR_FUNCTION(tan, tan, tanf)
+DEFINE_VECTOR_FUNCTION(ln, log, logf)
+DEFINE_VECTOR_FUNCTION(exp, exp, expf)
+DEFINE_VECTOR_FUNCTION(log, log10, log10f)
+DEFINE_VECTOR_FUNCTION(sqrt, sqrt, sqrtf)
+DEFINE_VECTOR_FUNCTION(abs, fabs, fabsf)
+DEFINE_VECTOR_FUNCTION(sinh, sinh, sinhf)
+DEFINE_VECTOR_FUNCTION(cosh, cosh, coshf)
+DEFINE_VECTOR_FUNCTION(tanh, tanh, tanhf)
+DEFINE_VECTOR_FUNCTION(asin, asin, asinf)
+DEFINE_VECTOR_FUNCTION(acos, acos, acosf)
+DEFINE_VECTOR_FUNCTION(atan, atan, atanf)
+
+// Indexed by enum Function_Type, so the order here must match token.h
+const struct Function_Def function_table[Func_Count] = {
+    [Func_Sin]  = { "sin",  "sin",   1, sin,   sin_vector,  sin_vector_float },
+    [Func_Cos]  = { "cos",  "cos",   1, cos,   cos_vector,  cos_vector_float },
+    [Func_Tan]  = { "tan",  "tan",   1, tan,   tan_vector,  tan_vector_float },
+    [Func_Ln]   = { "ln",   "log",   1, log,   ln_vector,   ln_vector_float },
+    [Func_Exp]  = { "exp",  "exp",   1, exp,   exp_vector,  exp_vector_float },
+    [Func_Log]  = { "log",  "log10", 1, log10, log_vector,  log_vector_float },
+    [Func_Sqrt] = { "sqrt", "sqrt",  1, sqrt,  sqrt_vector, sqrt_vector_float },
+    [Func_Abs]  = { "abs",  "fabs",  1, fabs,  abs_vector,  abs_vector_float },
+    [Func_Sinh] = { "sinh", "sinh",  1, sinh,  sinh_vector, sinh_vector_float },
+    [Func_Cosh] = { "cosh", "cosh",  1, cosh,  cosh_vector, cosh_vector_float },
+    [Func_Tanh] = { "tanh", "tanh",  1, tanh,  tanh_vector, tanh_vector_float },
+    [Func_Asin] = { "asin", "asin",  1, asin,  asin_vector, asin_vector_float },
+    [Func_Acos] = { "acos", "acos",  1, acos,  acos_vector, acos_vector_float },
+    [Func_Atan] = { "atan", "atan",  1, atan,  atan_vector, atan_vector_float },
+    [Const_Pi]  = { "pi",   NULL,    0, NULL,  NULL,        NULL,         3.14159265358979323846 },
+    [Const_E]   = { "e",    NULL,    0, NULL,  NULL,        NULL,         2.71828182845904523536 },
+};
+
+// Perfect hash of the names above. The multiplier was found by trying values until every name in
+// the table landed in its own slot, so a lookup is one hash, one table read and one comparison.
+// When adding a function, add it to the table and search for a new multiplier (and/or grow
+// FUNCTION_HASH_SLOTS) so that the slots below stay collision-free.
+#define FUNCTION_HASH_MULTIPLIER 169u
+#define FUNCTION_HASH_SLOTS 32 // must be a power of 2
+
+// Registry index + 1 for each slot (0 = empty slot)
+static const unsigned char function_slots[FUNCTION_HASH_SLOTS] = {
+    [13] = Func_Sin + 1,
+    [15] = Func_Cos + 1,
+    [4]  = Func_Tan + 1,
+    [10] = Func_Ln + 1,
+    [8]  = Func_Exp + 1,
+    [29] = Func_Log + 1,
+    [20] = Func_Sqrt + 1,
+    [27] = Func_Abs + 1,
+    [22] = Func_Sinh + 1,
+    [19] = Func_Cosh + 1,
+    [21] = Func_Tanh + 1,
+    [28] = Func_Asin + 1,
+    [17] = Func_Acos + 1,
+    [30] = Func_Atan + 1,
+    [16] = Const_Pi + 1,
+    [6]  = Const_E + 1,
+};
+
+/*
+ * Function: lookup_function(name, length)
+ *
+ * Description: Finds a function or constant in the registry by name (case insensitive)
+ * Parameters: name, pointer to the first character of the name (need not be null-terminated)
+ *             length, the number of characters in the name
+ * Returns: The registry index (an enum Function_Type value), or -1 if no such name exists
+ */
+
+int lookup_function(const char *name, int length) {
+    unsigned int hash = length;
+    for (int i = 0; i < length; i++) {
+        hash = hash * FUNCTION_HASH_MULTIPLIER + (unsigned char)tolower(name[i]);
+    }
+    hash = (hash ^ (hash >> 5)) & (FUNCTION_HASH_SLOTS - 1);
+
+    int slot = function_slots[hash];
+    if (slot == 0) { return -1; }
+
+    // The hash is only perfect for names in the table, so anything else still needs checking
+    const char *candidate = function_table[slot - 1].name;
+    for (int i = 0; i < length; i++) {
+        if (candidate[i] == '\0' || candidate[i] != tolower(name[i])) { return -1; }
+    }
+    if (candidate[length] != '\0') { return -1; }
+
+    return slot - 1;
+}
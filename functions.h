@@ -0,0 +1,32 @@
+#ifndef FUNCTIONS_H_INCLUDED
+#define FUNCTIONS_H_INCLUDED // Include guards
+
+#include "token.h" // enum Function_Type
+
+// ------ Function registry ------
+// Every named function and constant the tokenizer understands lives in one table, indexed by
+// enum Function_Type. The tokenizer finds names through a perfect hash, and the evaluator calls
+// straight through the table, so adding a function is a matter of adding one enum value and one
+// table row (plus regenerating the hash slots, see functions.c).
+
+// --- Type declarations ---
+
+struct Function_Def {
+    const char *name;
+    const char *c_name; // The C library function it is, for generated code (see codegen.h)
+    int arity; // 1 for functions, 0 for constants (which are substituted for their value)
+    double (*scalar)(double); // f(x) for a single value
+    void (*vector)(double *values, int count); // f(x) applied in place to a block of values
+    void (*vector_float)(float *values, int count); // The same in single precision
+    double value; // Constant-exclusive property
+};
+
+// --- Variable declarations ---
+
+extern const struct Function_Def function_table[Func_Count];
+
+// --- Function declarations ---
+
+int lookup_function(const char *name, int length);
+
+#endif
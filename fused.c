@@ -0,0 +1,374 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "fused.h"
+#include "functions.h"
+#include "vector.h"
+
+#define SIMD_LOOP _Pragma("omp simd")
+
+// ------ Fused evaluation definitions ------
+
+/*
+ * Function: apply(operation, a, b)
+ *
+ * Description: Applies an operator to numbers, for operations on constants
+ * Parameters: operation - the enum Operator_Type
+ *             a, b - the operands (b is unused for Op_Negate)
+ * Returns: The result
+ */
+
+static double apply(int operation, double a, double b) {
+    switch (operation) {
+        case Op_Add: return a + b;
+        case Op_Subtract: return a - b;
+        case Op_Multiply: return a * b;
+        case Op_Divide: return a / b;
+        case Op_Power: return pow(a, b);
+        case Op_Negate: return -a;
+        default: return NAN; // should never happen
+    }
+}
+
+/*
+ * Function: hash_node(node)
+ *
+ * Description: Hashes what a node does (not where its values go), to find nodes that are the same
+ * Parameters: node - the node
+ * Returns: The hash
+ */
+
+static uint64_t hash_node(const struct Fused_Node *node) {
+    uint64_t bits;
+    memcpy(&bits, &node->value, sizeof(bits));
+    uint64_t hash = ((uint64_t)node->type * 31 + node->operation) * 1000003u;
+    hash = (hash ^ (uint32_t)node->a) * 1000003u;
+    hash = (hash ^ (uint32_t)node->b) * 1000003u;
+    hash = (hash ^ bits) * 0x9e3779b97f4a7c15u;
+    return hash ^ (hash >> 29);
+}
+
+// The hash table of nodes built so far, while compiling
+struct Node_Table {
+    int *entries; // Node indexes, or -1 for an empty entry
+    uint64_t mask; // Number of entries - 1 (a power of 2)
+};
+
+/*
+ * Function: intern(fused, table, node)
+ *
+ * Description: Finds the node that does the same as `node`, adding it if there isn't one yet
+ * Parameters: fused - the fused program being compiled
+ *             table - the hash table of its nodes
+ *             node - the node to find
+ * Returns: The index of the node
+ */
+
+static int intern(struct Fused_Program *fused, struct Node_Table *table,
+                  const struct Fused_Node *node) {
+    uint64_t i = hash_node(node) & table->mask;
+    while (table->entries[i] >= 0) {
+        const struct Fused_Node *other = &fused->nodes[table->entries[i]];
+        if (other->type == node->type && other->operation == node->operation &&
+            other->a == node->a && other->b == node->b &&
+            memcmp(&other->value, &node->value, sizeof(double)) == 0) {
+            return table->entries[i];
+        }
+        i = (i + 1) & table->mask;
+    }
+
+    int index = fused->node_count++;
+    fused->nodes[index] = *node;
+    table->entries[i] = index;
+    return index;
+}
+
+/*
+ * Function: make_node(type, operation, a, b, value)
+ *
+ * Description: Makes a node, to be interned
+ * Parameters: the node's fields
+ * Returns: The node
+ */
+
+static inline struct Fused_Node make_node(enum Token_Type type, int operation, int a, int b,
+                                          double value) {
+    struct Fused_Node node = { type, operation, a, b, value, -1, -1, -1 };
+    return node;
+}
+
+/*
+ * Function: needs_slot(fused, index)
+ *
+ * Description: Says whether a node's values need a block of working memory. x is read from the
+ *              points, and constants are used as numbers, unless one is an expression's value.
+ * Parameters: fused - the fused program
+ *             index - the node
+ * Returns: 1 if it needs a block, 0 if not
+ */
+
+static inline int needs_slot(const struct Fused_Program *fused, int index) {
+    const struct Fused_Node *node = &fused->nodes[index];
+    if (node->type == Variable) { return 0; }
+    if (node->type == Number) { return node->output >= 0; }
+    return node->last_use >= 0 || node->output >= 0; // otherwise it's unused
+}
+
+/*
+ * Function: assign_slots(fused, free_slots)
+ *
+ * Description: Gives each node that needs one a block of working memory, reusing the blocks of
+ *              nodes that won't be used again
+ * Parameters: fused - the fused program
+ *             free_slots - working memory for node_count ints
+ * Returns: none
+ */
+
+static void assign_slots(struct Fused_Program *fused, int *free_slots) {
+    int free_count = 0;
+    fused->slot_count = 0;
+
+    for (int n = 0; n < fused->node_count; n++) {
+        struct Fused_Node *node = &fused->nodes[n];
+
+        // An operand last used here can hand its block on to this node: every operation works
+        // value by value, so reading an operand and writing the result in the same place is fine
+        int operands[2] = { node->a, (node->b != node->a) ? node->b : -1 };
+        for (int k = 0; k < 2; k++) {
+            int operand = operands[k];
+            if (operand >= 0 && fused->nodes[operand].last_use == n &&
+                fused->nodes[operand].slot >= 0) {
+                free_slots[free_count++] = fused->nodes[operand].slot;
+            }
+        }
+
+        if (!needs_slot(fused, n)) { continue; }
+        node->slot = (free_count > 0) ? free_slots[--free_count] : fused->slot_count++;
+
+        // An expression's value is copied out as soon as it's worked out, so if nothing else uses
+        // it, its block is free straight away
+        if (node->last_use < 0) { free_slots[free_count++] = node->slot; }
+    }
+}
+
+/*
+ * Function: fused_compile(programs, count, fused, arena)
+ *
+ * Description: Merges compiled expressions into one fused program (see fused.h)
+ * Parameters: programs - the compiled expressions, which must be complete (as checked by the
+ *                        parser)
+ *             count - the number of expressions
+ *             fused - where the fused program is written
+ *             arena - arena the fused program is allocated from (it lasts as long as that
+ *                     memory does)
+ * Returns: 0 on success, -1 if there wasn't enough memory
+ */
+
+int fused_compile(const struct Program *programs, int count, struct Fused_Program *fused,
+                  struct Arena *arena) {
+    int token_count = 0;
+    int max_depth = 1;
+    for (int e = 0; e < count; e++) {
+        token_count += programs[e].length;
+        if (programs[e].max_depth > max_depth) { max_depth = programs[e].max_depth; }
+    }
+
+    fused->nodes = arena_alloc(arena, (token_count + 1) * sizeof(struct Fused_Node));
+    fused->outputs = arena_alloc(arena, (count + 1) * sizeof(int));
+    fused->next_output = arena_alloc(arena, (count + 1) * sizeof(int));
+    if (fused->nodes == NULL || fused->outputs == NULL || fused->next_output == NULL) {
+        return -1;
+    }
+    fused->node_count = 0;
+    fused->expression_count = count;
+    fused->token_count = token_count;
+
+    // Working memory, only needed while compiling
+    struct Arena_Mark mark = arena_mark(arena);
+    struct Node_Table table;
+    uint64_t size = 16;
+    while (size < 2 * (uint64_t)token_count) { size *= 2; }
+    table.mask = size - 1;
+    table.entries = arena_alloc(arena, size * sizeof(int));
+    int *stack = arena_alloc(arena, max_depth * sizeof(int));
+    int *free_slots = arena_alloc(arena, (token_count + 1) * sizeof(int));
+    if (table.entries == NULL || stack == NULL || free_slots == NULL) {
+        arena_release(arena, mark);
+        return -1;
+    }
+    memset(table.entries, 0xff, size * sizeof(int)); // all -1
+
+    for (int e = 0; e < count; e++) {
+        const struct Program *program = &programs[e];
+        int depth = 0;
+
+        for (int t = 0; t < program->length; t++) {
+            const struct Token *token = &program->code[t];
+            struct Fused_Node node;
+
+            if (token->type == Number) {
+                node = make_node(Number, 0, -1, -1, token->value);
+            } else if (token->type == Variable) {
+                node = make_node(Variable, 0, -1, -1, 0);
+            } else if (token->type == Function || token->operator_type == Op_Negate) {
+                const struct Fused_Node *a = &fused->nodes[stack[--depth]];
+                if (a->type == Number) {
+                    double value = (token->type == Function) ?
+                                   function_table[token->function_type].scalar(a->value) :
+                                   -a->value;
+                    node = make_node(Number, 0, -1, -1, value);
+                } else {
+                    node = make_node(token->type,
+                                     (token->type == Function) ? (int)token->function_type :
+                                                                 (int)token->operator_type,
+                                     stack[depth], -1, 0);
+                }
+            } else {
+                int b = stack[--depth];
+                int a = stack[--depth];
+                const struct Fused_Node *node_a = &fused->nodes[a];
+                const struct Fused_Node *node_b = &fused->nodes[b];
+                if (node_a->type == Number && node_b->type == Number) {
+                    node = make_node(Number, 0, -1, -1,
+                                     apply(token->operator_type, node_a->value, node_b->value));
+                } else {
+                    // + and * give exactly the same either way round, so x*2 and 2*x are one node
+                    if ((token->operator_type == Op_Add || token->operator_type == Op_Multiply) &&
+                        a > b) {
+                        int swap = a;
+                        a = b;
+                        b = swap;
+                    }
+                    node = make_node(Operator, token->operator_type, a, b, 0);
+                }
+            }
+
+            stack[depth++] = intern(fused, &table, &node);
+        }
+
+        fused->outputs[e] = (program->length > 0) ? stack[0] : -1;
+    }
+
+    // Which expressions each node is the value of, and where each node is last used
+    for (int e = count - 1; e >= 0; e--) {
+        int output = fused->outputs[e];
+        fused->next_output[e] = (output >= 0) ? fused->nodes[output].output : -1;
+        if (output >= 0) { fused->nodes[output].output = e; }
+    }
+    for (int n = 0; n < fused->node_count; n++) {
+        struct Fused_Node *node = &fused->nodes[n];
+        if (node->a >= 0) { fused->nodes[node->a].last_use = n; }
+        if (node->b >= 0) { fused->nodes[node->b].last_use = n; }
+    }
+
+    assign_slots(fused, free_slots);
+
+    arena_release(arena, mark);
+    return 0;
+}
+
+/*
+ * Function: fused_evaluate_block(fused, x, values, count, scratch)
+ *
+ * Description: Evaluates every expression in a fused program at a block of points
+ * Parameters: fused - the fused program
+ *             x - the points
+ *             values - where the values are written: expression e's values at the points are
+ *                      values[e * VECTOR_BLOCK] onwards
+ *             count - the number of points, at most VECTOR_BLOCK
+ *             scratch - arena for the working memory, handed back before returning
+ * Returns: 0 on success, -1 if there wasn't enough memory
+ */
+
+int fused_evaluate_block(const struct Fused_Program *fused, const double *x, double *values,
+                         int count, struct Arena *scratch) {
+    struct Arena_Mark mark = arena_mark(scratch);
+    int slot_count = (fused->slot_count > 0) ? fused->slot_count : 1;
+    double *slots = arena_alloc(scratch, (size_t)slot_count * VECTOR_BLOCK * sizeof(double));
+    if (slots == NULL) { return -1; }
+    int n = count;
+
+    for (int i = 0; i < fused->node_count; i++) {
+        const struct Fused_Node *node = &fused->nodes[i];
+        double *out = (node->slot >= 0) ? slots + node->slot * VECTOR_BLOCK : NULL;
+        const double *values_of = x; // where this node's values end up
+
+        if (node->type == Variable) {
+            // x is used where it is
+        } else if (node->type == Number) {
+            if (out == NULL) { continue; } // used as a number by the operators
+            double value = node->value;
+            SIMD_LOOP for (int j = 0; j < n; j++) { out[j] = value; }
+            values_of = out;
+        } else if (out == NULL) {
+            continue; // unused (it was only an operand of something worked out on constants)
+        } else if (node->type == Function) {
+            const struct Fused_Node *a = &fused->nodes[node->a];
+            const double *in = (a->type == Variable) ? x : slots + a->slot * VECTOR_BLOCK;
+            if (in != out) { memcpy(out, in, n * sizeof(double)); }
+            function_table[node->operation].vector(out, n);
+            values_of = out;
+        } else if (node->operation == Op_Negate) {
+            const struct Fused_Node *a = &fused->nodes[node->a];
+            const double *in = (a->type == Variable) ? x : slots + a->slot * VECTOR_BLOCK;
+            SIMD_LOOP for (int j = 0; j < n; j++) { out[j] = -in[j]; }
+            values_of = out;
+        } else {
+            const struct Fused_Node *a = &fused->nodes[node->a];
+            const struct Fused_Node *b = &fused->nodes[node->b];
+            const double *in_a = (a->type == Variable) ? x : slots + a->slot * VECTOR_BLOCK;
+            const double *in_b = (b->type == Variable) ? x : slots + b->slot * VECTOR_BLOCK;
+            double ca = a->value;
+            double cb = b->value;
+            int const_a = (a->type == Number);
+            int const_b = (b->type == Number);
+
+// One loop for each case: a is a constant, b is a constant, or neither is
+#define BINARY_LOOPS(expression_ab, expression_cb, expression_ac)                                 \
+            if (const_a) {                                                                        \
+                SIMD_LOOP for (int j = 0; j < n; j++) { out[j] = expression_cb; }                 \
+            } else if (const_b) {                                                                 \
+                SIMD_LOOP for (int j = 0; j < n; j++) { out[j] = expression_ac; }                 \
+            } else {                                                                              \
+                SIMD_LOOP for (int j = 0; j < n; j++) { out[j] = expression_ab; }                 \
+            }
+
+            switch (node->operation) {
+                case Op_Add:
+                    BINARY_LOOPS(in_a[j] + in_b[j], ca + in_b[j], in_a[j] + cb)
+                    break;
+                case Op_Subtract:
+                    BINARY_LOOPS(in_a[j] - in_b[j], ca - in_b[j], in_a[j] - cb)
+                    break;
+                case Op_Multiply:
+                    BINARY_LOOPS(in_a[j] * in_b[j], ca * in_b[j], in_a[j] * cb)
+                    break;
+                case Op_Divide:
+                    BINARY_LOOPS(in_a[j] / in_b[j], ca / in_b[j], in_a[j] / cb)
+                    break;
+                case Op_Power:
+                    if (const_a) { for (int j = 0; j < n; j++) { out[j] = pow(ca, in_b[j]); } }
+                    else if (const_b) { for (int j = 0; j < n; j++) { out[j] = pow(in_a[j], cb); } }
+                    else { for (int j = 0; j < n; j++) { out[j] = pow(in_a[j], in_b[j]); } }
+                    break;
+                default:
+                    for (int j = 0; j < n; j++) { out[j] = NAN; } // should never happen
+                    break;
+            }
+#undef BINARY_LOOPS
+            values_of = out;
+        }
+
+        for (int e = node->output; e >= 0; e = fused->next_output[e]) {
+            memcpy(values + e * VECTOR_BLOCK, values_of, n * sizeof(double));
+        }
+    }
+
+    // Empty expressions are 0
+    for (int e = 0; e < fused->expression_count; e++) {
+        if (fused->outputs[e] < 0) { memset(values + e * VECTOR_BLOCK, 0, n * sizeof(double)); }
+    }
+
+    arena_release(scratch, mark);
+    return 0;
+}
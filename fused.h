@@ -0,0 +1,51 @@
+#ifndef FUSED_H_INCLUDED
+#define FUSED_H_INCLUDED // Include guards
+
+#include "parser.h" // struct Program
+#include "token.h"
+#include "arena.h"
+
+// ------ Fused evaluation ------
+// Integrating many expressions over the same range and grid (e.g. the basis functions of a fit)
+// one at a time pays for the loop, for x, and for every subexpression they have in common once per
+// expression. fused_compile() instead merges their programs into one graph of operations, in
+// which each distinct operation (the same operator or function of the same operands) appears only
+// once, however many expressions use it: sin(x) in x sin(x) and sin(x)^2 is worked out once. Any
+// operation on constants alone is worked out there and then. fused_evaluate_block() then runs the
+// graph over a block of points, giving every expression's values at once.
+//
+// Each operation's values take up a block of working memory only from when they are worked out to
+// when they are last used, so the working memory needed is the most values alive at once, not one
+// block per operation. x is read straight from the points, and a constant operand of an operator
+// is used as a number rather than being spread over a block.
+
+// --- Type declarations ---
+
+struct Fused_Node {
+    enum Token_Type type; // Number, Variable, Function or Operator
+    int operation; // enum Operator_Type or enum Function_Type
+    int a, b; // The operand nodes (-1 if there isn't one)
+    double value; // Number-exclusive
+    int slot; // The block of working memory its values go in (-1 if it doesn't need one)
+    int last_use; // The last node with this as an operand (-1 if there isn't one)
+    int output; // The first expression whose value this is (-1 if none); see next_output
+};
+
+struct Fused_Program {
+    struct Fused_Node *nodes; // In the order they are evaluated (operands before what uses them)
+    int node_count;
+    int expression_count;
+    int *outputs; // The node giving each expression's value (-1 for an empty expression)
+    int *next_output; // The next expression whose value is the same node (-1 if none)
+    int slot_count; // Blocks of working memory needed by fused_evaluate_block()
+    int token_count; // Tokens in all the expressions' programs, to compare with node_count
+};
+
+// --- Function declarations ---
+
+int fused_compile(const struct Program *programs, int count, struct Fused_Program *fused,
+                  struct Arena *arena);
+int fused_evaluate_block(const struct Fused_Program *fused, const double *x, double *values,
+                         int count, struct Arena *scratch);
+
+#endif
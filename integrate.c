@@ -0,0 +1,996 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "integrate.h"
+#include "shunting.h"
+#include "vector.h"
+#include "fused.h"
+
+// Number of points at which the single precision evaluation is checked against double
+#define VALIDATION_POINTS 64
+// Largest relative error accepted from single precision if the options don't say
+#define DEFAULT_FLOAT_TOLERANCE 1e-5
+// Blocks of points between looking at the clock to see if a checkpoint is due
+#define CHECKPOINT_CHECK_BLOCKS 256
+
+// ------ Integration definitions ------
+
+/*
+ * Function: evaluate_block(program, x, y, count, options, scratch)
+ *
+ * Description: Evaluates the integrand at a block of points, with the block evaluator, or the
+ *              options' native kernel if there is one, or one at a time with the profiled
+ *              evaluator if the options ask for profiling
+ * Parameters: program - the compiled expression
+ *             x - where to evaluate it
+ *             y - where the values are written
+ *             count - the number of points, at most VECTOR_BLOCK
+ *             options - the integration options
+ *             scratch - arena for the evaluator's working memory
+ * Returns: 0 on success, -1 if there wasn't enough memory
+ */
+
+static inline int evaluate_block(const struct Program *program, const double *x, double *y,
+                                 int count, const struct Integration_Options *options,
+                                 struct Arena *scratch) {
+    if (options->profile != NULL) {
+        for (int j = 0; j < count; j++) {
+            y[j] = evaluate_rpn_profiled(program->code, program->length, x[j], scratch,
+                                         options->profile);
+        }
+        return 0;
+    }
+    if (options->kernel != NULL) {
+        options->kernel(x, y, count);
+        return 0;
+    }
+    return evaluate_rpn_block(program, x, y, count, scratch);
+}
+
+/*
+ * Function: all_finite(y, count)
+ *
+ * Description: Checks a block of values for NaNs and infinities without a branch per value:
+ *              y * 0 is 0 for every finite y but NaN otherwise, so the sum of them is 0 only if
+ *              every value is finite. The loop is vectorized like the block evaluator's.
+ * Parameters: y - the values
+ *             count - the number of values
+ * Returns: 1 if every value is finite, 0 if not
+ */
+
+static inline int all_finite(const double *y, int count) {
+    double check = 0;
+    #pragma omp simd reduction(+:check)
+    for (int j = 0; j < count; j++) { check += y[j] * 0; }
+    return check == 0;
+}
+
+/*
+ * Function: weight(i, strips, method)
+ *
+ * Description: The weight of the i'th point in the sum of a rule, before multiplying by h/3 for
+ *              Simpson's rule or h/2 for the trapezium rule
+ * Parameters: i - index of the point, from 0 to strips
+ *             strips - number of strips
+ *             method - the rule
+ * Returns: The weight
+ */
+
+static inline double weight(long i, long strips, enum Integration_Method method) {
+    if (i == 0 || i == strips) { return 1; }
+    if (method == Method_Simpson) { return (i % 2 == 0) ? 2 : 4; }
+    return 2;
+}
+
+/*
+ * Function: compensated_add(sum, compensation, value)
+ *
+ * Description: Adds a value to a sum with compensated (Neumaier) summation: the low-order bits
+ *              lost from the sum by each addition are worked out and added up separately, so
+ *              that sum + compensation loses nothing however many values are added
+ * Parameters: sum - the sum
+ *             compensation - the low-order bits lost from it so far
+ *             value - the value to add
+ * Returns: none
+ */
+
+static inline void compensated_add(double *sum, double *compensation, double value) {
+    double total = *sum + value;
+    if (fabs(*sum) >= fabs(value)) { *compensation += (*sum - total) + value; }
+    else { *compensation += (value - total) + *sum; }
+    *sum = total;
+}
+
+/*
+ * Function: float_precision_loss(program, start, h, strips, scratch)
+ *
+ * Description: Estimates how much accuracy evaluating in single precision loses, by evaluating at
+ *              VALIDATION_POINTS points spread over the range in both precisions. The estimate is
+ *              sum(|f32 - f64|) / sum(|f64|), so it is relative to the integral of |f| (an integral
+ *              that nearly cancels out to 0 loses more, relative to its value).
+ * Parameters: program - the compiled expression
+ *             start, h, strips - the grid of points
+ *             scratch - arena for working memory
+ * Returns: The estimated relative error, or infinity if single precision gave a NaN or infinity
+ *          where double precision didn't (e.g. exp(100) overflows a float) or vice versa
+ */
+
+static double float_precision_loss(const struct Program *program, double start, double h,
+                                   long strips, struct Arena *scratch) {
+    struct Arena_Mark mark = arena_mark(scratch);
+    int samples = (strips + 1 < VALIDATION_POINTS) ? (int)strips + 1 : VALIDATION_POINTS;
+    double *x = arena_alloc(scratch, samples * sizeof(double));
+    double *y = arena_alloc(scratch, samples * sizeof(double));
+    float *x_float = arena_alloc(scratch, samples * sizeof(float));
+    float *y_float = arena_alloc(scratch, samples * sizeof(float));
+    if (x == NULL || y == NULL || x_float == NULL || y_float == NULL) {
+        arena_release(scratch, mark);
+        return INFINITY;
+    }
+
+    for (int k = 0; k < samples; k++) {
+        long i = (samples > 1) ? k * strips / (samples - 1) : 0;
+        x[k] = start + i * h;
+        x_float[k] = (float)x[k];
+    }
+
+    double loss = INFINITY;
+    if (evaluate_rpn_block(program, x, y, samples, scratch) == 0 &&
+        evaluate_rpn_block_float(program, x_float, y_float, samples, scratch) == 0) {
+        double error = 0;
+        double magnitude = 0;
+        int mismatched = 0;
+
+        for (int k = 0; k < samples; k++) {
+            if (!isfinite(y[k]) || !isfinite(y_float[k])) {
+                // Both non-finite is no loss of accuracy; only one is
+                if (isfinite(y[k]) || isfinite(y_float[k])) { mismatched = 1; }
+                continue;
+            }
+            error += fabs(y_float[k] - y[k]);
+            magnitude += fabs(y[k]);
+        }
+
+        if (mismatched) { loss = INFINITY; }
+        else if (magnitude > 0) { loss = error / magnitude; }
+        else { loss = (error > 0) ? INFINITY : 0; }
+    }
+
+    arena_release(scratch, mark);
+    return loss;
+}
+
+/*
+ * Function: integrate_float(program, start, h, strips, options, result, scratch)
+ *
+ * Description: Integrates in single precision, VECTOR_BLOCK points at a time with the block
+ *              evaluator, if float_precision_loss() says that is accurate enough for the options'
+ *              tolerance. The weighted values are added up in double precision with compensated
+ *              (Neumaier) summation, so that the sum itself loses nothing however many strips
+ *              there are.
+ * Parameters: program - the compiled expression
+ *             start, h, strips - the grid of points
+ *             options - the integration options
+ *             result - where the result is written
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok, or -1 if single precision isn't accurate enough (in which case the
+ *          caller should integrate in double precision instead)
+ */
+
+static int integrate_float(const struct Program *program, double start, double h, long strips,
+                           const struct Integration_Options *options,
+                           struct Integration_Result *result, struct Arena *scratch) {
+    double tolerance = (options->tolerance > 0) ? options->tolerance : DEFAULT_FLOAT_TOLERANCE;
+
+    result->precision_loss = float_precision_loss(program, start, h, strips, scratch);
+    result->evaluations += 2 * ((strips + 1 < VALIDATION_POINTS) ? strips + 1 : VALIDATION_POINTS);
+    if (!(result->precision_loss <= tolerance)) { return -1; }
+
+    struct Arena_Mark mark = arena_mark(scratch);
+    float *x = arena_alloc(scratch, VECTOR_BLOCK * sizeof(float));
+    float *y = arena_alloc(scratch, VECTOR_BLOCK * sizeof(float));
+    if (x == NULL || y == NULL) {
+        arena_release(scratch, mark);
+        return -1;
+    }
+
+    double sum = 0;
+    double compensation = 0; // the low-order bits lost from sum so far
+
+    for (long first = 0; first <= strips; first += VECTOR_BLOCK) {
+        int n = (strips + 1 - first < VECTOR_BLOCK) ? (int)(strips + 1 - first) : VECTOR_BLOCK;
+
+        for (int j = 0; j < n; j++) { x[j] = (float)(start + (first + j) * h); }
+        if (evaluate_rpn_block_float(program, x, y, n, scratch) != 0) {
+            arena_release(scratch, mark);
+            return -1;
+        }
+        result->evaluations += n;
+
+        for (int j = 0; j < n; j++) {
+            // A NaN or infinity here (which validation missed) might be an overflow of single
+            // precision, so it's left to double precision to say what the answer is
+            if (!isfinite(y[j])) {
+                arena_release(scratch, mark);
+                result->precision_loss = INFINITY;
+                return -1;
+            }
+
+            compensated_add(&sum, &compensation, weight(first + j, strips, options->method) * y[j]);
+        }
+    }
+
+    arena_release(scratch, mark);
+
+    double scale = (options->method == Method_Simpson) ? h / 3 : h / 2;
+    result->value = (sum + compensation) * scale;
+    result->precision = Precision_Float;
+    return Integration_Ok;
+}
+
+/*
+ * Function: richardson(sums, h, result)
+ *
+ * Description: Works out the estimates of Method_Richardson from the sums of the values at the
+ *              points, split up by their index i: the ends, i % 4 == 0, i % 4 == 2 and odd i.
+ *              The points with even i are the trapezium rule's with twice the step, and those
+ *              with i % 4 == 0 with four times the step; the odd ones are the midpoint rule's.
+ *              Simpson's rule is Richardson extrapolation of the trapezium rules, (4 T(h) -
+ *              T(2h)) / 3, and its error goes down as h^4, so extrapolating once more, (16 S(h) -
+ *              S(2h)) / 15 (Boole's rule), gives a better estimate still, and the difference
+ *              between that and S(h) estimates the error of S(h). That is given as the error
+ *              estimate of the extrapolated value, which is normally much more accurate, so
+ *              it's a pessimistic error bar.
+ * Parameters: sums - the four sums
+ *             h - the step between points
+ *             result - where the estimates are written
+ * Returns: none
+ */
+
+static void richardson(const double sums[4], double h, struct Integration_Result *result) {
+    double ends = sums[0];
+    double by_four = 2 * sums[1];
+    double by_two = 2 * sums[2];
+    double odd = 2 * sums[3];
+
+    double trapezium_4h = 2 * h * (ends + by_four);
+    double trapezium_2h = h * (ends + by_four + by_two);
+    double trapezium_h = h / 2 * (ends + by_four + by_two + odd);
+    double simpson_2h = (4 * trapezium_2h - trapezium_4h) / 3;
+    double simpson_h = (4 * trapezium_h - trapezium_2h) / 3;
+
+    result->trapezium = trapezium_h;
+    result->midpoint = h * odd; // 2h * (the sum of the odd points)
+    result->simpson = simpson_h;
+    result->value = (16 * simpson_h - simpson_2h) / 15;
+    result->error_estimate = fabs(result->value - simpson_h);
+}
+
+/*
+ * Function: same_integration(a, b)
+ *
+ * Description: Says whether two checkpoints are of the same integration, i.e. whether one can be
+ *              carried on from where the other left off: the same expression and grid, and the
+ *              same method, NaN and infinity handling and precision, which all decide the sums
+ * Parameters: a, b - the checkpoints
+ * Returns: 1 if they are, 0 if not
+ */
+
+static int same_integration(const struct Checkpoint_State *a, const struct Checkpoint_State *b) {
+    return a->program_hash == b->program_hash && a->start == b->start && a->end == b->end &&
+           a->strips == b->strips && a->method == b->method && a->non_finite == b->non_finite &&
+           a->precision == b->precision;
+}
+
+/*
+ * Function: add_block(state, index, y, n, strips, options)
+ *
+ * Description: Adds a block of values of the integrand to an integration's sums (see
+ *              integrate_double()), after checking them for NaNs and infinities
+ * Parameters: state - the integration's progress
+ *             index - the index of each point in the block
+ *             y - the values at the points (NaNs and infinities are set to 0 if they're skipped)
+ *             n - the number of points
+ *             strips - the number of strips
+ *             options - the integration options
+ * Returns: Integration_Ok, or Integration_Not_Finite if the options say to stop at a NaN or
+ *          infinity and there is one (in which case the block isn't added)
+ */
+
+static int add_block(struct Checkpoint_State *state, const long *index, double *y, int n,
+                     long strips, const struct Integration_Options *options) {
+    if (!all_finite(y, n)) {
+        for (int j = 0; j < n; j++) {
+            if (isfinite(y[j])) { continue; }
+            if (isnan(y[j])) { state->nan_results++; }
+            else { state->inf_results++; }
+            if (index[j] < state->first_bad) { state->first_bad = index[j]; }
+            if (index[j] > state->last_bad) { state->last_bad = index[j]; }
+            if (options->non_finite == Non_Finite_Skip) { y[j] = 0; }
+        }
+        if (options->non_finite == Non_Finite_Stop) { return Integration_Not_Finite; }
+    }
+
+    if (options->method == Method_Richardson) {
+        double block[4] = { 0 };
+        for (int j = 0; j < n; j++) {
+            long i = index[j];
+            block[(i == 0 || i == strips) ? 0 : (i % 4 == 0) ? 1 : (i % 4 == 2) ? 2 : 3] += y[j];
+        }
+        for (int k = 0; k < 4; k++) {
+            compensated_add(&state->sums[k], &state->compensations[k], block[k]);
+        }
+    } else {
+        double block = 0;
+        for (int j = 0; j < n; j++) {
+            block += weight(index[j], strips, options->method) * y[j];
+        }
+        compensated_add(&state->sums[0], &state->compensations[0], block);
+    }
+    return Integration_Ok;
+}
+
+/*
+ * Function: finish(state, status, start, end, h, options, result)
+ *
+ * Description: Writes an integration's result from its sums
+ * Parameters: state - the integration's progress
+ *             status - how it ended: Integration_Ok, or the error it stopped with
+ *             start, end - the limits of integration (start <= end)
+ *             options - the integration options
+ *             result - where the result is written (the counts are added to what's there)
+ * Returns: none
+ */
+
+static void finish(const struct Checkpoint_State *state, int status, double start, double end,
+                   double h, const struct Integration_Options *options,
+                   struct Integration_Result *result) {
+    long strips = state->strips;
+    result->evaluations += state->evaluations;
+    result->nan_results += state->nan_results;
+    result->inf_results += state->inf_results;
+    if (state->last_bad >= 0) {
+        result->bad_start = (state->first_bad > 0) ? start + (state->first_bad - 1) * h : start;
+        result->bad_end = (state->last_bad < strips - 1) ? start + (state->last_bad + 1) * h : end;
+    }
+
+    if (status != Integration_Ok) {
+        result->value = NAN;
+        return;
+    }
+
+    double sums[4];
+    for (int k = 0; k < 4; k++) { sums[k] = state->sums[k] + state->compensations[k]; }
+
+    if (options->method == Method_Richardson) { richardson(sums, h, result); }
+    else { result->value = sums[0] * ((options->method == Method_Simpson) ? h / 3 : h / 2); }
+}
+
+/*
+ * Function: integrate_double(program, start, end, h, strips, options, result, scratch)
+ *
+ * Description: Integrates in double precision, VECTOR_BLOCK points at a time. f(x_0) and f(x_n)
+ *              are added up first and then the points in between in order. Each block's
+ *              weighted values are added up, and then the block's total is added to the running
+ *              sum with compensated summation, so that rounding errors don't build up over
+ *              billions of strips.
+ *
+ *              Each block is checked for NaNs and infinities (e.g. ln of a negative number, or
+ *              tan at a pole) as a whole; only a block that has some is looked at point by point,
+ *              to count them and find where they are. What happens then is up to the options:
+ *              carry on (and end up with a NaN or infinite integral), stop straight away, or
+ *              leave those points out of the sum.
+ *
+ *              Method_Richardson adds the points up in four sums instead of one (see
+ *              richardson()), so every estimate it gives comes from the one set of evaluations.
+ *
+ *              Everything needed to carry on from the end of a block is kept in a struct
+ *              Checkpoint_State, so with a checkpoint writer in the options, it is handed over
+ *              every writer->interval seconds (the clock is only read every
+ *              CHECKPOINT_CHECK_BLOCKS blocks), and an integration that matches the checkpoint
+ *              file carries on from it. The file is deleted when the integration finishes, if it
+ *              is this integration's.
+ * Parameters: program - the compiled expression
+ *             start, end, h, strips - the grid of points
+ *             options - the integration options
+ *             result - where the result is written. If any values weren't finite, bad_start and
+ *                      bad_end are the grid points either side of them.
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok, Integration_Not_Finite if stopped by a NaN or infinity,
+ *          Integration_Interrupted if *options->interrupted was set (after saving a checkpoint,
+ *          if there's a writer), or Integration_Out_Of_Memory
+ */
+
+static int integrate_double(const struct Program *program, double start, double end, double h,
+                            long strips, const struct Integration_Options *options,
+                            struct Integration_Result *result, struct Arena *scratch) {
+    struct Arena_Mark mark = arena_mark(scratch);
+    double *x = arena_alloc(scratch, VECTOR_BLOCK * sizeof(double));
+    double *y = arena_alloc(scratch, VECTOR_BLOCK * sizeof(double));
+    long *index = arena_alloc(scratch, VECTOR_BLOCK * sizeof(long)); // of each point in the block
+    if (x == NULL || y == NULL || index == NULL) {
+        arena_release(scratch, mark);
+        return Integration_Out_Of_Memory;
+    }
+
+    struct Checkpoint_State state = { 0 };
+    state.start = start;
+    state.end = end;
+    state.strips = strips;
+    state.method = options->method;
+    state.non_finite = options->non_finite;
+    state.precision = Precision_Double; // whatever was asked for, this is what the sums are in
+    state.first_bad = strips + 1; // Indices of the first and last non-finite values
+    state.last_bad = -1;
+
+    struct Checkpoint_Writer *checkpoint = options->checkpoint;
+    if (checkpoint != NULL) {
+        state.program_hash = program_hash(program);
+        struct Checkpoint_State saved;
+        if (checkpoint_load(checkpoint, &saved) && same_integration(&saved, &state)) {
+            state = saved;
+            result->resumed_from = state.next;
+        }
+    }
+
+    int status = Integration_Ok;
+    int blocks = 0; // Since the clock was last read
+
+    // The points are worked out from their index (x_i = start + i*h) rather than by adding h over
+    // and over, which would let rounding errors build up until the loop ran for one point too
+    // many (that used to make x on [0, 100] come out as 5066.67)
+    while (state.next < strips) {
+        // The state is complete here, between blocks, so this is where to stop or save it
+        if (options->interrupted != NULL && *options->interrupted) {
+            status = Integration_Interrupted;
+            break;
+        }
+        if (checkpoint != NULL && ++blocks == CHECKPOINT_CHECK_BLOCKS) {
+            blocks = 0;
+            if (checkpoint_due(checkpoint)) { checkpoint_submit(checkpoint, &state); }
+        }
+
+        int n = 0;
+        if (state.next == 0) {
+            index[n] = 0;
+            x[n++] = start;
+            index[n] = strips;
+            x[n++] = end;
+            state.next = 1;
+        } else {
+            long next = state.next;
+            for (; n < VECTOR_BLOCK && next < strips; n++, next++) {
+                index[n] = next;
+                x[n] = start + next * h;
+            }
+            state.next = next;
+        }
+
+        if (evaluate_block(program, x, y, n, options, scratch) != 0) {
+            status = Integration_Out_Of_Memory;
+            break;
+        }
+        state.evaluations += n;
+
+        status = add_block(&state, index, y, n, strips, options);
+        if (status != Integration_Ok) { break; }
+    }
+
+    arena_release(scratch, mark);
+    finish(&state, status, start, end, h, options, result);
+
+    if (status == Integration_Interrupted && checkpoint != NULL) {
+        checkpoint_submit(checkpoint, &state);
+        checkpoint_flush(checkpoint);
+    }
+    if (status == Integration_Ok && checkpoint != NULL) {
+        // The file may be another integration's (a longer job later in a batch, say), which this
+        // one never wrote to: that is left for its own integration to carry on from
+        checkpoint_flush(checkpoint);
+        struct Checkpoint_State saved;
+        if (checkpoint_load(checkpoint, &saved) && same_integration(&saved, &state)) {
+            checkpoint_remove(checkpoint);
+        }
+    }
+    return status;
+}
+
+/*
+ * Function: sample_nodes(program, values, n, first, step, start, end, options, result, scratch)
+ *
+ * Description: Evaluates the integrand at some of the Chebyshev points for n (see
+ *              clenshaw_curtis.h), VECTOR_BLOCK at a time, dealing with NaNs and infinities as
+ *              the options say
+ * Parameters: program - the compiled expression
+ *             values - where the value at point j is written, as values[j]
+ *             n - the number of intervals between the points
+ *             first, step - the points to evaluate: first, first + step, ... up to n
+ *             start, end - the limits of integration (start <= end), which are points n and 0
+ *             options - the integration options
+ *             result - where the counts are added to, and the part of the range any NaNs or
+ *                      infinities were found in is widened to take in them
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok, Integration_Not_Finite if stopped by a NaN or infinity, or
+ *          Integration_Out_Of_Memory
+ */
+
+static int sample_nodes(const struct Program *program, double *values, long n, long first,
+                        long step, double start, double end,
+                        const struct Integration_Options *options,
+                        struct Integration_Result *result, struct Arena *scratch) {
+    struct Arena_Mark mark = arena_mark(scratch);
+    double *x = arena_alloc(scratch, VECTOR_BLOCK * sizeof(double));
+    double *y = arena_alloc(scratch, VECTOR_BLOCK * sizeof(double));
+    if (x == NULL || y == NULL) {
+        arena_release(scratch, mark);
+        return Integration_Out_Of_Memory;
+    }
+
+    double middle = start / 2 + end / 2, half = end / 2 - start / 2;
+    int status = Integration_Ok;
+    for (long j = first; j <= n && status == Integration_Ok;) {
+        long block_first = j;
+        int count = 0;
+        for (; count < VECTOR_BLOCK && j <= n; count++, j += step) {
+            x[count] = (j == 0) ? end : (j == n) ? start :
+                       middle + half * clenshaw_curtis_node(j, n);
+        }
+
+        if (evaluate_block(program, x, y, count, options, scratch) != 0) {
+            status = Integration_Out_Of_Memory;
+            break;
+        }
+        result->evaluations += count;
+
+        if (!all_finite(y, count)) {
+            for (int k = 0; k < count; k++) {
+                if (isfinite(y[k])) { continue; }
+                if (isnan(y[k])) { result->nan_results++; }
+                else { result->inf_results++; }
+                result->bad_start = fmin(result->bad_start, x[k]); // fmin(NaN, x) is x
+                result->bad_end = fmax(result->bad_end, x[k]);
+                if (options->non_finite == Non_Finite_Skip) { y[k] = 0; }
+            }
+            if (options->non_finite == Non_Finite_Stop) { status = Integration_Not_Finite; }
+        }
+        for (int k = 0; k < count; k++) { values[block_first + k * step] = y[k]; }
+    }
+
+    arena_release(scratch, mark);
+    return status;
+}
+
+/*
+ * Function: integrate_clenshaw_curtis(program, start, end, strips, options, result, scratch)
+ *
+ * Description: Integrates with Clenshaw-Curtis quadrature (see clenshaw_curtis.h), starting with
+ *              CLENSHAW_CURTIS_FIRST intervals (or half of strips, if strips is no more than
+ *              that) and doubling them, which only evaluates the new
+ *              points in between the old ones, until the Chebyshev coefficients have converged to
+ *              options->coefficient_tolerance, or there would be more than strips intervals.
+ *              There is always at least one doubling, so that there's an error estimate: the
+ *              difference between the last two estimates, which for a converging series is a
+ *              generous one. Always in double precision, and not checkpointed.
+ * Parameters: program - the compiled expression
+ *             start, end - the limits of integration (start <= end)
+ *             strips - the most intervals to use, a power of two
+ *             options - the integration options
+ *             result - where the result is written. If any values weren't finite, bad_start and
+ *                      bad_end are the first and last points they were found at.
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok, Integration_Not_Finite if stopped by a NaN or infinity,
+ *          Integration_Interrupted if *options->interrupted was set, or
+ *          Integration_Out_Of_Memory
+ */
+
+static int integrate_clenshaw_curtis(const struct Program *program, double start, double end,
+                                     long strips, const struct Integration_Options *options,
+                                     struct Integration_Result *result, struct Arena *scratch) {
+    double tolerance = (options->coefficient_tolerance > 0) ? options->coefficient_tolerance :
+                                                              CLENSHAW_CURTIS_TOLERANCE;
+    double half = end / 2 - start / 2;
+    struct Arena_Mark mark = arena_mark(scratch);
+
+    // Start low enough to double at least once (strips is at least 2)
+    long n = (strips <= CLENSHAW_CURTIS_FIRST) ? strips / 2 : CLENSHAW_CURTIS_FIRST;
+    double *values = arena_alloc(scratch, (n + 1) * sizeof(double));
+    int status = (values != NULL) ?
+                 sample_nodes(program, values, n, 0, 1, start, end, options, result, scratch) :
+                 Integration_Out_Of_Memory;
+    double previous = NAN;
+
+    while (status == Integration_Ok) {
+        struct Arena_Mark before = arena_mark(scratch);
+        double *coefficients = arena_alloc(scratch, (n + 1) * sizeof(double));
+        if (coefficients == NULL ||
+            clenshaw_curtis_coefficients(values, n, coefficients, scratch) != 0) {
+            status = Integration_Out_Of_Memory;
+            break;
+        }
+        result->value = half * clenshaw_curtis_sum(coefficients, n);
+        result->error_estimate = fabs(result->value - previous);
+        int converged = clenshaw_curtis_converged(coefficients, n, tolerance) && !isnan(previous);
+        arena_release(scratch, before);
+
+        // More points won't make a NaN or infinite integral any better
+        if (converged || n >= strips || !isfinite(result->value)) { break; }
+        if (options->interrupted != NULL && *options->interrupted) {
+            status = Integration_Interrupted;
+            break;
+        }
+
+        // Double n: the old points are the even ones of the new, so only the odd ones are new
+        double *more = arena_alloc(scratch, (2 * n + 1) * sizeof(double));
+        if (more == NULL) {
+            status = Integration_Out_Of_Memory;
+            break;
+        }
+        for (long j = 0; j <= n; j++) { more[2 * j] = values[j]; }
+        values = more;
+        n *= 2;
+        previous = result->value;
+        status = sample_nodes(program, values, n, 1, 2, start, end, options, result, scratch);
+    }
+
+    arena_release(scratch, mark);
+    if (status != Integration_Ok) { result->value = NAN; }
+    return status;
+}
+
+/*
+ * Function: reset_result(result)
+ *
+ * Description: Sets a result's counts to 0, and its estimates to NaN, before integrating
+ * Parameters: result - the result
+ * Returns: none
+ */
+
+static void reset_result(struct Integration_Result *result) {
+    result->value = NAN;
+    result->nan_results = 0;
+    result->inf_results = 0;
+    result->evaluations = 0;
+    result->precision = Precision_Double;
+    result->precision_loss = 0;
+    result->from_surrogate = 0;
+    result->exact = 0;
+    result->bad_start = NAN;
+    result->bad_end = NAN;
+    result->trapezium = NAN;
+    result->midpoint = NAN;
+    result->simpson = NAN;
+    result->error_estimate = NAN;
+    result->resumed_from = 0;
+}
+
+/*
+ * Function: integrate_strips(options)
+ *
+ * Description: Rounds the number of strips up to what the method needs: an even number for
+ *              Simpson's rule, which works on pairs of strips, a multiple of 4 for
+ *              Method_Richardson, for Simpson's rule with twice the step as well, and a power of
+ *              two for Method_Clenshaw_Curtis, whose number of intervals doubles
+ * Parameters: options - the integration options
+ * Returns: The number of strips to use
+ */
+
+long integrate_strips(const struct Integration_Options *options) {
+    long strips = options->strips;
+    if (options->method == Method_Simpson && strips % 2 != 0) { strips++; }
+    if (options->method == Method_Richardson && strips % 4 != 0) { strips += 4 - strips % 4; }
+    if (options->method == Method_Clenshaw_Curtis) {
+        long power = 2;
+        while (power < strips && power <= LONG_MAX / 2) { power *= 2; }
+        strips = power;
+    }
+    return strips;
+}
+
+/*
+ * Function: integrate(program, start, end, options, result, scratch)
+ *
+ * Description: Numerically integrates a compiled expression over a range
+ * Parameters: program - the compiled expression
+ *             start, end - the limits of integration (in either order)
+ *             options - how to integrate: the method and number of strips (rounded up to an
+ *                       even number for Simpson's rule, a multiple of 4 for Method_Richardson,
+ *                       and a power of two for Method_Clenshaw_Curtis, for which it is the most
+ *                       intervals it may use), and the precision. Single precision falls back to
+ *                       double if it isn't accurate enough; the result says which was used.
+ *                       Method_Richardson and Method_Clenshaw_Curtis are always in double
+ *                       precision. If the options have a surrogate fitted over the limits, its
+ *                       integral is used instead, and nothing is evaluated. Polynomials are
+ *                       integrated exactly (unless profiling or told not to), and again nothing
+ *                       is evaluated. Only double precision is checkpointed, and not
+ *                       Method_Clenshaw_Curtis.
+ *             result - where the estimate of the integral (and some statistics) is written
+ *             scratch - arena for the evaluator's working memory
+ * Returns: Integration_Ok, or a (negative) enum Integration_Status: Integration_Not_Finite if
+ *          options->non_finite said to stop at a NaN or infinity, and one was found, or
+ *          Integration_Interrupted if options->interrupted was set before it finished
+ */
+
+int integrate(const struct Program *program, double start, double end,
+              const struct Integration_Options *options, struct Integration_Result *result,
+              struct Arena *scratch) {
+    if (options->strips <= 0) { return Integration_Invalid_Options; }
+
+    // Swap because integration method goes from lowest to highest
+    if (start > end) {
+        double tmp;
+        tmp = start;
+        start = end;
+        end = tmp;
+    }
+
+    long strips = integrate_strips(options);
+    double h = (end - start) / strips;
+
+    reset_result(result);
+
+    // The profiler is there to look at evaluation, so it wouldn't want this skipped
+    struct Polynomial polynomial;
+    if (!options->force_numeric && options->profile == NULL &&
+        polynomial_from_program(program, &polynomial, scratch)) {
+        result->value = polynomial_integral(&polynomial, start, end);
+        result->exact = 1;
+        result->error_estimate = 0;
+        return Integration_Ok;
+    }
+
+    if (options->surrogate != NULL && chebyshev_covers(options->surrogate, start, end)) {
+        result->value = chebyshev_integral(options->surrogate, start, end);
+        result->from_surrogate = 1;
+        return Integration_Ok;
+    }
+
+    if (options->method == Method_Clenshaw_Curtis) {
+        return integrate_clenshaw_curtis(program, start, end, strips, options, result, scratch);
+    }
+
+    // Single precision (not profiled: the profiler only instruments the double evaluator)
+    if (options->precision == Precision_Float && options->profile == NULL &&
+        options->method != Method_Richardson && options->checkpoint == NULL &&
+        integrate_float(program, start, h, strips, options, result, scratch) == Integration_Ok) {
+        return Integration_Ok;
+    }
+
+    return integrate_double(program, start, end, h, strips, options, result, scratch);
+}
+
+/*
+ * Function: integrate_fused(fused, start, end, options, results, statuses, scratch)
+ *
+ * Description: Integrates every expression in a fused program (see fused.h) over the same range
+ *              and grid of points, evaluating each block of points once for all of them. Each
+ *              expression's sums are kept as integrate_double() keeps them, so each result is the
+ *              same as integrating that expression on its own with integrate_double(). An
+ *              expression that is stopped by a NaN or infinity doesn't stop the others.
+ * Parameters: fused - the fused program
+ *             start, end - the limits of integration (in either order)
+ *             options - how to integrate, as for integrate(), but always numerically and in
+ *                       double precision: the precision, surrogate, profile and checkpoint are
+ *                       unused, and polynomials aren't integrated exactly. The method has to be
+ *                       one with a grid of points, so not Method_Clenshaw_Curtis.
+ *             results - where each expression's result is written
+ *             statuses - where each expression's status is written (Integration_Ok or
+ *                        Integration_Not_Finite), or NULL
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok (even if some expressions' statuses aren't), or a (negative) enum
+ *          Integration_Status for the whole integration: Integration_Invalid_Options,
+ *          Integration_Interrupted or Integration_Out_Of_Memory
+ */
+
+int integrate_fused(const struct Fused_Program *fused, double start, double end,
+                    const struct Integration_Options *options, struct Integration_Result *results,
+                    int *statuses, struct Arena *scratch) {
+    if (options->strips <= 0 || options->method == Method_Clenshaw_Curtis) {
+        return Integration_Invalid_Options;
+    }
+    if (start > end) {
+        double tmp = start;
+        start = end;
+        end = tmp;
+    }
+
+    long strips = integrate_strips(options);
+    double h = (end - start) / strips;
+    int count = fused->expression_count;
+
+    struct Arena_Mark mark = arena_mark(scratch);
+    double *x = arena_alloc(scratch, VECTOR_BLOCK * sizeof(double));
+    double *y = arena_alloc(scratch, ((size_t)count + 1) * VECTOR_BLOCK * sizeof(double));
+    long *index = arena_alloc(scratch, VECTOR_BLOCK * sizeof(long));
+    struct Checkpoint_State *states = arena_alloc(scratch, ((size_t)count + 1) *
+                                                           sizeof(struct Checkpoint_State));
+    int *status = arena_alloc(scratch, ((size_t)count + 1) * sizeof(int));
+    if (x == NULL || y == NULL || index == NULL || states == NULL || status == NULL) {
+        arena_release(scratch, mark);
+        return Integration_Out_Of_Memory;
+    }
+
+    for (int e = 0; e < count; e++) {
+        reset_result(&results[e]);
+        memset(&states[e], 0, sizeof(struct Checkpoint_State));
+        states[e].strips = strips;
+        states[e].first_bad = strips + 1;
+        states[e].last_bad = -1;
+        status[e] = Integration_Ok;
+    }
+
+    int overall = Integration_Ok;
+    long next = 0;
+    while (next < strips) {
+        if (options->interrupted != NULL && *options->interrupted) {
+            overall = Integration_Interrupted;
+            break;
+        }
+
+        // The same blocks of points as integrate_double(): the ends, then the points in between
+        int n = 0;
+        if (next == 0) {
+            index[n] = 0;
+            x[n++] = start;
+            index[n] = strips;
+            x[n++] = end;
+            next = 1;
+        } else {
+            for (; n < VECTOR_BLOCK && next < strips; n++, next++) {
+                index[n] = next;
+                x[n] = start + next * h;
+            }
+        }
+
+        if (fused_evaluate_block(fused, x, y, n, scratch) != 0) {
+            overall = Integration_Out_Of_Memory;
+            break;
+        }
+
+        for (int e = 0; e < count; e++) {
+            if (status[e] != Integration_Ok) { continue; }
+            states[e].evaluations += n;
+            status[e] = add_block(&states[e], index, y + e * VECTOR_BLOCK, n, strips, options);
+        }
+    }
+
+    for (int e = 0; e < count; e++) {
+        finish(&states[e], (overall != Integration_Ok) ? overall : status[e], start, end, h,
+               options, &results[e]);
+        if (statuses != NULL) { statuses[e] = (overall != Integration_Ok) ? overall : status[e]; }
+    }
+
+    arena_release(scratch, mark);
+    return overall;
+}
+
+/*
+ * Function: integrate_sweep_part(program, parameters, n, start, end, strips, first, last,
+ *                                options, states, scratch)
+ *
+ * Description: Does part of the integrations of a sweep (see sweep.h): adds up the values of an
+ *              expression with parameters at the grid points from first up to (but not
+ *              including) last, for n sets of values of the parameters at once. The points go in
+ *              the same blocks as in integrate_double(), as long as first is 0, or 1 more than a
+ *              multiple of VECTOR_BLOCK, and each set's sums are kept in the same way, so an
+ *              integral done in one part is the same as integrate_double() gives with the
+ *              parameters' values written into the expression.
+ * Parameters: program - the compiled expression, with parameters
+ *             parameters - the sets of values, as for evaluate_rpn_parameters()
+ *             n - the number of sets, at most VECTOR_BLOCK
+ *             start, end, strips - the grid of points (start <= end, and strips as from
+ *                                  integrate_strips())
+ *             first, last - the part of the grid: point 0 stands for both ends, then the points
+ *                           in between are 1 to strips - 1
+ *             options - the integration options (only the method and non_finite are used)
+ *             states - where each set's sums for this part are written (n of them)
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok (even if some sets were stopped by a NaN or infinity), or
+ *          Integration_Interrupted or Integration_Out_Of_Memory
+ */
+
+int integrate_sweep_part(const struct Program *program, const double *parameters, int n,
+                         double start, double end, long strips, long first, long last,
+                         const struct Integration_Options *options,
+                         struct Checkpoint_State *states, struct Arena *scratch) {
+    double h = (end - start) / strips;
+    struct Arena_Mark mark = arena_mark(scratch);
+    double *y = arena_alloc(scratch, (size_t)VECTOR_BLOCK * VECTOR_BLOCK * sizeof(double));
+    double *column = arena_alloc(scratch, VECTOR_BLOCK * sizeof(double));
+    long *index = arena_alloc(scratch, VECTOR_BLOCK * sizeof(long));
+    int *status = arena_alloc(scratch, VECTOR_BLOCK * sizeof(int));
+    if (y == NULL || column == NULL || index == NULL || status == NULL) {
+        arena_release(scratch, mark);
+        return Integration_Out_Of_Memory;
+    }
+
+    for (int j = 0; j < n; j++) {
+        memset(&states[j], 0, sizeof(struct Checkpoint_State));
+        states[j].strips = strips;
+        states[j].method = options->method;
+        states[j].non_finite = options->non_finite;
+        states[j].precision = Precision_Double;
+        states[j].first_bad = strips + 1;
+        states[j].last_bad = -1;
+        status[j] = Integration_Ok;
+    }
+
+    int overall = Integration_Ok;
+    long next = first;
+    while (next < last) {
+        if (options->interrupted != NULL && *options->interrupted) {
+            overall = Integration_Interrupted;
+            break;
+        }
+
+        int points = 0;
+        if (next == 0) {
+            index[points++] = 0;
+            index[points++] = strips;
+            next = 1;
+        } else {
+            for (; points < VECTOR_BLOCK && next < last; points++, next++) { index[points] = next; }
+        }
+
+        // Each point gives a column of values, one per set; each set's row is then one block for
+        // add_block()
+        for (int p = 0; p < points; p++) {
+            double x = (index[p] == strips) ? end : start + index[p] * h;
+            if (evaluate_rpn_parameters(program, x, parameters, column, n, scratch) != 0) {
+                overall = Integration_Out_Of_Memory;
+                break;
+            }
+            for (int j = 0; j < n; j++) { y[j * VECTOR_BLOCK + p] = column[j]; }
+        }
+        if (overall != Integration_Ok) { break; }
+
+        for (int j = 0; j < n; j++) {
+            if (status[j] != Integration_Ok) { continue; }
+            states[j].evaluations += points;
+            status[j] = add_block(&states[j], index, y + j * VECTOR_BLOCK, points, strips,
+                                  options);
+        }
+    }
+
+    arena_release(scratch, mark);
+    return overall;
+}
+
+/*
+ * Function: integrate_sweep_finish(parts, count, stride, start, end, options, result)
+ *
+ * Description: Puts together one set of parameters' sums from the parts of a sweep (see
+ *              integrate_sweep_part()), in order, and works out its integral
+ * Parameters: parts - the set's sums from each part, in the order of the grid
+ *             count - the number of parts
+ *             stride - how far apart they are in parts (e.g. 1 if they are next to each other)
+ *             start, end, h - the grid of points
+ *             options - the integration options
+ *             result - where the result is written
+ * Returns: Integration_Ok, or Integration_Not_Finite if the options said to stop at a NaN or
+ *          infinity and there was one (the value is then NaN)
+ */
+
+int integrate_sweep_finish(const struct Checkpoint_State *parts, int count, long stride,
+                           double start, double end, const struct Integration_Options *options,
+                           struct Integration_Result *result) {
+    struct Checkpoint_State state = parts[0];
+    for (int p = 1; p < count; p++) {
+        const struct Checkpoint_State *part = &parts[p * stride];
+        state.evaluations += part->evaluations;
+        state.nan_results += part->nan_results;
+        state.inf_results += part->inf_results;
+        if (part->first_bad < state.first_bad) { state.first_bad = part->first_bad; }
+        if (part->last_bad > state.last_bad) { state.last_bad = part->last_bad; }
+        for (int k = 0; k < 4; k++) {
+            compensated_add(&state.sums[k], &state.compensations[k], part->sums[k]);
+            state.compensations[k] += part->compensations[k];
+        }
+    }
+
+    int status = (options->non_finite == Non_Finite_Stop && state.last_bad >= 0) ?
+                 Integration_Not_Finite : Integration_Ok;
+    reset_result(result);
+    finish(&state, status, start, end, (end - start) / state.strips, options, result);
+    return status;
+}
@@ -0,0 +1,112 @@
+#ifndef INTEGRATE_H_INCLUDED
+#define INTEGRATE_H_INCLUDED // Include guards
+
+#include <signal.h> // sig_atomic_t
+#include "parser.h" // struct Program
+#include "arena.h"
+#include "profile.h"
+#include "chebyshev.h"
+#include "polynomial.h"
+#include "checkpoint.h"
+#include "fused.h"
+#include "codegen.h"
+#include "clenshaw_curtis.h"
+
+// --- Type declarations ---
+
+enum Integration_Method {
+    Method_Simpson,
+    Method_Trapezium,
+    Method_Richardson, // Trapezium, midpoint and Simpson's rules from the same points, combined
+                       // into a better estimate with an error estimate; see integrate_double()
+    Method_Clenshaw_Curtis // The polynomial through Chebyshev points, doubling them until it has
+                           // converged, with an error estimate; see clenshaw_curtis.h
+};
+
+// Precision the integrand is evaluated in
+enum Integration_Precision {
+    Precision_Double,
+    Precision_Float // About 7 significant figures, but twice as many values per SIMD instruction
+};
+
+// What to do about values of the integrand that are NaN or infinite (e.g. ln(-1), or tan at a
+// pole), which make the integral NaN or infinite too
+enum Non_Finite_Policy {
+    Non_Finite_Continue, // Integrate as normal; the result will be NaN or infinite
+    Non_Finite_Stop, // Stop at the first block of points with any, returning Integration_Not_Finite
+    Non_Finite_Skip // Leave them out of the sum, i.e. integrate the rest of the range
+};
+
+// Status returned by integrate(). The values carry on from enum Parse_Error, so that the two
+// don't overlap, and match enum Integration_Error in integration.h.
+enum Integration_Status {
+    Integration_Ok = 0,
+    Integration_Out_Of_Memory = -4, // The same as Parse_Out_Of_Memory
+    Integration_Invalid_Options = -5, // e.g. a non-positive number of strips
+    Integration_Not_Finite = -8, // The integrand was NaN or infinite, and the options said to stop
+    Integration_Interrupted = -10 // options->interrupted was set
+};
+
+// How to integrate. Further settings are added here rather than as extra parameters, so that
+// callers that don't use them are unaffected.
+struct Integration_Options {
+    enum Integration_Method method;
+    long strips; // The number of strips used in the approximation
+    struct Eval_Profile *profile; // If not NULL, every evaluation is profiled into this (slowly)
+    enum Integration_Precision precision; // Precision_Double unless asked for
+    double tolerance; // For Precision_Float: the largest relative error accepted from single
+                      // precision before falling back to double (0 for the default, 1e-5)
+    const struct Chebyshev_Surrogate *surrogate; // If not NULL and fitted over the limits, the
+                                                 // integral is the surrogate's (exact) integral
+                                                 // instead, and the method and strips are unused
+    int force_numeric; // Integrate polynomials with the method too, rather than exactly
+    enum Non_Finite_Policy non_finite; // Non_Finite_Continue unless asked for
+    struct Checkpoint_Writer *checkpoint; // If not NULL, progress is saved every so often, and
+                                          // carried on from if it is for the same integration
+    const volatile sig_atomic_t *interrupted; // If not NULL, integration stops (saving a
+                                              // checkpoint) once this is set, e.g. by a signal
+    Kernel_Function kernel; // If not NULL, the program compiled to native code (see codegen.h),
+                            // used in place of the block evaluator in double precision
+    double coefficient_tolerance; // For Method_Clenshaw_Curtis: how small the last Chebyshev
+                                  // coefficients have to get, relative to the largest (0 for the
+                                  // default, CLENSHAW_CURTIS_TOLERANCE)
+};
+
+struct Integration_Result {
+    double value; // The estimate of the integral
+    long evaluations; // Number of times the expression was evaluated
+    long nan_results; // Number of those evaluations that gave NaN (e.g. ln(-1))...
+    long inf_results; // ...or +/- infinity (e.g. 1/0)
+    enum Integration_Precision precision; // The precision actually used
+    double precision_loss; // If single precision was asked for, the estimated relative error it
+                           // causes (whether or not it was then used)
+    int from_surrogate; // 1 if the value is the integral of options->surrogate
+    int exact; // 1 if the expression was a polynomial, and so integrated exactly
+    double bad_start, bad_end; // If any values were NaN or infinite, the part of the range they
+                               // were found in (otherwise NaN)
+    // With Method_Richardson, the estimates value was worked out from (otherwise NaN), and the
+    // estimated error of value (0 if it is exact, NaN if there isn't an estimate; with
+    // Method_Clenshaw_Curtis, the difference from the estimate with half as many points)
+    double trapezium, midpoint, simpson;
+    double error_estimate;
+    long resumed_from; // The grid point carried on from, if there was a checkpoint (otherwise 0)
+};
+
+// --- Function declarations ---
+
+int integrate(const struct Program *program, double start, double end,
+              const struct Integration_Options *options, struct Integration_Result *result,
+              struct Arena *scratch);
+int integrate_fused(const struct Fused_Program *fused, double start, double end,
+                    const struct Integration_Options *options, struct Integration_Result *results,
+                    int *statuses, struct Arena *scratch);
+long integrate_strips(const struct Integration_Options *options);
+int integrate_sweep_part(const struct Program *program, const double *parameters, int n,
+                         double start, double end, long strips, long first, long last,
+                         const struct Integration_Options *options,
+                         struct Checkpoint_State *states, struct Arena *scratch);
+int integrate_sweep_finish(const struct Checkpoint_State *parts, int count, long stride,
+                           double start, double end, const struct Integration_Options *options,
+                           struct Integration_Result *result);
+
+#endif
@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "integration.h"
+#include "parser.h"
+#include "shunting.h"
+#include "arena.h"
+#include "chebyshev.h"
+#include "tokenize.h"
+#include "sweep.h"
+#include "threaded.h"
+
+// Initial size of a context's working memory. It grows past this for long expressions.
+#define CONTEXT_ARENA_SIZE (64 * 1024)
+
+// --- Type declarations ---
+
+struct Integration_Context {
+    struct Arena arena; // Working memory, reset at the start of each call
+    int error_offset; // Where in the expression the last compile error was found
+};
+
+// A compiled expression is one allocation: the program followed by its code
+struct Integration_Expression {
+    struct Program program;
+    int parameter_count; // Only integration_sweep() can integrate an expression with parameters
+    struct Threaded_Program threaded; // For integration_evaluate(), if there aren't parameters
+    struct Token code[]; // Followed by threaded's instructions
+};
+
+/*
+ * ----------------------------------------------
+ * Function definitions
+ * ----------------------------------------------
+ */
+
+/*
+ * Function: integration_context_create()
+ *
+ * Description: Creates a context, which holds the working memory used by the library's other
+ *              functions. A context must only be used by one thread at a time.
+ * Parameters: none
+ * Returns: The context, or NULL if there wasn't enough memory
+ */
+
+struct Integration_Context *integration_context_create() {
+    struct Integration_Context *context = malloc(sizeof(struct Integration_Context));
+    if (context == NULL) { return NULL; }
+
+    if (arena_init(&context->arena, CONTEXT_ARENA_SIZE) != 0) {
+        free(context);
+        return NULL;
+    }
+    context->error_offset = 0;
+
+    return context;
+}
+
+/*
+ * Function: integration_context_free(context)
+ *
+ * Description: Frees a context. Expressions compiled with it are unaffected.
+ * Parameters: context - the context, or NULL
+ * Returns: none
+ */
+
+void integration_context_free(struct Integration_Context *context) {
+    if (context == NULL) { return; }
+    arena_free(&context->arena);
+    free(context);
+}
+
+/*
+ * Function: integration_compile(context, expression, length, compiled)
+ *
+ * Description: Compiles an expression, e.g. "4(sin(x))^2 + 2", for evaluating and integrating
+ * Parameters: context - the calling thread's context
+ *             expression, length - the expression (need not be null-terminated)
+ *             compiled - where the compiled expression is written, to be freed with
+ *                        integration_expression_free(). Set to NULL on failure.
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error. For a syntax error,
+ *          integration_error_offset() says where in the expression it was found.
+ */
+
+int integration_compile(struct Integration_Context *context, const char *expression,
+                        size_t length, struct Integration_Expression **compiled) {
+    return integration_compile_parameters(context, expression, length, NULL, 0, compiled);
+}
+
+/*
+ * Function: integration_compile_parameters(context, expression, length, names, count, compiled)
+ *
+ * Description: Compiles an expression with parameters as well as x, e.g. "a sin(b x)" with the
+ *              parameters a and b, to be integrated for many values of them with
+ *              integration_sweep() (and only that)
+ * Parameters: context - the calling thread's context
+ *             expression, length - the expression (need not be null-terminated)
+ *             names - the parameters' names (letters only, not starting with x), in the order
+ *                     their values are given to integration_sweep()
+ *             count - the number of parameters, at most SWEEP_MAX_PARAMETERS
+ *             compiled - as for integration_compile()
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error
+ */
+
+int integration_compile_parameters(struct Integration_Context *context, const char *expression,
+                                   size_t length, const char *const *names, int count,
+                                   struct Integration_Expression **compiled) {
+    if (compiled != NULL) { *compiled = NULL; }
+    if (context == NULL || expression == NULL || compiled == NULL || count < 0 ||
+        count > SWEEP_MAX_PARAMETERS || (count > 0 && names == NULL)) {
+        return Integration_Error_Invalid_Argument;
+    }
+    for (int i = 0; i < count; i++) {
+        if (names[i] == NULL || !valid_parameter_name(names[i])) {
+            return Integration_Error_Invalid_Argument;
+        }
+        for (int j = 0; j < i; j++) {
+            if (strcmp(names[i], names[j]) == 0) { return Integration_Error_Invalid_Argument; }
+        }
+    }
+
+    arena_reset(&context->arena);
+
+    struct Program program;
+    int rc = compile_parameterized(expression, length, names, count, &context->arena, &program);
+    context->error_offset = program.error_offset;
+
+    if (rc < 0) { return rc; } // enum Parse_Error has the same values as enum Integration_Error
+    if (rc == 0) { return Integration_Error_Empty_Expression; }
+
+    // The program was compiled into the context's arena; copy it out into memory of its own
+    // (struct Token's size is a multiple of 8, so the instructions after it are aligned)
+    struct Integration_Expression *result = malloc(sizeof(struct Integration_Expression) +
+                                                   program.length * sizeof(struct Token) +
+                                                   (program.length + 1) *
+                                                   sizeof(struct Threaded_Instruction));
+    if (result == NULL) { return Integration_Error_Out_Of_Memory; }
+
+    memcpy(result->code, program.code, program.length * sizeof(struct Token));
+    result->program = program;
+    result->program.code = result->code;
+    result->parameter_count = count;
+
+    // The tokens' text still points into the caller's expression string, which may not outlive
+    // the compiled expression; nothing after compiling uses it
+    for (int i = 0; i < program.length; i++) {
+        result->code[i].text = NULL;
+        result->code[i].text_length = 0;
+    }
+    if (count == 0) {
+        threaded_compile(&result->program,
+                         (struct Threaded_Instruction *)(result->code + program.length),
+                         &result->threaded);
+    }
+
+    *compiled = result;
+    return Integration_Ok;
+}
+
+/*
+ * Function: integration_error_offset(context)
+ *
+ * Description: Says where the last syntax error found by integration_compile() was
+ * Parameters: context - the context the expression was compiled with
+ * Returns: The offset of the error from the start of the expression, in characters
+ */
+
+int integration_error_offset(const struct Integration_Context *context) {
+    return (context == NULL) ? 0 : context->error_offset;
+}
+
+/*
+ * Function: integration_expression_free(expression)
+ *
+ * Description: Frees a compiled expression
+ * Parameters: expression - the expression, or NULL
+ * Returns: none
+ */
+
+void integration_expression_free(struct Integration_Expression *expression) {
+    free(expression);
+}
+
+/*
+ * Function: integration_evaluate(context, expression, x, value)
+ *
+ * Description: Evaluates a compiled expression at one value of x
+ * Parameters: context - the calling thread's context
+ *             expression - the compiled expression
+ *             x - the value of x
+ *             value - where the value of the expression is written
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error
+ */
+
+int integration_evaluate(struct Integration_Context *context,
+                         const struct Integration_Expression *expression, double x,
+                         double *value) {
+    if (context == NULL || expression == NULL || value == NULL ||
+        expression->parameter_count > 0) {
+        return Integration_Error_Invalid_Argument;
+    }
+
+    arena_reset(&context->arena);
+    *value = evaluate_threaded(&expression->threaded, x, &context->arena);
+    return Integration_Ok;
+}
+
+/*
+ * Function: valid_options(options)
+ *
+ * Description: Checks that integration options are ones the library understands
+ * Parameters: options - the options
+ * Returns: 1 if they are, 0 if not
+ */
+
+static int valid_options(const struct Integration_Options *options) {
+    return (options->method == Method_Simpson || options->method == Method_Trapezium ||
+            options->method == Method_Richardson || options->method == Method_Clenshaw_Curtis) &&
+           (options->precision == Precision_Double || options->precision == Precision_Float) &&
+           options->tolerance >= 0 && options->coefficient_tolerance >= 0 &&
+           options->non_finite >= Non_Finite_Continue &&
+           options->non_finite <= Non_Finite_Skip;
+}
+
+/*
+ * Function: integration_integrate(context, expression, start, end, options, result)
+ *
+ * Description: Numerically integrates a compiled expression over a range
+ * Parameters: context - the calling thread's context
+ *             expression - the compiled expression
+ *             start, end - the limits of integration (in either order)
+ *             options - how to integrate; see struct Integration_Options
+ *             result - where the estimate of the integral (and some statistics) is written
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error
+ */
+
+int integration_integrate(struct Integration_Context *context,
+                          const struct Integration_Expression *expression, double start,
+                          double end, const struct Integration_Options *options,
+                          struct Integration_Result *result) {
+    if (context == NULL || expression == NULL || options == NULL || result == NULL ||
+        !isfinite(start) || !isfinite(end) || expression->parameter_count > 0) {
+        return Integration_Error_Invalid_Argument;
+    }
+    if (!valid_options(options)) { return Integration_Error_Invalid_Options; }
+
+    arena_reset(&context->arena);
+    return integrate(&expression->program, start, end, options, result, &context->arena);
+}
+
+/*
+ * Function: integration_sweep(context, expression, parameters, count, start, end, options,
+ *                             threads, values, errors)
+ *
+ * Description: Integrates an expression with parameters (from integration_compile_parameters())
+ *              once for each of a list of sets of values of its parameters, all together and
+ *              across several threads; see sweep.h. This is always numerical, in double
+ *              precision: options->precision, surrogate, profile and checkpoint are unused.
+ * Parameters: context - the calling thread's context
+ *             expression - the compiled expression
+ *             parameters - the sets of values, one after another: parameter k of set i is
+ *                          parameters[i * (number of parameters) + k]
+ *             count - the number of sets
+ *             start, end - the limits of integration (in either order)
+ *             options - how to integrate
+ *             threads - the number of threads to use, or 0 for one per processor
+ *             values - where each set's integral is written (count of them). A set for which
+ *                      the expression was NaN or infinite, with Non_Finite_Stop, has a NaN.
+ *             errors - where each set's estimated error is written for Method_Richardson, or NULL
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error
+ */
+
+int integration_sweep(struct Integration_Context *context,
+                      const struct Integration_Expression *expression, const double *parameters,
+                      long count, double start, double end,
+                      const struct Integration_Options *options, int threads, double *values,
+                      double *errors) {
+    if (context == NULL || expression == NULL || options == NULL || count < 0 ||
+        (count > 0 && (values == NULL || parameters == NULL)) || !isfinite(start) ||
+        !isfinite(end) || threads < 0) {
+        return Integration_Error_Invalid_Argument;
+    }
+    if (!valid_options(options)) { return Integration_Error_Invalid_Options; }
+
+    return sweep_integrate(&expression->program, parameters, expression->parameter_count, count,
+                           start, end, options, threads, values, errors, NULL);
+}
+
+/*
+ * Function: integration_fit_surrogate(context, expression, start, end, tolerance, surrogate)
+ *
+ * Description: Fits a piecewise Chebyshev surrogate to a compiled expression over a range, for
+ *              integrating it again and again without evaluating it; see chebyshev.h
+ * Parameters: context - the calling thread's context
+ *             expression - the compiled expression
+ *             start, end - the range (in either order). Integrals with limits inside it can use
+ *                          the surrogate.
+ *             tolerance - the accuracy to fit to, relative to the largest |f| in the range (0 for
+ *                         the default, 1e-12)
+ *             surrogate - where the surrogate is written, to be freed with
+ *                         integration_surrogate_free(). Set to NULL on failure.
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error
+ */
+
+int integration_fit_surrogate(struct Integration_Context *context,
+                              const struct Integration_Expression *expression, double start,
+                              double end, double tolerance,
+                              struct Chebyshev_Surrogate **surrogate) {
+    if (surrogate != NULL) { *surrogate = NULL; }
+    if (context == NULL || expression == NULL || surrogate == NULL || !isfinite(start) ||
+        !isfinite(end) || !(tolerance >= 0) || expression->parameter_count > 0) {
+        return Integration_Error_Invalid_Argument;
+    }
+
+    struct Chebyshev_Surrogate *result = malloc(sizeof(struct Chebyshev_Surrogate));
+    if (result == NULL) { return Integration_Error_Out_Of_Memory; }
+
+    arena_reset(&context->arena);
+    int rc = chebyshev_fit(&expression->program, start, end, tolerance, result, &context->arena);
+    if (rc != 0) {
+        integration_surrogate_free(result);
+        switch (rc) {
+            case Chebyshev_Not_Finite: return Integration_Error_Not_Finite;
+            case Chebyshev_Too_Many_Pieces: return Integration_Error_Not_Converged;
+            default: return Integration_Error_Out_Of_Memory;
+        }
+    }
+
+    *surrogate = result;
+    return Integration_Ok;
+}
+
+/*
+ * Function: integration_surrogate_evaluate(surrogate, x, value)
+ *
+ * Description: Evaluates a surrogate, i.e. approximately evaluates the expression it was fitted to
+ * Parameters: surrogate - the surrogate
+ *             x - the value of x, which must be in the range the surrogate was fitted over
+ *             value - where the value is written
+ * Returns: Integration_Ok, or a (negative) enum Integration_Error
+ */
+
+int integration_surrogate_evaluate(const struct Chebyshev_Surrogate *surrogate, double x,
+                                   double *value) {
+    if (surrogate == NULL || value == NULL || !(x >= surrogate->start && x <= surrogate->end)) {
+        return Integration_Error_Invalid_Argument;
+    }
+
+    *value = chebyshev_evaluate(surrogate, x);
+    return Integration_Ok;
+}
+
+/*
+ * Function: integration_surrogate_free(surrogate)
+ *
+ * Description: Frees a surrogate
+ * Parameters: surrogate - the surrogate, or NULL
+ * Returns: none
+ */
+
+void integration_surrogate_free(struct Chebyshev_Surrogate *surrogate) {
+    if (surrogate == NULL) { return; }
+    chebyshev_free(surrogate);
+    free(surrogate);
+}
+
+/*
+ * Function: integration_error_message(error)
+ *
+ * Description: Describes an error returned by the library
+ * Parameters: error - an enum Integration_Error
+ * Returns: The description
+ */
+
+const char *integration_error_message(int error) {
+    switch (error) {
+        case Integration_Ok:
+            return "no error";
+        case Integration_Error_Invalid_Options:
+            return "invalid integration options";
+        case Integration_Error_Invalid_Argument:
+            return "invalid argument";
+        case Integration_Error_Empty_Expression:
+            return "the expression is empty";
+        case Integration_Error_Not_Finite:
+            return "the expression is NaN or infinite in the range";
+        case Integration_Error_Not_Converged:
+            return "the expression is too irregular to fit a surrogate to";
+        case Integration_Error_Interrupted:
+            return "interrupted";
+        default:
+            return parse_error_message(error);
+    }
+}
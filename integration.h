@@ -0,0 +1,96 @@
+#ifndef INTEGRATION_H_INCLUDED
+#define INTEGRATION_H_INCLUDED // Include guards
+
+#include <stddef.h> // size_t
+#include "integrate.h" // struct Integration_Options, struct Integration_Result
+
+// ------ Library interface ------
+// The interface of libintegration (libintegration.a / libintegration.so), for programs that want
+// to compile and integrate expressions themselves rather than run project.out.
+//
+//     struct Integration_Context *context = integration_context_create();
+//     struct Integration_Expression *expression;
+//     if (integration_compile(context, "4(sin(x))^2 + 2", 15, &expression) == Integration_Ok) {
+//         struct Integration_Options options = { .method = Method_Simpson, .strips = 100 };
+//         struct Integration_Result result;
+//         integration_integrate(context, expression, 4, 6, &options, &result);
+//         integration_expression_free(expression);
+//     }
+//     integration_context_free(context);
+//
+// Nothing is ever printed, and the library never exits: every function reports failure by
+// returning a (negative) enum Integration_Error.
+//
+// Thread safety: the library has no global state. A context holds the working memory of the
+// calls made with it, so each thread needs its own. A compiled expression is never changed after
+// integration_compile() returns it, so one expression can be evaluated and integrated from many
+// threads at once (each with its own context).
+//
+// An expression integrated many times over the same range (or parts of it) can be replaced by a
+// surrogate from integration_fit_surrogate(): set options.surrogate, and integration_integrate()
+// gives its exact integral without evaluating the expression at all. Surrogates can be shared
+// between threads in the same way as expressions.
+//
+// To integrate f(x; p) for many sets of values of parameters p, compile it once with
+// integration_compile_parameters() and give integration_sweep() the list of sets: it integrates
+// them all together, across several threads of its own, writing one integral per set into an
+// array (see sweep.h).
+
+// --- Type declarations ---
+
+// Errors returned by the library. The first few are the parser's enum Parse_Error, and the
+// integrator's enum Integration_Status, with the same values.
+enum Integration_Error {
+    Integration_Error_Mismatched_Brackets = -1,
+    Integration_Error_Missing_Operand = -2,
+    Integration_Error_Unknown_Token = -3,
+    Integration_Error_Out_Of_Memory = -4,
+    Integration_Error_Invalid_Options = -5,
+    Integration_Error_Invalid_Argument = -6, // e.g. a NULL pointer, or a limit that is NaN
+    Integration_Error_Empty_Expression = -7,
+    Integration_Error_Not_Finite = -8, // The expression was NaN or infinite where that isn't
+                                       // allowed (see Non_Finite_Stop, and surrogates)
+    Integration_Error_Not_Converged = -9, // The expression is too irregular to fit a surrogate to
+    Integration_Error_Interrupted = -10 // options->interrupted was set
+};
+
+struct Integration_Context; // Per-thread working memory and error details
+struct Integration_Expression; // A compiled expression
+
+// --- Function declarations ---
+
+struct Integration_Context *integration_context_create();
+void integration_context_free(struct Integration_Context *context);
+
+int integration_compile(struct Integration_Context *context, const char *expression,
+                        size_t length, struct Integration_Expression **compiled);
+int integration_compile_parameters(struct Integration_Context *context, const char *expression,
+                                   size_t length, const char *const *names, int count,
+                                   struct Integration_Expression **compiled);
+int integration_error_offset(const struct Integration_Context *context);
+void integration_expression_free(struct Integration_Expression *expression);
+
+int integration_evaluate(struct Integration_Context *context,
+                         const struct Integration_Expression *expression, double x,
+                         double *value);
+int integration_integrate(struct Integration_Context *context,
+                          const struct Integration_Expression *expression, double start,
+                          double end, const struct Integration_Options *options,
+                          struct Integration_Result *result);
+int integration_sweep(struct Integration_Context *context,
+                      const struct Integration_Expression *expression, const double *parameters,
+                      long count, double start, double end,
+                      const struct Integration_Options *options, int threads, double *values,
+                      double *errors);
+
+int integration_fit_surrogate(struct Integration_Context *context,
+                              const struct Integration_Expression *expression, double start,
+                              double end, double tolerance,
+                              struct Chebyshev_Surrogate **surrogate);
+int integration_surrogate_evaluate(const struct Chebyshev_Surrogate *surrogate, double x,
+                                   double *value);
+void integration_surrogate_free(struct Chebyshev_Surrogate *surrogate);
+
+const char *integration_error_message(int error);
+
+#endif
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include "parser.h"
+#include "tokenize.h"
+#include "shunting.h"
+#include "token.h"
+
+// ------ Parser definitions ------
+// The parser goes straight from the expression string to RPN in one pass: each token is pushed
+// into the shunting-yard algorithm as soon as the lexer reads it, so there is no intermediate
+// token array, and the RPN comes out in evaluation order.
+
+/*
+ * Function: compile_expression(expression, length, arena, program)
+ *
+ * Description: Compiles an infix expression to RPN, e.g. "4sin(x)^2" -> [4, x, sin, 2, ^, *]
+ * Parameters: expression, length - the expression string (need not be null-terminated)
+ *             arena - the arena that the program (and the working memory used to compile it) is
+ *                     allocated from. The program lives until the arena is reset.
+ *             program - filled in with the compiled program
+ * Returns: The number of tokens in the RPN, or a (negative) enum Parse_Error. In the case of an
+ *          error, program->error_offset is where in the expression it was found, if known.
+ */
+
+int compile_expression(const char *expression, size_t length, struct Arena *arena,
+                       struct Program *program) {
+    return compile_parameterized(expression, length, NULL, 0, arena, program);
+}
+
+/*
+ * Function: compile_parameterized(expression, length, names, count, arena, program)
+ *
+ * Description: Compiles an expression with parameters as well as x, e.g. "a sin(b x)" with the
+ *              parameters a and b, which are left in the program as Parameter tokens to be
+ *              filled in when it is run (see sweep.h). Only the sweep evaluator can run such a
+ *              program, so the others are only ever given programs from compile_expression().
+ * Parameters: expression, length - the expression string (need not be null-terminated)
+ *             names, count - the parameters' names, which must be valid (see
+ *                            valid_parameter_name()); token i of the program is parameter
+ *                            code[i].parameter in this list
+ *             arena, program - as for compile_expression()
+ * Returns: As for compile_expression()
+ */
+
+int compile_parameterized(const char *expression, size_t length, const char *const *names,
+                          int count, struct Arena *arena, struct Program *program) {
+    struct Lexer lexer;
+    lexer_init(&lexer, expression, length);
+    lexer_set_parameters(&lexer, names, count);
+
+    struct Shunting_Yard state;
+    struct Token token;
+    int lex_rc = Lex_End;
+
+    size_t max_tokens = max_tokens_for_length(length);
+    struct Token *output = (max_tokens > 0 || length == 0) ?
+                           arena_alloc(arena, max_tokens * sizeof(struct Token)) : NULL;
+
+    shunting_init(&state, arena, output);
+    if (output == NULL) {
+        state.error = Parse_Out_Of_Memory;
+    } else {
+        while ((lex_rc = lexer_next(&lexer, &token)) == Lex_Token) {
+            if (shunting_push(&state, &token) != 0) { break; }
+        }
+    }
+
+    int rc = shunting_finish(&state);
+    if (lex_rc == Lex_Error) { rc = Parse_Unknown_Token; }
+
+    program->code = output;
+    program->length = (rc < 0) ? 0 : rc;
+    program->max_depth = state.max_depth;
+    program->error_offset = (int)(lexer.cursor - expression);
+
+    return rc;
+}
+
+/*
+ * Function: hash_bytes(hash, bytes, count)
+ *
+ * Description: Adds some bytes to an FNV-1a hash
+ * Parameters: hash - the hash so far
+ *             bytes, count - the bytes
+ * Returns: The new hash
+ */
+
+static uint64_t hash_bytes(uint64_t hash, const void *bytes, size_t count) {
+    const unsigned char *byte = bytes;
+    for (size_t i = 0; i < count; i++) {
+        hash ^= byte[i];
+        hash *= 1099511628211u; // FNV prime
+    }
+    return hash;
+}
+
+/*
+ * Function: program_hash(program)
+ *
+ * Description: Hashes a compiled program (with 64-bit FNV-1a), to tell whether two programs are
+ *              the same expression. Only what each token does is hashed, not the text it came
+ *              from, so "2x" and "2*x" hash the same.
+ * Parameters: program - the compiled program
+ * Returns: The hash
+ */
+
+uint64_t program_hash(const struct Program *program) {
+    uint64_t hash = 14695981039346656037u; // FNV offset basis
+
+    for (int i = 0; i < program->length; i++) {
+        const struct Token *token = &program->code[i];
+        int type = token->type;
+        hash = hash_bytes(hash, &type, sizeof(type));
+
+        if (token->type == Number) {
+            hash = hash_bytes(hash, &token->value, sizeof(token->value));
+        } else if (token->type == Operator) {
+            int operator_type = token->operator_type;
+            hash = hash_bytes(hash, &operator_type, sizeof(operator_type));
+        } else if (token->type == Function) {
+            int function_type = token->function_type;
+            hash = hash_bytes(hash, &function_type, sizeof(function_type));
+        } else if (token->type == Parameter) {
+            hash = hash_bytes(hash, &token->parameter, sizeof(token->parameter));
+        }
+    }
+
+    return hash;
+}
+
+/*
+ * Function: parse_error_message(error)
+ *
+ * Description: Describes a parse error for the user
+ * Parameters: error - an enum Parse_Error
+ * Returns: The description
+ */
+
+const char *parse_error_message(int error) {
+    switch (error) {
+        case Parse_Mismatched_Brackets:
+            return "mismatched brackets";
+        case Parse_Missing_Operand:
+            return "an operator or function is missing a value";
+        case Parse_Unknown_Token:
+            return "unrecognized token";
+        case Parse_Out_Of_Memory:
+            return "not enough memory";
+        default:
+            return "unknown error";
+    }
+}
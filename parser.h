@@ -0,0 +1,28 @@
+#ifndef PARSER_H_INCLUDED
+#define PARSER_H_INCLUDED // Include guards
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+#include "token.h"
+#include "arena.h"
+
+// --- Type declarations ---
+
+// An expression compiled to RPN, ready to be evaluated
+struct Program {
+    struct Token *code; // RPN tokens, in the order they are evaluated
+    int length; // Number of tokens in code
+    int max_depth; // Most values on the evaluation stack at once
+    int error_offset; // Where in the expression compilation failed (if it did)
+};
+
+// --- Function declarations ---
+
+int compile_expression(const char *expression, size_t length, struct Arena *arena,
+                       struct Program *program);
+int compile_parameterized(const char *expression, size_t length, const char *const *names,
+                          int count, struct Arena *arena, struct Program *program);
+uint64_t program_hash(const struct Program *program);
+const char *parse_error_message(int error);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "perf.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+
+// Names of the counters as printed, indexed by enum Perf_Counter
+static const char *counter_names[Perf_Counter_Count] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+};
+
+/*
+ * ----------------------------------------------
+ * Function definitions
+ * ----------------------------------------------
+ */
+
+#ifdef __linux__
+
+/*
+ * Function: open_counter(type, config)
+ *
+ * Description: Opens one counter for this process (user space only), and starts it counting
+ * Parameters: type, config - which counter, as for perf_event_attr
+ * Returns: The counter's file descriptor, or -1 (with errno set) if it couldn't be opened
+ */
+
+static int open_counter(unsigned int type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1; // also what makes it allowed without privileges
+    attr.exclude_hv = 1;
+
+    // There is no glibc wrapper for this system call
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); }
+    return fd;
+}
+
+#endif
+
+/*
+ * Function: perf_init(counters)
+ *
+ * Description: Sets up counters with none of them open, so that they can be passed around (and
+ *              closed) without being opened
+ * Parameters: counters - the counters to initialize
+ * Returns: none
+ */
+
+void perf_init(struct Perf_Counters *counters) {
+    counters->open_count = 0;
+    for (int i = 0; i < Perf_Counter_Count; i++) { counters->fds[i] = -1; }
+}
+
+/*
+ * Function: perf_open(counters, errors)
+ *
+ * Description: Opens as many of the hardware counters as the CPU and kernel allow. Each is opened
+ *              on its own, so that e.g. a virtual machine without cache counters still gets
+ *              cycles and instructions.
+ * Parameters: counters - the counters to open
+ *             errors - where to say why counters aren't available, or NULL to say nothing
+ * Returns: The number of counters opened; 0 if none are available
+ */
+
+int perf_open(struct Perf_Counters *counters, FILE *errors) {
+    perf_init(counters);
+
+#ifdef __linux__
+    static const struct { unsigned int type; unsigned long long config; } events[] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    };
+    int first_error = 0;
+
+    for (int i = 0; i < Perf_Counter_Count; i++) {
+        counters->fds[i] = open_counter(events[i].type, events[i].config);
+        if (counters->fds[i] >= 0) {
+            counters->open_count++;
+        } else if (first_error == 0) {
+            first_error = errno;
+        }
+    }
+
+    if (counters->open_count == 0 && errors != NULL) {
+        fprintf(errors, "Hardware counters are unavailable (perf_event_open: %s)%s; reporting "
+                        "times only\n", strerror(first_error),
+                (first_error == EACCES || first_error == EPERM) ?
+                    ", see /proc/sys/kernel/perf_event_paranoid" : "");
+    }
+#else
+    if (errors != NULL) {
+        fprintf(errors, "Hardware counters are only supported on Linux; reporting times only\n");
+    }
+#endif
+
+    return counters->open_count;
+}
+
+/*
+ * Function: perf_read(counters, values)
+ *
+ * Description: Reads the current value of every counter. The counters run all the time, so the
+ *              count for a stretch of code is the difference between readings before and after.
+ * Parameters: counters - the counters
+ *             values - array of Perf_Counter_Count values to write to (-1 for unavailable ones)
+ * Returns: none
+ */
+
+void perf_read(const struct Perf_Counters *counters, long long *values) {
+    for (int i = 0; i < Perf_Counter_Count; i++) {
+        values[i] = -1;
+#ifdef __linux__
+        long long value;
+        if (counters->fds[i] < 0) { continue; }
+        if (read(counters->fds[i], &value, sizeof(value)) == sizeof(value)) { values[i] = value; }
+#endif
+    }
+}
+
+/*
+ * Function: perf_close(counters)
+ *
+ * Description: Closes the counters
+ * Parameters: counters - the counters
+ * Returns: none
+ */
+
+void perf_close(struct Perf_Counters *counters) {
+    for (int i = 0; i < Perf_Counter_Count; i++) {
+#ifdef __linux__
+        if (counters->fds[i] >= 0) { close(counters->fds[i]); }
+#endif
+    }
+    perf_init(counters);
+}
+
+const char *perf_counter_name(enum Perf_Counter counter) {
+    return counter_names[counter];
+}
@@ -0,0 +1,37 @@
+#ifndef PERF_H_INCLUDED
+#define PERF_H_INCLUDED // Include guards
+
+#include <stdio.h> // FILE
+
+// ------ Hardware performance counters ------
+// Reads the CPU's own counters (cycles, instructions, branch mispredictions and cache misses)
+// through Linux's perf_event_open(), to tell whether a stage is limited by mispredicted branches,
+// by cache misses, or by neither. Counters only count this process, in user space, which most
+// kernels allow without privileges; if the kernel doesn't allow them at all (or this isn't Linux)
+// perf_open() says why and the counters are simply left out of the statistics.
+
+// --- Type declarations ---
+
+enum Perf_Counter {
+    Perf_Cycles,
+    Perf_Instructions,
+    Perf_Branch_Misses,
+    Perf_L1D_Misses, // Level 1 data cache read misses
+    Perf_LLC_Misses, // Last level cache misses, i.e. reads that went to memory
+    Perf_Counter_Count
+};
+
+struct Perf_Counters {
+    int fds[Perf_Counter_Count]; // -1 for counters that couldn't be opened
+    int open_count;
+};
+
+// --- Function declarations ---
+
+void perf_init(struct Perf_Counters *counters);
+int perf_open(struct Perf_Counters *counters, FILE *errors);
+void perf_read(const struct Perf_Counters *counters, long long *values);
+void perf_close(struct Perf_Counters *counters);
+const char *perf_counter_name(enum Perf_Counter counter);
+
+#endif
@@ -0,0 +1,230 @@
+#include <string.h>
+#include <math.h>
+#include "polynomial.h"
+#include "functions.h"
+#include "token.h"
+
+// ------ Polynomial definitions ------
+
+/*
+ * Function: constant(polynomial, value)
+ *
+ * Description: Sets a polynomial to a constant
+ * Parameters: polynomial - the polynomial
+ *             value - the constant
+ * Returns: none
+ */
+
+static inline void constant(struct Polynomial *polynomial, double value) {
+    polynomial->degree = 0;
+    polynomial->coefficients[0] = value;
+}
+
+/*
+ * Function: trim(polynomial)
+ *
+ * Description: Lowers a polynomial's degree past any leading coefficients of 0 (e.g. from x - x)
+ * Parameters: polynomial - the polynomial
+ * Returns: none
+ */
+
+static inline void trim(struct Polynomial *polynomial) {
+    while (polynomial->degree > 0 && polynomial->coefficients[polynomial->degree] == 0) {
+        polynomial->degree--;
+    }
+}
+
+/*
+ * Function: add(a, b, sign)
+ *
+ * Description: Adds (or subtracts) one polynomial to another
+ * Parameters: a - the polynomial added to, where the result is written
+ *             b - the polynomial to add
+ *             sign - 1 to add, -1 to subtract
+ * Returns: none
+ */
+
+static void add(struct Polynomial *a, const struct Polynomial *b, double sign) {
+    for (int k = a->degree + 1; k <= b->degree; k++) { a->coefficients[k] = 0; }
+    if (b->degree > a->degree) { a->degree = b->degree; }
+    for (int k = 0; k <= b->degree; k++) { a->coefficients[k] += sign * b->coefficients[k]; }
+    trim(a);
+}
+
+/*
+ * Function: multiply(a, b)
+ *
+ * Description: Multiplies one polynomial by another
+ * Parameters: a - the polynomial multiplied, where the result is written
+ *             b - the polynomial to multiply by
+ * Returns: 1 on success, 0 if the product's degree would be over POLYNOMIAL_MAX_DEGREE
+ */
+
+static int multiply(struct Polynomial *a, const struct Polynomial *b) {
+    if (a->degree + b->degree > POLYNOMIAL_MAX_DEGREE) { return 0; }
+
+    double product[POLYNOMIAL_MAX_DEGREE + 1] = { 0 };
+    for (int i = 0; i <= a->degree; i++) {
+        for (int j = 0; j <= b->degree; j++) {
+            product[i + j] += a->coefficients[i] * b->coefficients[j];
+        }
+    }
+
+    a->degree += b->degree;
+    memcpy(a->coefficients, product, (a->degree + 1) * sizeof(double));
+    trim(a);
+    return 1;
+}
+
+/*
+ * Function: power(a, exponent)
+ *
+ * Description: Raises a polynomial to a power. A constant can be raised to any power, but
+ *              anything else only to a whole number (x^-1 and x^0.5 aren't polynomials).
+ * Parameters: a - the polynomial, where the result is written
+ *             exponent - the power
+ * Returns: 1 on success, 0 if the result isn't a polynomial (or is of too high a degree)
+ */
+
+static int power(struct Polynomial *a, double exponent) {
+    if (a->degree == 0) {
+        constant(a, pow(a->coefficients[0], exponent));
+        return 1;
+    }
+    if (exponent < 0 || exponent != floor(exponent) ||
+        exponent * a->degree > POLYNOMIAL_MAX_DEGREE) {
+        return 0;
+    }
+
+    struct Polynomial base = *a;
+    constant(a, 1);
+    for (int n = (int)exponent; n > 0; n--) { multiply(a, &base); }
+    return 1;
+}
+
+/*
+ * Function: polynomial_from_program(program, polynomial, scratch)
+ *
+ * Description: Works out whether a compiled expression is a polynomial in x, and if so what its
+ *              coefficients are, by running the program on polynomials instead of numbers
+ * Parameters: program - the compiled expression, which must be complete (as checked by the parser)
+ *             polynomial - where the polynomial is written
+ *             scratch - arena for the operand stack, handed back before returning
+ * Returns: 1 if the expression is a polynomial, 0 if it isn't (or there wasn't enough memory to
+ *          find out)
+ */
+
+int polynomial_from_program(const struct Program *program, struct Polynomial *polynomial,
+                            struct Arena *scratch) {
+    if (program->length == 0) {
+        constant(polynomial, 0);
+        return 1;
+    }
+
+    struct Arena_Mark mark = arena_mark(scratch);
+    struct Polynomial *stack = arena_alloc(scratch, program->max_depth * sizeof(struct Polynomial));
+    if (stack == NULL) { return 0; }
+
+    int depth = 0;
+    int is_polynomial = 1;
+
+    for (int i = 0; i < program->length && is_polynomial; i++) {
+        const struct Token *token = &program->code[i];
+
+        if (token->type == Number) {
+            constant(&stack[depth++], token->value);
+        } else if (token->type == Variable) {
+            struct Polynomial *x = &stack[depth++];
+            x->degree = 1;
+            x->coefficients[0] = 0;
+            x->coefficients[1] = 1;
+        } else if (token->type == Function) {
+            // Only a function of a constant is a constant
+            struct Polynomial *a = &stack[depth - 1];
+            if (a->degree != 0) { is_polynomial = 0; }
+            else { constant(a, function_table[token->function_type].scalar(a->coefficients[0])); }
+        } else if (token->operator_type == Op_Negate) {
+            struct Polynomial *a = &stack[depth - 1];
+            for (int k = 0; k <= a->degree; k++) { a->coefficients[k] = -a->coefficients[k]; }
+        } else {
+            struct Polynomial *a = &stack[depth - 2];
+            const struct Polynomial *b = &stack[depth - 1];
+            depth--;
+
+            switch (token->operator_type) {
+                case Op_Add:
+                    add(a, b, 1);
+                    break;
+                case Op_Subtract:
+                    add(a, b, -1);
+                    break;
+                case Op_Multiply:
+                    is_polynomial = multiply(a, b);
+                    break;
+                case Op_Divide:
+                    // Dividing by 0 is left to the numerical methods to turn into infinities
+                    if (b->degree != 0 || b->coefficients[0] == 0) { is_polynomial = 0; break; }
+                    for (int k = 0; k <= a->degree; k++) {
+                        a->coefficients[k] /= b->coefficients[0];
+                    }
+                    break;
+                case Op_Power:
+                    is_polynomial = (b->degree == 0) && power(a, b->coefficients[0]);
+                    break;
+                default:
+                    is_polynomial = 0;
+                    break;
+            }
+        }
+    }
+
+    // A NaN or infinite coefficient (e.g. from ln(0)) is no use for an exact answer
+    if (is_polynomial) {
+        *polynomial = stack[0];
+        for (int k = 0; k <= polynomial->degree; k++) {
+            if (!isfinite(polynomial->coefficients[k])) { is_polynomial = 0; }
+        }
+    }
+
+    arena_release(scratch, mark);
+    return is_polynomial;
+}
+
+/*
+ * Function: polynomial_evaluate(polynomial, x)
+ *
+ * Description: Evaluates a polynomial with Horner's method
+ * Parameters: polynomial - the polynomial
+ *             x - where to evaluate it
+ * Returns: The value of the polynomial
+ */
+
+double polynomial_evaluate(const struct Polynomial *polynomial, double x) {
+    double value = 0;
+    for (int k = polynomial->degree; k >= 0; k--) {
+        value = value * x + polynomial->coefficients[k];
+    }
+    return value;
+}
+
+/*
+ * Function: polynomial_integral(polynomial, start, end)
+ *
+ * Description: Integrates a polynomial exactly, as F(end) - F(start) where F is its
+ *              antiderivative, evaluated with Horner's method
+ * Parameters: polynomial - the polynomial
+ *             start, end - the limits of integration
+ * Returns: The integral
+ */
+
+double polynomial_integral(const struct Polynomial *polynomial, double start, double end) {
+    // F(x) = x * (c_0 + c_1 x / 2 + c_2 x^2 / 3 + ...)
+    double at_start = 0;
+    double at_end = 0;
+    for (int k = polynomial->degree; k >= 0; k--) {
+        double coefficient = polynomial->coefficients[k] / (k + 1);
+        at_start = at_start * start + coefficient;
+        at_end = at_end * end + coefficient;
+    }
+    return at_end * end - at_start * start;
+}
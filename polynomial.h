@@ -0,0 +1,33 @@
+#ifndef POLYNOMIAL_H_INCLUDED
+#define POLYNOMIAL_H_INCLUDED // Include guards
+
+#include "parser.h" // struct Program
+#include "arena.h"
+
+// ------ Polynomials ------
+// Lots of expressions (this started out as a polynomial calculator, after all) are polynomials in
+// x, which can be integrated exactly instead of numerically. polynomial_from_program() runs the
+// compiled program on polynomials rather than numbers: x is the polynomial x, + and * add and
+// multiply coefficients, and so on, so products like x(x+1) and powers like (x-1)^3 are expanded.
+// Anything that can't be done to a polynomial (dividing by x, sin(x), x^0.5) means the expression
+// isn't one. Functions of constants (sqrt(2)) are fine, since they're constants.
+
+// Highest degree handled. Higher degrees aren't worth it: the coefficients of an expanded
+// (x - 1)^100 are too big for the exact integral to be any better than Simpson's rule.
+#define POLYNOMIAL_MAX_DEGREE 32
+
+// --- Type declarations ---
+
+struct Polynomial {
+    int degree;
+    double coefficients[POLYNOMIAL_MAX_DEGREE + 1]; // coefficients[k] multiplies x^k
+};
+
+// --- Function declarations ---
+
+int polynomial_from_program(const struct Program *program, struct Polynomial *polynomial,
+                            struct Arena *scratch);
+double polynomial_evaluate(const struct Polynomial *polynomial, double x);
+double polynomial_integral(const struct Polynomial *polynomial, double start, double end);
+
+#endif
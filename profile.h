@@ -0,0 +1,67 @@
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED // Include guards
+
+#include <stdio.h> // FILE
+#include "token.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc()
+#else
+#include <time.h>
+#endif
+
+// ------ Evaluator profile ------
+// Counts how many times each kind of token is executed by evaluate_rpn_profiled(), and how many
+// cycles were spent on it, to find which operators and functions dominate an integrand (and so
+// are worth vectorizing, or rewriting the expression to avoid).
+//
+// Cycles are read from the time-stamp counter on x86; elsewhere they are nanoseconds. Reading the
+// counter around every token costs far more than a cheap operator like +, so the cost of reading
+// it is measured once and subtracted in the report. Even so, the figures for cheap operators are
+// approximate, and profiled evaluation is several times slower than evaluate_rpn().
+
+// --- Type declarations ---
+
+// What is profiled: loading a number or x, each operator, and each function
+enum Profile_Slot {
+    Profile_Number,
+    Profile_Variable,
+    Profile_Operators, // + enum Operator_Type
+    Profile_Functions = Profile_Operators + Op_Negate + 1, // + enum Function_Type
+    Profile_Slot_Count = Profile_Functions + Func_Count
+};
+
+struct Eval_Profile {
+    long long executions[Profile_Slot_Count];
+    unsigned long long cycles[Profile_Slot_Count];
+    double overhead; // Cycles taken by reading the counter twice, subtracted from each execution
+};
+
+// --- Function declarations ---
+
+void profile_init(struct Eval_Profile *profile);
+void profile_print(const struct Eval_Profile *profile, FILE *stream);
+
+// Reads the cycle counter
+static inline unsigned long long profile_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Slot that a token is counted in
+static inline int profile_slot(const struct Token *token) {
+    switch (token->type) {
+        case Number: return Profile_Number;
+        case Variable: return Profile_Variable;
+        case Parameter: return Profile_Variable;
+        case Function: return Profile_Functions + token->function_type;
+        default: return Profile_Operators + token->operator_type;
+    }
+}
+
+#endif
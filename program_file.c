@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "program_file.h"
+#include "functions.h"
+#include "token.h"
+
+// ------ Program file definitions ------
+
+/*
+ * Function: align(offset)
+ *
+ * Description: Rounds an offset in the file up to the next multiple of 8
+ * Parameters: offset - the offset
+ * Returns: The rounded offset
+ */
+
+static inline uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+/*
+ * Function: write_padding(file, offset)
+ *
+ * Description: Writes zeroes up to the next multiple of 8
+ * Parameters: file - the file being written
+ *             offset - how far through it the writing has got
+ * Returns: 1 on success, 0 if the write failed
+ */
+
+static int write_padding(FILE *file, uint64_t offset) {
+    static const char zeroes[8] = { 0 };
+    size_t padding = align(offset) - offset;
+    return padding == 0 || fwrite(zeroes, 1, padding, file) == padding;
+}
+
+/*
+ * Function: program_file_write(path, programs, texts, text_lengths, count)
+ *
+ * Description: Writes compiled programs to a program file
+ * Parameters: path - the file to write
+ *             programs - the compiled programs
+ *             texts, text_lengths - each program's expression, as written (the text of a program
+ *                                   can be NULL, with a length of 0)
+ *             count - the number of programs
+ * Returns: 0 on success, or a (negative) enum Program_File_Error
+ */
+
+int program_file_write(const char *path, const struct Program *programs,
+                       const char *const *texts, const size_t *text_lengths, long count) {
+    struct Program_File_Entry *entries = calloc(count > 0 ? count : 1,
+                                                sizeof(struct Program_File_Entry));
+    if (entries == NULL) { return Program_File_Out_Of_Memory; }
+
+    // Lay the file out first, so the header and entries can be written at the front
+    uint64_t offset = sizeof(struct Program_File_Header) +
+                      count * sizeof(struct Program_File_Entry);
+    for (long i = 0; i < count; i++) {
+        const struct Program *program = &programs[i];
+        entries[i].hash = program_hash(program);
+        entries[i].length = program->length;
+        entries[i].max_depth = program->max_depth;
+        for (int t = 0; t < program->length; t++) {
+            if (program->code[t].type == Variable) { entries[i].variables = 1; }
+        }
+
+        offset = align(offset);
+        entries[i].code_offset = offset;
+        offset += program->length * sizeof(struct Token);
+    }
+    for (long i = 0; i < count; i++) {
+        offset = align(offset);
+        entries[i].text_offset = offset;
+        entries[i].text_length = (texts[i] != NULL) ? text_lengths[i] : 0;
+        offset += entries[i].text_length;
+    }
+
+    struct Program_File_Header header = {
+        .magic = PROGRAM_FILE_MAGIC,
+        .version = PROGRAM_FILE_VERSION,
+        .byte_order = PROGRAM_FILE_BYTE_ORDER,
+        .token_size = sizeof(struct Token),
+        .function_count = Func_Count,
+        .program_count = count,
+        .file_size = align(offset)
+    };
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        free(entries);
+        return Program_File_Unreadable;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             (count == 0 || fwrite(entries, sizeof(struct Program_File_Entry), count, file) ==
+                            (size_t)count);
+    offset = sizeof(header) + count * sizeof(struct Program_File_Entry);
+
+    for (long i = 0; i < count && ok; i++) {
+        ok = write_padding(file, offset);
+        offset = align(offset);
+
+        // The text pointers would mean nothing to whoever reads the file
+        for (int t = 0; t < programs[i].length && ok; t++) {
+            struct Token token = programs[i].code[t];
+            token.text = NULL;
+            token.text_length = 0;
+            ok = fwrite(&token, sizeof(token), 1, file) == 1;
+        }
+        offset += programs[i].length * sizeof(struct Token);
+    }
+    for (long i = 0; i < count && ok; i++) {
+        ok = write_padding(file, offset);
+        offset = align(offset);
+        ok = ok && fwrite(texts[i], 1, entries[i].text_length, file) == entries[i].text_length;
+        offset += entries[i].text_length;
+    }
+    ok = ok && write_padding(file, offset);
+
+    if (fclose(file) != 0) { ok = 0; }
+    free(entries);
+    return ok ? 0 : Program_File_Unreadable;
+}
+
+/*
+ * Function: program_file_open(path, file)
+ *
+ * Description: Opens a program file by mapping it into memory. Only the header and the list of
+ *              programs are checked here; each program is checked when it is taken out with
+ *              program_file_program().
+ * Parameters: path - the file to open
+ *             file - where the open file is written
+ * Returns: 0 on success, or a (negative) enum Program_File_Error
+ */
+
+int program_file_open(const char *path, struct Program_File *file) {
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) { return Program_File_Unreadable; }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        return Program_File_Unreadable;
+    }
+    size_t size = status.st_size;
+    if (size < sizeof(struct Program_File_Header)) {
+        close(descriptor);
+        return Program_File_Invalid;
+    }
+
+    void *memory = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor); // the mapping keeps the file open
+    if (memory == MAP_FAILED) { return Program_File_Unreadable; }
+
+    const struct Program_File_Header *header = memory;
+    int valid = header->magic == PROGRAM_FILE_MAGIC && header->version == PROGRAM_FILE_VERSION &&
+                header->byte_order == PROGRAM_FILE_BYTE_ORDER &&
+                header->token_size == sizeof(struct Token) &&
+                header->function_count == Func_Count && header->file_size == size &&
+                header->program_count <= (size - sizeof(struct Program_File_Header)) /
+                                         sizeof(struct Program_File_Entry);
+    if (!valid) {
+        munmap(memory, size);
+        return Program_File_Invalid;
+    }
+
+    file->memory = memory;
+    file->size = size;
+    file->header = header;
+    file->entries = (const struct Program_File_Entry *)(header + 1);
+    file->program_count = header->program_count;
+    return 0;
+}
+
+/*
+ * Function: check_code(code, length, max_depth)
+ *
+ * Description: Checks that a program's tokens are ones the evaluators can run: every token is of
+ *              a kind that can be in compiled code, and every operator and function has its
+ *              operands on the stack, ending with one value. Without this, a corrupt file could
+ *              have the evaluators read outside their stack or the function table.
+ * Parameters: code, length - the program's tokens
+ *             max_depth - where the most values on the stack at once is written
+ * Returns: 1 if the program can be run, 0 if not
+ */
+
+static int check_code(const struct Token *code, uint32_t length, int *max_depth) {
+    int depth = 0;
+    *max_depth = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        const struct Token *token = &code[i];
+        if (token->type == Number || token->type == Variable) {
+            depth++;
+        } else if (token->type == Function) {
+            int function = token->function_type;
+            if (depth < 1 || function < 0 || function >= Func_Count ||
+                function_table[function].arity == 0) {
+                return 0;
+            }
+        } else if (token->type == Operator) {
+            int operator = token->operator_type;
+            if (operator == Op_Negate) {
+                if (depth < 1) { return 0; }
+            } else if (operator >= Op_Add && operator <= Op_Power) {
+                if (depth < 2) { return 0; }
+                depth--;
+            } else {
+                return 0;
+            }
+        } else {
+            return 0; // brackets never make it into compiled code
+        }
+        if (depth > *max_depth) { *max_depth = depth; }
+    }
+
+    return length == 0 || depth == 1;
+}
+
+/*
+ * Function: program_file_program(file, index, program)
+ *
+ * Description: Takes a program out of an open program file. Nothing is copied: the program's
+ *              code is in the file's mapping, so it is only valid until the file is closed, and
+ *              must not be written to.
+ * Parameters: file - the open program file
+ *             index - which program, from 0
+ *             program - where the program is written
+ * Returns: 0 on success, or Program_File_No_Program if there is no such program, or it is
+ *          corrupt
+ */
+
+int program_file_program(const struct Program_File *file, long index, struct Program *program) {
+    if (index < 0 || index >= file->program_count) { return Program_File_No_Program; }
+
+    const struct Program_File_Entry *entry = &file->entries[index];
+    if (entry->code_offset % 8 != 0 || entry->code_offset > file->size ||
+        entry->length > (file->size - entry->code_offset) / sizeof(struct Token)) {
+        return Program_File_No_Program;
+    }
+
+    const struct Token *code = (const struct Token *)(file->memory + entry->code_offset);
+    int max_depth;
+    if (!check_code(code, entry->length, &max_depth)) { return Program_File_No_Program; }
+
+    program->code = (struct Token *)code; // never written to by the evaluators
+    program->length = entry->length;
+    program->max_depth = max_depth;
+    program->error_offset = 0;
+    return 0;
+}
+
+/*
+ * Function: program_file_text(file, index, length)
+ *
+ * Description: Gets the expression a program in a program file was compiled from
+ * Parameters: file - the open program file
+ *             index - which program, from 0
+ *             length - where the length of the expression is written
+ * Returns: The expression (not null-terminated, and in the file's mapping), or NULL if there is
+ *          no such program
+ */
+
+const char *program_file_text(const struct Program_File *file, long index, size_t *length) {
+    if (index < 0 || index >= file->program_count) { return NULL; }
+
+    const struct Program_File_Entry *entry = &file->entries[index];
+    if (entry->text_offset > file->size ||
+        entry->text_length > file->size - entry->text_offset) {
+        return NULL;
+    }
+
+    *length = entry->text_length;
+    return (const char *)(file->memory + entry->text_offset);
+}
+
+/*
+ * Function: program_file_close(file)
+ *
+ * Description: Closes a program file, unmapping it. Programs taken out of it can't be used after
+ *              this.
+ * Parameters: file - the open program file
+ * Returns: none
+ */
+
+void program_file_close(struct Program_File *file) {
+    if (file->memory != NULL) { munmap((void *)file->memory, file->size); }
+    file->memory = NULL;
+    file->program_count = 0;
+}
+
+/*
+ * Function: program_file_error_message(error)
+ *
+ * Description: Describes a program file error for the user
+ * Parameters: error - an enum Program_File_Error
+ * Returns: The description
+ */
+
+const char *program_file_error_message(int error) {
+    switch (error) {
+        case Program_File_Unreadable:
+            return "the file couldn't be read or written";
+        case Program_File_Invalid:
+            return "not a program file, or one written by a different version of this program";
+        case Program_File_No_Program:
+            return "no such expression in the program file, or it is corrupt";
+        case Program_File_Out_Of_Memory:
+            return "not enough memory";
+        default:
+            return "unknown error";
+    }
+}
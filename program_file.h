@@ -0,0 +1,79 @@
+#ifndef PROGRAM_FILE_H_INCLUDED
+#define PROGRAM_FILE_H_INCLUDED // Include guards
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include "parser.h" // struct Program
+
+// ------ Program files ------
+// Compiled expressions saved to a file, so that a large set of them can be loaded again without
+// tokenizing and compiling each one. A program file is mapped into memory rather than read, and
+// its programs' code is evaluated right where it is in the mapping: the tokens are stored exactly
+// as they are in memory, so loading a program is just pointing a struct Program at them. Only
+// what is used is ever read from the disk, so opening a file of 100,000 expressions costs about
+// as much as opening one of ten.
+//
+// Since the tokens are stored as they are in memory, a file can only be read by a build of this
+// program with the same struct Token (and byte order, and list of functions); the header records
+// these, and any other file is turned down rather than misread.
+//
+// Layout (every offset is from the start of the file, and a multiple of 8):
+//     struct Program_File_Header
+//     struct Program_File_Entry[program_count]
+//     each program's tokens (struct Token[length]), text pointers set to NULL
+//     each program's expression text, as it was written
+
+#define PROGRAM_FILE_MAGIC 0x46504349u // "ICPF"
+#define PROGRAM_FILE_VERSION 1
+#define PROGRAM_FILE_BYTE_ORDER 0x01020304u // reads differently on a machine of the other order
+
+// --- Type declarations ---
+
+enum Program_File_Error {
+    Program_File_Unreadable = -1, // the file couldn't be opened, mapped or written
+    Program_File_Invalid = -2, // not a program file, or one written by a different build
+    Program_File_No_Program = -3, // no program with that index, or its code is corrupt
+    Program_File_Out_Of_Memory = -4
+};
+
+struct Program_File_Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order; // PROGRAM_FILE_BYTE_ORDER
+    uint32_t token_size; // sizeof(struct Token)
+    uint32_t function_count; // Func_Count, so that function numbers mean the same functions
+    uint32_t reserved;
+    uint64_t program_count;
+    uint64_t file_size;
+};
+
+struct Program_File_Entry {
+    uint64_t hash; // program_hash() of the program
+    uint64_t code_offset;
+    uint64_t text_offset;
+    uint32_t length; // Tokens in the program
+    uint32_t max_depth; // Most values on the evaluation stack at once
+    uint32_t text_length;
+    uint32_t variables; // Variable slots used: 1 if the program uses x, 0 if it is a constant
+};
+
+// An open program file
+struct Program_File {
+    const unsigned char *memory; // The mapping
+    size_t size;
+    const struct Program_File_Header *header;
+    const struct Program_File_Entry *entries;
+    long program_count;
+};
+
+// --- Function declarations ---
+
+int program_file_write(const char *path, const struct Program *programs,
+                       const char *const *texts, const size_t *text_lengths, long count);
+int program_file_open(const char *path, struct Program_File *file);
+int program_file_program(const struct Program_File *file, long index, struct Program *program);
+const char *program_file_text(const struct Program_File *file, long index, size_t *length);
+void program_file_close(struct Program_File *file);
+const char *program_file_error_message(int error);
+
+#endif
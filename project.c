@@ -35,12 +35,42 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
 #include "tokenize.h"
 #include "shunting.h"
 #include "token.h"
 #include "stack.h"
+#include "functions.h"
+#include "arena.h"
+#include "parser.h"
+#include "integrate.h"
+#include "stats.h"
+#include "profile.h"
+#include "perf.h"
+#include "chebyshev.h"
+#include "checkpoint.h"
+#include "workers.h"
+#include "program_file.h"
+#include "sweep.h"
+#include "codegen.h"
+#include "result_cache.h"
 #include "project.h"
 
+// Initial size of the per-request arena. It grows past this for long expressions.
+#define REQUEST_ARENA_SIZE (64 * 1024)
+
+// Size of the buffer a typed-in number is read into, including fgets()'s \0
+#define INPUT_BUFFER_SIZE 256
+
+// Ctrl-C (or SIGTERM) during an integration sets interrupted, and the integration stops, saving its
+// progress if there's a checkpoint file. At any other time it ends the program as usual.
+static volatile sig_atomic_t interrupted = 0;
+static volatile sig_atomic_t integrating = 0;
+static volatile sig_atomic_t working = 0; // batch jobs are being run by worker processes
+
 /*
  * ----------------------------------------------
  * Function definitions
@@ -48,118 +78,380 @@
  */
 
 /*
- * Function: main()
+ * Function: main(argc, argv)
  *
  * Description: Main subroutine of the program. Executed on startup. Contains the loop that will
  *              show the menu, get input, and use the math functions to execute the integration
- * Parameters: none (if ran from the commandline, some parameters can be given to it, but these are
- *             not used in the program)
+ * Parameters: argc, argv - the commandline arguments:
+ *                 --batch [file] - read jobs from the file (or stdin if there isn't one, or it is
+ *                                  '-') instead of showing the menu; see run_batch()
+ *                 --stats - print where the time of each request went, and some counts of what it
+ *                           did; see stats.h
+ *                 --perf - as --stats, but also read the CPU's hardware counters (cycles,
+ *                          instructions, branch and cache misses) around each stage; see perf.h
+ *                 --profile - print how much of the evaluation time each operator and function
+ *                             took; see profile.h
+ *                 --float [tolerance] - evaluate in single precision where that loses less than
+ *                                       the tolerance (relative error, default 1e-5); see
+ *                                       integrate()
+ *                 --surrogate [tolerance] - fit a Chebyshev surrogate to each expression (to the
+ *                                           relative tolerance, default 1e-12) and integrate
+ *                                           that, reusing it while the expression stays the
+ *                                           same; see chebyshev.h
+ *                 --numeric - integrate polynomials with the chosen method too, rather than
+ *                             exactly; see polynomial.h
+ *                 --non-finite stop|skip|continue - what to do if the expression is NaN or
+ *                                                   infinite somewhere in the range: stop and say
+ *                                                   where (the default), leave those points out,
+ *                                                   or integrate anyway; see integrate_double()
+ *                 --checkpoint file [seconds] - save the progress of long integrations to the file
+ *                                               every so often (default 10 seconds), and when
+ *                                               interrupted, so that running the same job again
+ *                                               carries on from there; see checkpoint.h
+ *                 --workers n - run batch jobs in n worker processes at once, so that a job that
+ *                               crashes doesn't stop the rest; see run_batch_workers()
+ *                 --save-programs file - compile the expressions in the batch input (one per
+ *                                        line) and save them to a program file, instead of
+ *                                        integrating anything; see program_file.h
+ *                 --programs file - let batch jobs use expressions from a program file, as #n
+ *                                   for the nth one; see run_job()
+ *                 --threads n - run parameter sweeps in n threads (default one per processor);
+ *                               see run_sweep_job()
+ *                 --aot [directory] - compile each expression to native code with the C compiler
+ *                                     and integrate with that, keeping the compiled code in the
+ *                                     directory (default ~/.cache/integration-c); see codegen.h
+ *                 --cache file [megabytes] - keep the results of batch jobs in the file, and answer
+ *                                            jobs that are the same as earlier ones from it; the
+ *                                            file is made the given size (default 16) if it is
+ *                                            new. See result_cache.h
  * Returns: Exit code, giving information about how the program performed (system dependant)
  */
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Everything one integration request needs (the expression, the compiled program, the
+    // evaluator's working memory) is allocated from this arena, which is reset before each
+    // request, so there is nothing to free on the way out of a request and, once the arena has
+    // grown to fit the largest request, no calls to malloc at all
+    struct Arena arena;
+    if (arena_init(&arena, REQUEST_ARENA_SIZE) != 0) {
+        printf("Unable to allocate memory! Please check that you have enough RAM free.\n");
+        return EXIT_FAILURE;
+    }
+
+    int batch = 0;
+    const char *batch_path = "-";
+    int use_perf = 0;
+    const char *checkpoint_path = NULL;
+    double checkpoint_interval = 0;
+    const char *save_path = NULL;
+    const char *programs_path = NULL;
+    struct Program_File programs = { NULL };
+    int use_kernels = 0;
+    const char *kernel_directory = NULL;
+    const char *results_path = NULL;
+    double results_megabytes = 0;
+    struct Result_Cache results = { NULL };
+    struct Settings settings = {
+        .show_stats = 0,
+        .show_profile = 0,
+        .precision = Precision_Double,
+        .tolerance = 0,
+        .use_surrogate = 0,
+        .surrogate_tolerance = 0,
+        .force_numeric = 0,
+        .non_finite = Non_Finite_Stop,
+        .checkpoint = NULL,
+        .workers = 0,
+        .programs = NULL,
+        .threads = 0,
+        .kernels = NULL,
+        .results = NULL
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) { batch_path = argv[++i]; }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            settings.show_stats = 1;
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            settings.show_stats = 1;
+            use_perf = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            settings.show_profile = 1;
+        } else if (strcmp(argv[i], "--float") == 0) {
+            settings.precision = Precision_Float;
+            char *number_end; // the tolerance is optional, so only taken if it's a number
+            if (i + 1 < argc && (settings.tolerance = strtod(argv[i + 1], &number_end),
+                                 number_end != argv[i + 1] && *number_end == '\0')) {
+                i++;
+            } else {
+                settings.tolerance = 0;
+            }
+        } else if (strcmp(argv[i], "--surrogate") == 0) {
+            settings.use_surrogate = 1;
+            char *number_end;
+            if (i + 1 < argc && (settings.surrogate_tolerance = strtod(argv[i + 1], &number_end),
+                                 number_end != argv[i + 1] && *number_end == '\0')) {
+                i++;
+            } else {
+                settings.surrogate_tolerance = 0;
+            }
+        } else if (strcmp(argv[i], "--numeric") == 0) {
+            settings.force_numeric = 1;
+        } else if (strcmp(argv[i], "--non-finite") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "stop") == 0 || strcmp(argv[i + 1], "skip") == 0 ||
+                    strcmp(argv[i + 1], "continue") == 0)) {
+            i++;
+            if (strcmp(argv[i], "stop") == 0) { settings.non_finite = Non_Finite_Stop; }
+            else if (strcmp(argv[i], "skip") == 0) { settings.non_finite = Non_Finite_Skip; }
+            else { settings.non_finite = Non_Finite_Continue; }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+            char *number_end;
+            if (i + 1 < argc && (checkpoint_interval = strtod(argv[i + 1], &number_end),
+                                 number_end != argv[i + 1] && *number_end == '\0')) {
+                i++;
+            } else {
+                checkpoint_interval = 0;
+            }
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc &&
+                   (settings.workers = atoi(argv[i + 1])) > 0) {
+            i++;
+        } else if (strcmp(argv[i], "--save-programs") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "--programs") == 0 && i + 1 < argc) {
+            programs_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc &&
+                   (settings.threads = atoi(argv[i + 1])) > 0) {
+            i++;
+        } else if (strcmp(argv[i], "--aot") == 0) {
+            use_kernels = 1;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                kernel_directory = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            results_path = argv[++i];
+            char *number_end;
+            if (i + 1 < argc && (results_megabytes = strtod(argv[i + 1], &number_end),
+                                 number_end != argv[i + 1] && *number_end == '\0' &&
+                                 results_megabytes > 0)) {
+                i++;
+            } else {
+                results_megabytes = 0;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--batch [file|-]] [--stats] [--perf] [--profile] "
+                            "[--float [tolerance]] [--surrogate [tolerance]] [--numeric] "
+                            "[--non-finite stop|skip|continue] [--checkpoint file [seconds]] "
+                            "[--workers n] [--save-programs file] [--programs file] "
+                            "[--threads n] [--aot [directory]] [--cache file [megabytes]]\n",
+                    argv[0]);
+            arena_free(&arena);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (save_path != NULL) {
+        int exit_code = save_programs(batch_path, save_path, &arena);
+        arena_free(&arena);
+        return exit_code;
+    }
+    if (programs_path != NULL) {
+        int error = program_file_open(programs_path, &programs);
+        if (error != 0) {
+            fprintf(stderr, "Could not open program file '%s': %s\n", programs_path,
+                    program_file_error_message(error));
+            arena_free(&arena);
+            return EXIT_FAILURE;
+        }
+        settings.programs = &programs;
+    }
+
+    // The checkpoint writer's thread wouldn't be there in worker processes, and the workers would
+    // all be writing to the same file anyway
+    if (checkpoint_path != NULL && settings.workers > 0) {
+        fprintf(stderr, "--checkpoint can't be used with --workers\n");
+        arena_free(&arena);
+        return EXIT_FAILURE;
+    }
+    if (checkpoint_path != NULL) {
+        settings.checkpoint = checkpoint_open(checkpoint_path, checkpoint_interval);
+        if (settings.checkpoint == NULL) {
+            fprintf(stderr, "Could not start writing checkpoints to '%s'\n", checkpoint_path);
+            arena_free(&arena);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Without a cache directory, expressions are just evaluated as normal
+    if (use_kernels) {
+        settings.kernels = kernel_cache_open(kernel_directory);
+        if (settings.kernels == NULL) {
+            fprintf(stderr, "warning: could not use '%s' for --aot, so it is ignored\n",
+                    (kernel_directory != NULL) ? kernel_directory : "the cache directory");
+        }
+    }
+
+    if (results_path != NULL) {
+        int error = result_cache_open(results_path, (size_t)(results_megabytes * (1 << 20)),
+                                      &results);
+        if (error != 0) {
+            fprintf(stderr, "Could not open result cache '%s': %s\n", results_path,
+                    result_cache_error_message(error));
+            kernel_cache_close(settings.kernels);
+            program_file_close(&programs);
+            checkpoint_close(settings.checkpoint);
+            arena_free(&arena);
+            return EXIT_FAILURE;
+        }
+        settings.results = &results;
+    }
+
+    struct sigaction action = { 0 };
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // If the counters can't be opened, perf_open() says why and --perf works like --stats
+    perf_init(&settings.perf);
+    if (use_perf) { perf_open(&settings.perf, stderr); }
+
+    if (batch) {
+        int exit_code = run_batch(batch_path, &arena, &settings);
+        kernel_cache_close(settings.kernels);
+        result_cache_close(&results);
+        checkpoint_close(settings.checkpoint);
+        program_file_close(&programs);
+        perf_close(&settings.perf);
+        arena_free(&arena);
+        return exit_code;
+    }
+
+    struct Request_Stats stats;
+    struct Eval_Profile profile;
+    struct Surrogate_Cache surrogates = { 0 };
+
     while (1) {
+        arena_reset(&arena);
         
         int choice;
         choice = menu();
         
         // Clear stdin buffer from above keypresses
-        // If we don't then the next fgets() is instantly filled by a single \n
+        // If we don't then the next read_line() is instantly filled by a single \n
         int c;
         while ((c = getchar()) != '\n' && c != EOF) { }
 
-        if (choice == 4) {
+        if (choice == 6) {
+            free_surrogate_cache(&surrogates);
+            kernel_cache_close(settings.kernels);
+            result_cache_close(&results);
+            checkpoint_close(settings.checkpoint);
+            perf_close(&settings.perf);
+            arena_free(&arena);
             return EXIT_SUCCESS; // Quit program with appropriate exit code
-        } else if (choice == 3) {
+        } else if (choice == 5) {
             // Show help
             printf(
 "\nThis is an integral calculator using several different methods for numerically\n\
 computing (i.e. computing without algebra) integral expressions. Mostly any\n\
-expression is supported, aside from some more niche functions (hyperbolic trigs,\n\
-binomial choose, to name a few) and similarly niche operators (e.g. factorial)\n\n\
+expression is supported, aside from some more niche functions (binomial choose,\n\
+to name one) and similarly niche operators (e.g. factorial)\n\n\
 A few points to note:\n\n\
 \t* At this time, the only variable of integration supported is x. Use this,\n\
 \t  and only this, when you want to use a variable.\n\
 \t* Please always enclose function arguments in brackets: e.g. ln(x) instead of lnx.\n\
-\t* The implemented functions are:\n\
-\t\t- 'sin',\n\
-\t\t- 'cos',\n\
-\t\t- 'tan',\n\
-\t\t- 'ln',\n\
-\t\t- 'exp' (base e),\n\
-\t\t- 'log' (which is base 10).\n\
-\t* The above functions can be used in an expression by typing their name (as\n\
-\t  enclosed in quotes above).\n\
+\t* The implemented functions are:\n"
+            );
+            // The function list comes from the registry, so it can't go out of date
+            for (int i = 0; i < Func_Count; i++) {
+                if (function_table[i].arity == 0) { continue; }
+                printf("\t\t- '%s'\n", function_table[i].name);
+            }
+            printf(
+"\t  'ln' is base e and 'log' is base 10.\n\
+\t* The named constants are:\n"
+            );
+            for (int i = 0; i < Func_Count; i++) {
+                if (function_table[i].arity != 0) { continue; }
+                printf("\t\t- '%s'\n", function_table[i].name);
+            }
+            printf(
+"\t* The above functions and constants can be used in an expression by typing their\n\
+\t  name (as enclosed in quotes above).\n\
 \t* The implemented operators are:\n\
 \t\t- Addition (+)\n\
 \t\t- Subtraction (-)\n\
 \t\t- Multiplication (*)\n\
 \t\t- Division (/)\n\
 \t\t- Exponents (^)\n\
+\t\t- Negation (-), e.g. -x^2, which is -(x^2)\n\
 \t* Implicit multiplication is supported (e.g. 4sin(x) will be interpreted as \n\
-\t  4*sin(x))\n\n"
+\t  4*sin(x), and x(x+1) as x*(x+1))\n\n"
             );
             continue; // show menu again
         }
 
-        // At this point, options 3/4 have broken the flow of the program, so we're only here
+        // At this point, options 5/6 have broken the flow of the program, so we're only here
         // if we want to do some integration. We can therefore prepare for this, and only decide
-        // which method to use later.1
-        char expression[64] = ""; // The expression to evaluate
-        int strips; // The width of the strips used in the approximation
+        // which method to use later.
+        long strips; // The width of the strips used in the approximation
         double start; // The lower value of the range
         double end; // The upper value of the range
 
+        // The expression can be any length, so it's read into a buffer that grows as needed. It
+        // can also be read from a file, for expressions too long to type
+        printf("\nPlease enter an expression to perform integration of (or @file to read it from "
+               "a file): ");
+        size_t exp_length;
+        char *expression = read_line(stdin, &exp_length, &arena);
+        if (expression == NULL) { // stdin closed
+            free_surrogate_cache(&surrogates);
+            kernel_cache_close(settings.kernels);
+            result_cache_close(&results);
+            checkpoint_close(settings.checkpoint);
+            perf_close(&settings.perf);
+            arena_free(&arena);
+            return EXIT_SUCCESS;
+        }
 
-        
+        // Only counted from here: the time spent waiting for the user to type is of no interest
+        stats_begin(&stats, settings.show_stats, &settings.perf, &arena);
 
-        // Getting expression doesn't involve a function call, since it's just 2 lines and only one
-        // string is ever taken from user input
-        printf("\nPlease enter an expression to perform integration of: ");
-        fgets(expression, 65, stdin); // includes newline from user, so 64+1
-        // get rid of the newline
-        int exp_length = strlen(expression);
-        if (expression[exp_length-1] == '\n') { expression[exp_length-1] = 0; }
-
-        // Tokenize expression
-        // In considering the maximum tokens, it's tempting to say "the maximum is if each
-        // character is a token, e.g. '2*3*4*5'", but this doesn't account for implicit 
-        // multiplication - the maximum tokens is created by an expression like '()()()' which has
-        // 6 characters but 8 tokens (even if that's a garbage expression, it's technically valid, 
-        // it just produces an empty stack once shunting yard is done). So the maximum token:char 
-        // ratio is not 1, but rather 8/6 = 4/3 ~= 1.333333
-
-        // Strictly speaking, it *would* be more efficient to perform a regex match to detect
-        // implicit multiplication and all tokens and allocate memory accordingly, but this current
-        // solution uses less than 1MB for most simple expressions, and the expression is only
-        // tokenized once, so I'm sure I won't be crashing any systems by letting laziness take
-        // over in this case.
-
-        int max_exp_tokens = (int)(ceil(strlen(expression) * 1.333333333));
-
-        if (max_exp_tokens == 0) { // These checks exist to make sure we don't malloc() 0 bytes
-            printf("\nIntegration result: 0\n\n"); // Don't even bother 
-            continue;
+        if (expression[0] == '@') {
+            const char *path = expression;
+            stats_start(&stats);
+            expression = read_file(path + 1, &exp_length, &arena);
+            stats_stop(&stats, Stage_Read);
+            if (expression == NULL) {
+                printf("\nCould not read an expression from '%s'\n\n", path + 1);
+                continue;
+            }
         }
-        
-        struct Token* tokenized_exp = malloc(max_exp_tokens * sizeof(struct Token));
-        int exp_tokens = exp_to_tokens(expression, tokenized_exp); // assigns the tokenized exp to 
-                                                                   // that pointer (2nd argument)
 
-        // printf("\nTokenized: ");
-        // print_tokenized(tokenized_exp, exp_tokens);
+        struct Program program;
+        stats_start(&stats);
+        int rc = compile_expression(expression, exp_length, &arena, &program); // rc: rpn tokens
+        stats_stop(&stats, Stage_Compile);
+        stats.expression_length = exp_length;
+        stats.program_length = program.length;
 
-        if (exp_tokens == 0) {
-            printf("\nIntegration result: 0\n\n"); 
+        if (rc == Parse_Unknown_Token) {
+            printf("\nUnrecognized token found in input expression: '%c'\n\n",
+                   expression[program.error_offset]);
+            continue;
+        } else if (rc < 0) {
+            printf("\nCould not understand the expression: %s\n\n", parse_error_message(rc));
+            continue;
+        } else if (rc == 0) {
+            printf("\nIntegration result: 0\n\n"); // Don't even bother 
             continue;
         }
-
-        struct Token* rpn_exp = malloc(exp_tokens * sizeof(struct Token)); // same deal
-        int rc = shunting_yard(tokenized_exp, exp_tokens, rpn_exp); // rc: number of shunted tokens
-        
         
         // printf("RPN: ");
-        // print_tokenized(rpn_exp, rc);
+        // print_tokenized(program.code, program.length);
 
         start = get_double_input("Please enter the lower limit of integration: ");
         end = get_double_input("Please enter the upper limit of integration: ");
@@ -171,76 +463,1030 @@ A few points to note:\n\n\
             continue;
         }
 
-        strips = get_int_input("Please enter the number of strips to use: ");        
+        // Clenshaw-Curtis quadrature stops as soon as it has converged, so this is only the most
+        // strips it will use
+        strips = get_long_input((choice == 4) ? "Please enter the most strips to use (rounded up "
+                                                "to a power of two): " :
+                                                "Please enter the number of strips to use: ");
+
+        struct Integration_Options options = {
+            .method = (choice == 1) ? Method_Simpson :
+                      (choice == 2) ? Method_Trapezium :
+                      (choice == 3) ? Method_Richardson : Method_Clenshaw_Curtis,
+            .strips = strips,
+            .profile = settings.show_profile ? &profile : NULL,
+            .precision = settings.precision,
+            .tolerance = settings.tolerance,
+            .force_numeric = settings.force_numeric,
+            .non_finite = settings.non_finite,
+            .checkpoint = settings.checkpoint,
+            .interrupted = &interrupted
+        };
+        if (settings.show_profile) { profile_init(&profile); }
+        struct Integration_Result result;
+        stats_start(&stats);
+        if (settings.use_surrogate) {
+            options.surrogate = cached_surrogate(&surrogates, expression, exp_length, &program,
+                                                 start, end, settings.surrogate_tolerance, &arena);
+        }
+        options.kernel = kernel_cache_get(settings.kernels, &program, start, end, &arena);
+        integrating = 1;
+        rc = integrate(&program, start, end, &options, &result, &arena);
+        integrating = 0;
+        stats_stop(&stats, Stage_Integrate);
+
+        if (rc == Integration_Interrupted || interrupted) {
+            printf("\nInterrupted%s.\n", (settings.checkpoint != NULL) ?
+                   "; run the same integration again to carry on from where it got to" : "");
+            free_surrogate_cache(&surrogates);
+            kernel_cache_close(settings.kernels);
+            result_cache_close(&results);
+            checkpoint_close(settings.checkpoint);
+            perf_close(&settings.perf);
+            arena_free(&arena);
+            return EXIT_FAILURE;
+        } else if (rc == Integration_Not_Finite) {
+            printf("\nThe expression is NaN or infinite (e.g. ln of a negative number, or division "
+                   "by 0)\nbetween x = %g and x = %g, so can't be integrated over this range.\n",
+                   result.bad_start, result.bad_end);
+        } else if (options.method == Method_Richardson && !result.exact) {
+            printf("\nIntegration result: %f (+/- %.1e)\n", result.value, result.error_estimate);
+            printf("\tTrapezium rule: %f\n", result.trapezium);
+            printf("\tMidpoint rule (half as many strips): %f\n", result.midpoint);
+            printf("\tSimpson's rule: %f\n", result.simpson);
+            printf("\tRichardson extrapolation of those: %f\n", result.value);
+            printf("(%ld evaluations)\n", result.evaluations);
+        } else if (options.method == Method_Clenshaw_Curtis && !result.exact &&
+                   !result.from_surrogate) {
+            printf("\nIntegration result: %f (+/- %.1e)\n", result.value, result.error_estimate);
+            printf("(%ld evaluations, at Chebyshev points)\n", result.evaluations);
+        } else {
+            printf("\nIntegration result: %f\n", result.value);
+        }
+        if (result.exact) { printf("(exact, as the expression is a polynomial)\n"); }
+        if (result.resumed_from > 0) {
+            printf("(carried on from a checkpoint at point %ld of %ld)\n", result.resumed_from,
+                   options.strips);
+        }
+        if (settings.non_finite == Non_Finite_Skip && !isnan(result.bad_start)) {
+            printf("(left out %ld NaN or infinite values between x = %g and x = %g)\n",
+                   result.nan_results + result.inf_results, result.bad_start, result.bad_end);
+        }
+        if (settings.use_surrogate && !result.exact) {
+            if (result.from_surrogate) {
+                printf("(from a surrogate of %d piece%s, fitted with %ld evaluations)\n",
+                       options.surrogate->piece_count,
+                       (options.surrogate->piece_count == 1) ? "" : "s",
+                       options.surrogate->evaluations);
+            } else {
+                printf("(a surrogate couldn't be fitted, so the expression was integrated "
+                       "directly)\n");
+            }
+        }
+        if (settings.precision == Precision_Float && options.method != Method_Richardson &&
+            options.method != Method_Clenshaw_Curtis) {
+            printf("(%s precision; single precision's estimated relative error: %.1e)\n",
+                   (result.precision == Precision_Float) ? "single" : "fell back to double",
+                   result.precision_loss);
+        }
+        printf("\n");
+
+        if (settings.show_stats) {
+            stats_add_result(&stats, &result);
+            stats_end(&stats, &arena);
+            stats_print(&stats, stdout);
+        }
+        if (settings.show_profile) { profile_print(&profile, stdout); }
+    }
+}
+
+/*
+ * Function: handle_signal(signal_number)
+ *
+ * Description: Handles SIGINT and SIGTERM. During an integration (or while worker processes are
+ *              running batch jobs) it just sets interrupted, so that the integration can stop (and
+ *              save a checkpoint) on its own; otherwise there is nothing to save, so the signal is
+ *              raised again with its usual effect.
+ * Parameters: signal_number - the signal
+ * Returns: none
+ */
+
+void handle_signal(int signal_number) {
+    if (integrating || working) {
+        interrupted = 1;
+        return;
+    }
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+/*
+ * Function: run_batch(path, arena, settings)
+ *
+ * Description: Runs integration jobs non-interactively, one per line of the input, in the form
+ *                  <method> <lower limit> <upper limit> <strips> <expression>
+ *              where method is 'simpson', 'trapezium', 'richardson' or 'clenshaw-curtis', and
+ *              the expression is the rest of the line (so it can contain spaces, and be of any
+ *              length). One result is printed per job, in the same order, or a line starting
+ *              with 'error' if the job was invalid. For 'richardson' and 'clenshaw-curtis', the
+ *              result is followed by its estimated error; for 'clenshaw-curtis', strips is the
+ *              most it may use.
+ *              The expression can also be several, separated by ';', to integrate them all over
+ *              the same grid at once, with their results on one line; see run_fused_job().
+ *              Or it can have parameters, and be integrated for many values of them at once;
+ *              see run_sweep_job(). Neither works with 'clenshaw-curtis', which has no grid.
+ *              With --workers, the jobs are run by that many processes at once instead; see
+ *              run_batch_workers().
+ * Parameters: path, the file to read jobs from, or '-' for stdin
+ *             arena, the arena to allocate from, which is reset before each job
+ *             settings, the settings from the commandline. Statistics are written to stderr as
+ *             a line of JSON per job (see stats_print_json()), and evaluator profiles to stderr
+ *             too, so that stdout still has one result per line.
+ * Returns: Exit code - EXIT_FAILURE if the input couldn't be opened or the jobs were interrupted
+ *          (see main()), EXIT_SUCCESS otherwise
+ */
+
+int run_batch(const char *path, struct Arena *arena, const struct Settings *settings) {
+    FILE *input = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if (input == NULL) {
+        fprintf(stderr, "Could not open batch file '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    if (settings->workers > 0) {
+        int exit_code = run_batch_workers(input, arena, settings);
+        if (input != stdin) { fclose(input); }
+        return exit_code;
+    }
+
+    size_t line_length;
+    char *line;
+    struct Request_Stats stats;
+    struct Surrogate_Cache surrogates = { 0 };
+    int exit_code = EXIT_SUCCESS;
+
+    while (1) {
+        arena_reset(arena);
+        stats_begin(&stats, settings->show_stats, &settings->perf, arena);
+
+        stats_start(&stats);
+        line = read_line(input, &line_length, arena);
+        stats_stop(&stats, Stage_Read);
+        if (line == NULL) { break; }
+
+        if (line_length == 0 || line[0] == '#') { continue; } // blank/comment
+
+        run_job(line, line_length, arena, settings, &surrogates, &stats, stdout);
+
+        // The rest of the jobs aren't started, so that the program ends promptly
+        if (interrupted) {
+            if (settings->checkpoint != NULL) {
+                fprintf(stderr, "Interrupted; run the same job again to carry on from where it "
+                                "got to\n");
+            }
+            exit_code = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    free_surrogate_cache(&surrogates);
+    if (input != stdin) { fclose(input); }
+    return exit_code;
+}
+
+/*
+ * Function: job_program(settings, expression, length, number, arena, program, output)
+ *
+ * Description: Gets the program for one of a batch job's expressions: compiles it, or, if it is #n
+ *              and there is a program file (--programs), takes the nth program from the file.
+ *              If that fails, says why on the output.
+ * Parameters: settings - the settings from the commandline
+ *             expression, length - the expression
+ *             number - which of the job's expressions this is (counting from 1), to say which
+ *                      one was wrong, or 0 if the job only has one
+ *             arena - the arena to compile into
+ *             program - where the program is written
+ *             output - where any error is printed
+ * Returns: The length of the program (0 for an empty expression), or a negative number on error
+ */
+
+int job_program(const struct Settings *settings, const char *expression, size_t length,
+                int number, struct Arena *arena, struct Program *program, FILE *output) {
+    char prefix[32] = "";
+    if (number > 0) { snprintf(prefix, sizeof(prefix), "expression %d: ", number); }
+    program->length = 0;
+
+    size_t skip = 0; // compile_expression() skips spaces itself, but #n has to be found
+    while (skip < length && expression[skip] == ' ') { skip++; }
+    if (settings->programs != NULL && skip < length && expression[skip] == '#') {
+        // The number is copied out first: the expression may not end with a \0 (it can be one of
+        // several separated by ';')
+        char digits[24] = "";
+        size_t count = 0;
+        while (skip + 1 + count < length && count < sizeof(digits) - 1 &&
+               isdigit((unsigned char)expression[skip + 1 + count])) {
+            digits[count] = expression[skip + 1 + count];
+            count++;
+        }
+        size_t rest = skip + 1 + count;
+        while (rest < length && expression[rest] == ' ') { rest++; }
+        char *number_end;
+        errno = 0;
+        long index = strtol(digits, &number_end, 10);
+        if (count == 0 || number_end != digits + count || errno != 0 || rest < length) {
+            fprintf(output, "error: %sexpected '#' and the number of an expression in the program "
+                            "file, and nothing after it\n", prefix);
+            return Program_File_No_Program;
+        }
+        int rc = program_file_program(settings->programs, index - 1, program);
+        if (rc != 0) {
+            fprintf(output, "error: %s%s\n", prefix, program_file_error_message(rc));
+            return rc;
+        }
+        return program->length;
+    }
+
+    int rc = compile_expression(expression, length, arena, program);
+    if (rc < 0) {
+        fprintf(output, "error: %scould not understand the expression: %s\n", prefix,
+                parse_error_message(rc));
+    }
+    return rc;
+}
+
+/*
+ * Function: run_fused_job(expressions, length, start, end, options, arena, settings, stats,
+ *                         output)
+ *
+ * Description: Runs a batch job with several expressions, separated by ';', integrating them all
+ *              over the same range and grid at once (see fused.h): each block of points is
+ *              evaluated once for every expression, and anything they have in common is only
+ *              worked out once. The results are printed on one line, separated by spaces, in the
+ *              order the expressions were given (for 'richardson', each followed by its
+ *              estimated error). These are always numerical, double precision integrals, the same
+ *              as --numeric gives for each expression on its own.
+ * Parameters: expressions, length - the job's expressions
+ *             start, end - the limits of integration
+ *             options - how to integrate
+ *             arena - the arena to allocate from
+ *             settings - the settings from the commandline
+ *             stats - the job's statistics, already begun
+ *             output - where the results are printed
+ * Returns: none
+ */
+
+void run_fused_job(const char *expressions, size_t length, double start, double end,
+                   const struct Integration_Options *options, struct Arena *arena,
+                   const struct Settings *settings, struct Request_Stats *stats, FILE *output) {
+    int count = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (expressions[i] == ';') { count++; }
+    }
+
+    struct Program *programs = arena_alloc(arena, count * sizeof(struct Program));
+    struct Integration_Result *results = arena_alloc(arena,
+                                                     count * sizeof(struct Integration_Result));
+    int *statuses = arena_alloc(arena, count * sizeof(int));
+    if (programs == NULL || results == NULL || statuses == NULL) {
+        fprintf(output, "error: out of memory\n");
+        return;
+    }
+
+    // Compile each expression, then fuse them
+    struct Fused_Program fused;
+    int ok = 1;
+    const char *expression = expressions;
+    stats_start(stats);
+    for (int e = 0; e < count && ok; e++) {
+        const char *separator = memchr(expression, ';', expressions + length - expression);
+        size_t expression_length = (separator != NULL) ? (size_t)(separator - expression) :
+                                                         (size_t)(expressions + length -
+                                                                  expression);
+        ok = job_program(settings, expression, expression_length, e + 1, arena, &programs[e],
+                         output) >= 0;
+        stats->program_length += programs[e].length;
+        if (separator != NULL) { expression = separator + 1; }
+    }
+    if (ok && fused_compile(programs, count, &fused, arena) != 0) {
+        fprintf(output, "error: out of memory\n");
+        ok = 0;
+    }
+    stats_stop(stats, Stage_Compile);
+    stats->expression_length = length;
+
+    if (ok && fabs(start-end) < 0.0000001) {
+        for (int e = 0; e < count; e++) { fprintf(output, (e > 0) ? " 0" : "0"); }
+        fprintf(output, "\n");
+    } else if (ok) {
+        stats_start(stats);
+        integrating = 1;
+        int rc = integrate_fused(&fused, start, end, options, results, statuses, arena);
+        integrating = 0;
+        stats_stop(stats, Stage_Integrate);
+        for (int e = 0; e < count && rc != Integration_Out_Of_Memory; e++) {
+            stats_add_result(stats, &results[e]);
+        }
+
+        int bad = 0;
+        while (bad < count && statuses[bad] != Integration_Not_Finite) { bad++; }
+        if (rc == Integration_Interrupted) {
+            fprintf(output, "error: interrupted\n");
+        } else if (rc == Integration_Out_Of_Memory) {
+            fprintf(output, "error: out of memory\n");
+        } else if (bad < count) {
+            fprintf(output, "error: expression %d is NaN or infinite between x = %g and "
+                            "x = %g\n", bad + 1, results[bad].bad_start, results[bad].bad_end);
+        } else {
+            for (int e = 0; e < count; e++) {
+                if (e > 0) { fprintf(output, " "); }
+                if (options->method == Method_Richardson) {
+                    fprintf(output, "%.15g %.3g", results[e].value, results[e].error_estimate);
+                } else {
+                    fprintf(output, "%.15g", results[e].value);
+                }
+            }
+            fprintf(output, "\n");
+        }
+
+        for (int e = 0; e < count && rc == Integration_Ok; e++) {
+            if (settings->non_finite == Non_Finite_Skip && !isnan(results[e].bad_start)) {
+                fprintf(stderr, "warning: expression %d: left out %ld NaN or infinite values "
+                                "between x = %g and x = %g\n", e + 1,
+                        results[e].nan_results + results[e].inf_results, results[e].bad_start,
+                        results[e].bad_end);
+            }
+        }
+    }
+
+    if (settings->show_stats) {
+        stats_end(stats, arena);
+        stats_print_json(stats, stderr);
+    }
+}
+
+/*
+ * Function: parse_sweep(text, length, arena, names, name_count, parameters, set_count, output)
+ *
+ * Description: Reads the values of a sweep's parameters (see run_sweep_job()): one or more
+ *              sections, each starting with '|', of the form
+ *                  <names> = <values>
+ *              where the values are either lower:upper:count, for count evenly spaced values of one
+ *              parameter from lower to upper, or a list of numbers (separated by spaces or
+ *              commas), taken a set at a time for several names, e.g. 'a b = 1 2, 3 4' gives
+ *              a = 1, b = 2 then a = 3, b = 4. The sets are every combination of one from each
+ *              section, with the last section's changing fastest. If the values are wrong, says
+ *              why on the output.
+ * Parameters: text, length - the sections
+ *             arena - the arena the names and values are allocated from
+ *             names - where the parameters' names are written (SWEEP_MAX_PARAMETERS of them)
+ *             name_count - where the number of parameters is written
+ *             parameters - where the sets of values are written, a set after another
+ *             set_count - where the number of sets is written
+ *             output - where any error is printed
+ * Returns: 0 on success, -1 on error
+ */
+
+int parse_sweep(const char *text, size_t length, struct Arena *arena, const char **names,
+                int *name_count, double **parameters, long *set_count, FILE *output) {
+    // Each section's names are names[first[s]] onwards, width[s] of them, and its sets are
+    // values[s], count[s] of them
+    int first[SWEEP_MAX_PARAMETERS], width[SWEEP_MAX_PARAMETERS];
+    double *values[SWEEP_MAX_PARAMETERS];
+    long count[SWEEP_MAX_PARAMETERS];
+    int sections = 0;
+    *name_count = 0;
+    *set_count = 1;
+
+    const char *end = text + length;
+    const char *section = text;
+    while (section < end) {
+        section++; // past the '|'
+        const char *section_end = memchr(section, '|', end - section);
+        if (section_end == NULL) { section_end = end; }
+        const char *equals = memchr(section, '=', section_end - section);
+        if (equals == NULL || sections == SWEEP_MAX_PARAMETERS) {
+            fprintf(output, "error: expected '| <names> = <values>' after the expression\n");
+            return -1;
+        }
+
+        // The names, up to the '='
+        first[sections] = *name_count;
+        const char *c = section;
+        while (c < equals) {
+            if (*c == ' ' || *c == '\t') {
+                c++;
+                continue;
+            }
+            const char *name_end = c;
+            while (name_end < equals && *name_end != ' ' && *name_end != '\t') { name_end++; }
+            char *name = arena_alloc(arena, name_end - c + 1);
+            if (name == NULL || *name_count == SWEEP_MAX_PARAMETERS) {
+                fprintf(output, "error: too many parameters (at most %d)\n",
+                        SWEEP_MAX_PARAMETERS);
+                return -1;
+            }
+            memcpy(name, c, name_end - c);
+            name[name_end - c] = '\0';
+            int duplicate = 0;
+            for (int k = 0; k < *name_count; k++) { duplicate |= strcmp(names[k], name) == 0; }
+            if (!valid_parameter_name(name) || duplicate) {
+                fprintf(output, "error: '%s' can't be a parameter's name (names are letters, not "
+                                "starting with x, and can't be used twice)\n", name);
+                return -1;
+            }
+            names[(*name_count)++] = name;
+            c = name_end;
+        }
+        width[sections] = *name_count - first[sections];
+        if (width[sections] == 0) {
+            fprintf(output, "error: expected a parameter's name before '='\n");
+            return -1;
+        }
+
+        // The values: first copied out, so that strtod() stops at the end of the section
+        size_t values_length = section_end - (equals + 1);
+        char *copy = arena_alloc(arena, values_length + 1);
+        double *list = arena_alloc(arena, (values_length / 2 + 1) * sizeof(double));
+        if (copy == NULL || list == NULL) {
+            fprintf(output, "error: out of memory\n");
+            return -1;
+        }
+        memcpy(copy, equals + 1, values_length);
+        copy[values_length] = '\0';
+
+        double lower, upper;
+        long points;
+        int used;
+        if (strchr(copy, ':') != NULL) {
+            if (sscanf(copy, " %lf : %lf : %ld %n", &lower, &upper, &points, &used) < 3 ||
+                copy[used] != '\0' || points <= 0 || width[sections] != 1) {
+                fprintf(output, "error: expected '<name> = <lower>:<upper>:<count>'\n");
+                return -1;
+            }
+            list = arena_alloc(arena, points * sizeof(double));
+            if (list == NULL) {
+                fprintf(output, "error: out of memory\n");
+                return -1;
+            }
+            for (long i = 0; i < points; i++) {
+                list[i] = (points == 1) ? lower : lower + (upper - lower) * i / (points - 1);
+            }
+            count[sections] = points;
+        } else {
+            long numbers = 0;
+            char *cursor = copy;
+            while (1) {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == ',') { cursor++; }
+                if (*cursor == '\0') { break; }
+                char *number_end;
+                list[numbers] = strtod(cursor, &number_end);
+                if (number_end == cursor) {
+                    fprintf(output, "error: expected a number in the values of '%s'\n",
+                            names[first[sections]]);
+                    return -1;
+                }
+                numbers++;
+                cursor = number_end;
+            }
+            if (numbers == 0 || numbers % width[sections] != 0) {
+                fprintf(output, "error: expected a whole number of sets of %d values\n",
+                        width[sections]);
+                return -1;
+            }
+            count[sections] = numbers / width[sections];
+        }
+        values[sections] = list;
+
+        if (count[sections] > LONG_MAX / (long)sizeof(double) / SWEEP_MAX_PARAMETERS /
+                              *set_count) {
+            fprintf(output, "error: too many sets of values\n");
+            return -1;
+        }
+        *set_count *= count[sections];
+        sections++;
+        section = section_end;
+    }
 
-        // Swap because integration method goes from lowest to highest
-        if (start > end) {
-            double tmp;
-            tmp = start;
-            start = end;
-            end = tmp;
+    *parameters = arena_alloc(arena, *set_count * *name_count * sizeof(double));
+    if (*parameters == NULL) {
+        fprintf(output, "error: out of memory\n");
+        return -1;
+    }
+    for (long i = 0; i < *set_count; i++) {
+        long rest = i; // which set of each section, the last changing fastest
+        for (int s = sections - 1; s >= 0; s--) {
+            long chosen = rest % count[s];
+            rest /= count[s];
+            for (int k = 0; k < width[s]; k++) {
+                (*parameters)[i * *name_count + first[s] + k] = values[s][chosen * width[s] + k];
+            }
         }
+    }
+    return 0;
+}
 
-        double dx = fabs(start - end);
+/*
+ * Function: run_sweep_job(text, length, start, end, options, arena, settings, stats, output)
+ *
+ * Description: Runs a batch job that integrates an expression with parameters for many values of
+ *              them, e.g.
+ *                  simpson 0 1 1000 a sin(b x) | a = 1 2 | b = 0:10:101
+ *              which integrates it for every combination of a and b (see parse_sweep()). The
+ *              expression is only compiled once, and the integrations are run together, across
+ *              settings->threads threads (see sweep.h). The results are printed on one line,
+ *              separated by spaces, in the order of the sets (for 'richardson', each followed by
+ *              its estimated error); a set whose integral was stopped by a NaN or infinity is
+ *              'nan'. These are always numerical, double precision integrals.
+ * Parameters: text, length - the expression, and the sections giving its parameters' values
+ *             start, end - the limits of integration
+ *             options - how to integrate
+ *             arena - the arena to allocate from
+ *             settings - the settings from the commandline
+ *             stats - the job's statistics, already begun
+ *             output - where the results are printed
+ * Returns: none
+ */
 
-        // printf("|%f - %f| = %f\n", start, end, dx);
+void run_sweep_job(const char *text, size_t length, double start, double end,
+                   const struct Integration_Options *options, struct Arena *arena,
+                   const struct Settings *settings, struct Request_Stats *stats, FILE *output) {
+    const char *bar = memchr(text, '|', length);
+    const char *names[SWEEP_MAX_PARAMETERS];
+    int name_count;
+    double *parameters;
+    long set_count;
+    struct Program program;
 
-        double h = dx / strips;
-        double sum = 0;
-        int four_or_two = 1;
-        int n = 1;
-        double y;
-        // printf("h = %f\n", h);
+    stats_start(stats);
+    int ok = parse_sweep(bar, text + length - bar, arena, names, &name_count, &parameters,
+                         &set_count, output) == 0;
+    int rc = 0;
+    if (ok) {
+        rc = compile_parameterized(text, bar - text, names, name_count, arena, &program);
+        if (rc < 0) {
+            fprintf(output, "error: could not understand the expression: %s\n",
+                    parse_error_message(rc));
+            ok = 0;
+        }
+    }
+    stats_stop(stats, Stage_Compile);
+    stats->expression_length = bar - text;
+    stats->program_length = ok ? program.length : 0;
 
-        double current_x = start + h; // don't eval at start twice
+    double *values = ok ? arena_alloc(arena, set_count * sizeof(double)) : NULL;
+    double *errors = ok ? arena_alloc(arena, set_count * sizeof(double)) : NULL;
+    if (ok && (values == NULL || errors == NULL)) {
+        fprintf(output, "error: out of memory\n");
+        ok = 0;
+    }
 
-        // --- Simpson's rule ---
-        if (choice == 1) {
-            // First add f(x_0) and f(x_n)
-            sum += evaluate_rpn(rpn_exp, rc, start);
-            sum += evaluate_rpn(rpn_exp, rc, end);
+    if (ok) {
+        struct Sweep_Summary summary = { 0 };
+        if (rc == 0 || fabs(start-end) < 0.0000001) {
+            for (long i = 0; i < set_count; i++) { values[i] = errors[i] = 0; }
+        } else {
+            stats_start(stats);
+            integrating = 1;
+            rc = sweep_integrate(&program, parameters, name_count, set_count, start, end, options,
+                                 settings->threads, values, errors, &summary);
+            integrating = 0;
+            stats_stop(stats, Stage_Integrate);
+            stats->evaluations += summary.evaluations;
+            stats->nan_results += summary.nan_results;
+            stats->inf_results += summary.inf_results;
+        }
 
-            while (current_x <= end) {
-                if (n % 2 == 0) {
-                    // if n is even
-                    four_or_two = 2;
+        if (rc == Integration_Interrupted) {
+            fprintf(output, "error: interrupted\n");
+        } else if (rc == Integration_Out_Of_Memory) {
+            fprintf(output, "error: out of memory\n");
+        } else {
+            for (long i = 0; i < set_count; i++) {
+                if (i > 0) { fprintf(output, " "); }
+                if (options->method == Method_Richardson) {
+                    fprintf(output, "%.15g %.3g", values[i], errors[i]);
                 } else {
-                    // if n is odd
-                    four_or_two = 4;
+                    fprintf(output, "%.15g", values[i]);
                 }
-                y = evaluate_rpn(rpn_exp, rc, current_x);
-                // printf("x = %f, y = %f\n", current_x, y);
-                sum += (four_or_two * y);
-                
-                n++;
-                current_x += h;
             }
+            fprintf(output, "\n");
+        }
+        if (summary.not_finite > 0) {
+            fprintf(stderr, "warning: the expression is NaN or infinite for %ld of the %ld sets "
+                            "of values, whose integrals are left as NaN\n", summary.not_finite,
+                    set_count);
+        } else if (settings->non_finite == Non_Finite_Skip &&
+                   summary.nan_results + summary.inf_results > 0) {
+            fprintf(stderr, "warning: left out %ld NaN or infinite values\n",
+                    summary.nan_results + summary.inf_results);
+        }
+    }
+
+    if (settings->show_stats) {
+        stats_end(stats, arena);
+        stats_print_json(stats, stderr);
+    }
+}
+
+/*
+ * Function: run_job(line, line_length, arena, settings, surrogates, stats, output)
+ *
+ * Description: Runs one batch job (see run_batch()), and prints its result. With a program file
+ *              (--programs), the expression can be #n, for the nth expression in the file
+ *              (counting from 1), which is used as it is, without compiling anything. Several
+ *              expressions separated by ';' are integrated together; see run_fused_job(). An
+ *              expression followed by '|' and values for its parameters is integrated once for
+ *              each set of values; see run_sweep_job().
+ * Parameters: line, line_length - the job
+ *             arena - the arena to allocate from
+ *             settings - the settings from the commandline
+ *             surrogates - the surrogate cache, for --surrogate
+ *             stats - the job's statistics, already begun
+ *             output - where the result is printed
+ * Returns: none
+ */
+
+void run_job(const char *line, size_t line_length, struct Arena *arena,
+             const struct Settings *settings, struct Surrogate_Cache *surrogates,
+             struct Request_Stats *stats, FILE *output) {
+    char method[16];
+    double start, end;
+    long strips;
+    int header_length; // characters taken up by everything before the expression
+    struct Eval_Profile profile;
+
+    if (sscanf(line, "%15s %lf %lf %ld %n", method, &start, &end, &strips,
+               &header_length) < 4 || strips <= 0) {
+        fprintf(output, "error: expected '<method> <lower> <upper> <strips> <expression>'\n");
+        return;
+    }
+
+    struct Integration_Options options = {
+        .strips = strips,
+        .profile = settings->show_profile ? &profile : NULL,
+        .precision = settings->precision,
+        .tolerance = settings->tolerance,
+        .force_numeric = settings->force_numeric,
+        .non_finite = settings->non_finite,
+        .checkpoint = settings->checkpoint,
+        .interrupted = &interrupted
+    };
+    if (strcmp(method, "simpson") == 0) { options.method = Method_Simpson; }
+    else if (strcmp(method, "trapezium") == 0) { options.method = Method_Trapezium; }
+    else if (strcmp(method, "richardson") == 0) { options.method = Method_Richardson; }
+    else if (strcmp(method, "clenshaw-curtis") == 0) { options.method = Method_Clenshaw_Curtis; }
+    else {
+        fprintf(output, "error: unknown method '%s'\n", method);
+        return;
+    }
+
+    const char *expression = line + header_length;
+    size_t expression_length = line_length - header_length;
+    if (options.method == Method_Clenshaw_Curtis &&
+        (memchr(expression, '|', expression_length) != NULL ||
+         memchr(expression, ';', expression_length) != NULL)) {
+        fprintf(output, "error: clenshaw-curtis only integrates one expression at a time\n");
+        return;
+    }
+    if (memchr(expression, '|', expression_length) != NULL) {
+        run_sweep_job(expression, expression_length, start, end, &options, arena, settings,
+                      stats, output);
+        return;
+    }
+    if (memchr(expression, ';', expression_length) != NULL) {
+        run_fused_job(expression, expression_length, start, end, &options, arena, settings,
+                      stats, output);
+        return;
+    }
+
+    struct Program program;
+    stats_start(stats);
+    int rc = job_program(settings, expression, expression_length, 0, arena, &program, output);
+    stats_stop(stats, Stage_Compile);
+    stats->expression_length = expression_length;
+    stats->program_length = program.length;
+
+    if (rc < 0) {
+        // job_program() has already said what was wrong
+    } else if (rc == 0 || fabs(start-end) < 0.0000001) {
+        fprintf(output, "0\n");
+    } else {
+        struct Integration_Result result;
+        if (settings->show_profile) { profile_init(&profile); }
+        stats_start(stats);
+
+        // A profile needs the evaluations, and a surrogate's result depends on the jobs before
+        struct Result_Cache_Key key;
+        int use_results = settings->results != NULL && !settings->show_profile &&
+                          !settings->use_surrogate;
+        if (use_results) { result_cache_key(&key, &program, start, end, &options); }
+
+        if (use_results && result_cache_lookup(settings->results, &key, &result, &rc)) {
+            // Done before: nothing to evaluate
+        } else {
+            if (settings->use_surrogate) {
+                options.surrogate = cached_surrogate(surrogates, line + header_length,
+                                                     line_length - header_length, &program,
+                                                     start, end, settings->surrogate_tolerance,
+                                                     arena);
+            }
+            options.kernel = kernel_cache_get(settings->kernels, &program, start, end, arena);
+            integrating = 1;
+            rc = integrate(&program, start, end, &options, &result, arena);
+            integrating = 0;
+            if (use_results && rc != Integration_Interrupted && rc != Integration_Out_Of_Memory) {
+                result_cache_store(settings->results, &key, &result, rc);
+            }
+        }
+        stats_stop(stats, Stage_Integrate);
+        stats_add_result(stats, &result);
+        if (rc == Integration_Interrupted) {
+            fprintf(output, "error: interrupted\n");
+        } else if (rc == Integration_Not_Finite) {
+            fprintf(output, "error: the expression is NaN or infinite between x = %g and x = %g\n",
+                    result.bad_start, result.bad_end);
+        } else if (options.method == Method_Richardson ||
+                   options.method == Method_Clenshaw_Curtis) {
+            fprintf(output, "%.15g %.3g\n", result.value, result.error_estimate);
+        } else {
+            fprintf(output, "%.15g\n", result.value);
+        }
+        if (settings->non_finite == Non_Finite_Skip && !isnan(result.bad_start)) {
+            fprintf(stderr, "warning: left out %ld NaN or infinite values between x = %g and "
+                            "x = %g\n", result.nan_results + result.inf_results,
+                    result.bad_start, result.bad_end);
+        }
+        if (result.resumed_from > 0) {
+            fprintf(stderr, "note: carried on from a checkpoint at point %ld of %ld\n",
+                    result.resumed_from, options.strips);
+        }
+        if (settings->show_profile) { profile_print(&profile, stderr); }
+    }
+
+    if (settings->show_stats) {
+        stats_end(stats, arena);
+        stats_print_json(stats, stderr);
+    }
+}
+
+/*
+ * Function: run_batch_workers(input, arena, settings)
+ *
+ * Description: Runs batch jobs (see run_batch()) in settings->workers worker processes at once,
+ *              so that they use every core, and a job that crashes only loses its own result
+ *              (its line says so) rather than the whole batch; see workers.h. All the jobs are
+ *              read first, and the results are printed once they have all finished, in the same
+ *              order as the jobs.
+ * Parameters: input - the file to read jobs from
+ *             arena - the arena to allocate from, which each worker resets before each job
+ *             settings - the settings from the commandline
+ * Returns: Exit code - EXIT_FAILURE if there wasn't enough memory or the jobs were interrupted,
+ *          EXIT_SUCCESS otherwise
+ */
+
+int run_batch_workers(FILE *input, struct Arena *arena, const struct Settings *settings) {
+    // The jobs are kept in an arena of their own, which the workers inherit
+    struct Arena lines;
+    if (arena_init(&lines, REQUEST_ARENA_SIZE) != 0) {
+        fprintf(stderr, "Unable to allocate memory for the batch\n");
+        return EXIT_FAILURE;
+    }
+
+    long job_count = 0;
+    long capacity = 0;
+    char **texts = NULL;
+    size_t *lengths = NULL;
+    size_t line_length;
+    char *line;
+    while ((line = read_line(input, &line_length, &lines)) != NULL) {
+        if (line_length == 0 || line[0] == '#') { continue; } // blank/comment
+        if (job_count == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            char **new_texts = realloc(texts, capacity * sizeof(char *));
+            size_t *new_lengths = realloc(lengths, capacity * sizeof(size_t));
+            if (new_texts != NULL) { texts = new_texts; }
+            if (new_lengths != NULL) { lengths = new_lengths; }
+            if (new_texts == NULL || new_lengths == NULL) { job_count = -1; break; }
+        }
+        texts[job_count] = line;
+        lengths[job_count] = line_length;
+        job_count++;
+    }
+
+    struct Job_Pool *pool = (job_count > 0) ? job_pool_create(job_count) : NULL;
+    if (job_count < 0 || (job_count > 0 && pool == NULL)) {
+        fprintf(stderr, "Unable to allocate memory for the batch\n");
+        free(texts);
+        free(lengths);
+        arena_free(&lines);
+        return EXIT_FAILURE;
+    }
+
+    for (long i = 0; i < job_count; i++) {
+        pool->jobs[i].line = texts[i];
+        pool->jobs[i].length = lengths[i];
+    }
+    free(texts);
+    free(lengths);
+
+    struct Batch_Worker worker = { .arena = arena, .settings = settings };
+    int exit_code = EXIT_SUCCESS;
+    if (pool != NULL) {
+        // Signals only set interrupted from here on, in here and in the workers, so that the jobs
+        // that are running can finish (or stop) and still have their results printed
+        working = 1;
+        if (job_pool_run(pool, settings->workers, run_worker_job, &worker, &interrupted) != 0) {
+            fprintf(stderr, "warning: couldn't start any worker processes, so the jobs were run "
+                            "one at a time\n");
+        }
+        working = 0;
+
+        for (long i = 0; i < job_count; i++) {
+            if (atomic_load(&pool->jobs[i].state) == Job_Done) {
+                fputs(pool->jobs[i].output, stdout);
+            } else {
+                printf("error: interrupted\n");
+            }
+        }
+        if (interrupted) { exit_code = EXIT_FAILURE; }
+    }
+
+    free_surrogate_cache(&worker.surrogates); // only used if the jobs ran in this process
+    job_pool_free(pool);
+    arena_free(&lines);
+    return exit_code;
+}
+
+/*
+ * Function: run_worker_job(line, length, output, context)
+ *
+ * Description: Runs one batch job in a worker process (a Job_Function; see workers.h)
+ * Parameters: line, length - the job
+ *             output - where the result is printed
+ *             context - the worker's struct Batch_Worker
+ * Returns: none
+ */
+
+void run_worker_job(const char *line, size_t length, FILE *output, void *context) {
+    struct Batch_Worker *worker = context;
+    struct Request_Stats stats;
+
+    arena_reset(worker->arena);
+    stats_begin(&stats, worker->settings->show_stats, &worker->settings->perf, worker->arena);
+    run_job(line, length, worker->arena, worker->settings, &worker->surrogates, &stats, output);
+}
+
+/*
+ * Function: save_programs(input_path, output_path, arena)
+ *
+ * Description: Compiles expressions, one per line of the input (blank lines and lines starting
+ *              with '#' are skipped), and saves them to a program file, so that batch jobs can use
+ *              them with --programs without compiling them again. The nth expression in the
+ *              input is #n in batch jobs. Nothing is saved if any expression can't be compiled.
+ * Parameters: input_path - the file to read expressions from, or '-' for stdin
+ *             output_path - the program file to write
+ *             arena - the arena to compile into, which is reset when done
+ * Returns: Exit code - EXIT_FAILURE if the file couldn't be read or written, or any expression
+ *          couldn't be compiled, EXIT_SUCCESS otherwise
+ */
+
+int save_programs(const char *input_path, const char *output_path, struct Arena *arena) {
+    FILE *input = (strcmp(input_path, "-") == 0) ? stdin : fopen(input_path, "r");
+    if (input == NULL) {
+        fprintf(stderr, "Could not open batch file '%s'\n", input_path);
+        return EXIT_FAILURE;
+    }
 
-            // Finish by multiplying by dx/3
-            sum *= h / 3;
-        } 
+    long count = 0;
+    long capacity = 0;
+    long line_number = 0;
+    int failed = 0;
+    struct Program *programs = NULL;
+    const char **texts = NULL;
+    size_t *lengths = NULL;
+    size_t length;
+    char *line;
 
-        // --- Trapezium rule ---
-        else if (choice == 2) {
-            sum += evaluate_rpn(rpn_exp, rc, start);
-            sum += evaluate_rpn(rpn_exp, rc, end);
+    // Everything stays in the arena until the file is written
+    arena_reset(arena);
+    while (!failed && (line = read_line(input, &length, arena)) != NULL) {
+        line_number++;
+        if (length == 0 || line[0] == '#') { continue; } // blank/comment
 
-            while (current_x <= end) {
-                y = evaluate_rpn(rpn_exp, rc, current_x);
-                sum += 2*y;
-                current_x += h;
+        if (count >= 0 && count == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            struct Program *new_programs = realloc(programs, capacity * sizeof(struct Program));
+            const char **new_texts = realloc(texts, capacity * sizeof(char *));
+            size_t *new_lengths = realloc(lengths, capacity * sizeof(size_t));
+            if (new_programs != NULL) { programs = new_programs; }
+            if (new_texts != NULL) { texts = new_texts; }
+            if (new_lengths != NULL) { lengths = new_lengths; }
+            if (new_programs == NULL || new_texts == NULL || new_lengths == NULL) {
+                fprintf(stderr, "Unable to allocate memory for the programs\n");
+                failed = 1;
+                break;
             }
+        }
+
+        struct Program program;
+        int rc = compile_expression(line, length, arena, &program);
+        if (rc < 0) {
+            fprintf(stderr, "error: line %ld: could not understand the expression: %s\n",
+                    line_number, parse_error_message(rc));
+            failed = (rc == Parse_Out_Of_Memory);
+            count = -1; // keep checking the rest, but don't save anything
+        }
+        if (count >= 0) {
+            programs[count] = program;
+            texts[count] = line;
+            lengths[count] = length;
+            count++;
+        }
+    }
+    if (input != stdin) { fclose(input); }
 
-            sum *= h / 2;
+    int exit_code = EXIT_FAILURE;
+    if (!failed && count >= 0) {
+        int error = program_file_write(output_path, programs, texts, lengths, count);
+        if (error != 0) {
+            fprintf(stderr, "Could not write program file '%s': %s\n", output_path,
+                    program_file_error_message(error));
+        } else {
+            fprintf(stderr, "Saved %ld expressions to '%s'\n", count, output_path);
+            exit_code = EXIT_SUCCESS;
         }
+    }
+
+    free(programs);
+    free(texts);
+    free(lengths);
+    arena_reset(arena);
+    return exit_code;
+}
+
+/*
+ * Function: cached_surrogate(cache, expression, length, program, start, end, tolerance, arena)
+ *
+ * Description: Gets a surrogate for integrating an expression between two limits, fitting one if
+ *              the cache doesn't have one that will do. The same expression over limits inside
+ *              those already fitted costs nothing; limits outside them are refitted over both
+ *              ranges together, so that the next request with either is free again.
+ * Parameters: cache - the surrogate cache
+ *             expression, length - the expression's text, to tell whether it has changed
+ *             program - the compiled expression
+ *             start, end - the limits of integration
+ *             tolerance - the tolerance to fit to, or 0 for the default
+ *             arena - arena for the evaluator's working memory
+ * Returns: The surrogate, or NULL if the expression couldn't be fitted (e.g. it is infinite
+ *          somewhere in the range), in which case it should be integrated as normal
+ */
 
-        printf("\nIntegration result: %f\n\n", sum);
+const struct Chebyshev_Surrogate *cached_surrogate(struct Surrogate_Cache *cache,
+                                                   const char *expression, size_t length,
+                                                   const struct Program *program, double start,
+                                                   double end, double tolerance,
+                                                   struct Arena *arena) {
+    int same = cache->expression != NULL && cache->length == length &&
+               memcmp(cache->expression, expression, length) == 0;
+
+    double low = fmin(start, end);
+    double high = fmax(start, end);
+    if (same && low >= cache->surrogate.start && high <= cache->surrogate.end) {
+        // A fit that failed is remembered too (as one with no coefficients), so that the same
+        // request doesn't try again every time
+        return (cache->surrogate.cumulative != NULL) ? &cache->surrogate : NULL;
+    }
+    if (same && cache->surrogate.cumulative != NULL) {
+        low = fmin(low, cache->surrogate.start);
+        high = fmax(high, cache->surrogate.end);
+    }
 
+    free_surrogate_cache(cache);
+    cache->expression = malloc(length);
+    if (cache->expression == NULL) { return NULL; }
+    memcpy(cache->expression, expression, length);
+    cache->length = length;
 
-        // Avoid memory leaks, they aren't nice
-        free(tokenized_exp);
-        free(rpn_exp);
+    if (chebyshev_fit(program, low, high, tolerance, &cache->surrogate, arena) != 0) {
+        chebyshev_free(&cache->surrogate);
+        return NULL;
     }
+    return &cache->surrogate;
+}
+
+/*
+ * Function: free_surrogate_cache(cache)
+ *
+ * Description: Empties the surrogate cache
+ * Parameters: cache - the cache
+ * Returns: none
+ */
+
+void free_surrogate_cache(struct Surrogate_Cache *cache) {
+    if (cache->expression != NULL) { chebyshev_free(&cache->surrogate); }
+    free(cache->expression);
+    cache->expression = NULL;
+    cache->length = 0;
 }
 
 // ------ User input functions ------
@@ -250,25 +1496,30 @@ A few points to note:\n\n\
  *
  * Description: Displays a list of choices to the user
  * Parameters: none
- * Returns: Integer representing choice selected. Guaranteed to be either 1 or 2
+ * Returns: Integer representing choice selected. Guaranteed to be from 1 to 6 (6, exit, if stdin
+ *          has closed)
  */
 
 int menu() {
     printf("Please select from the following options:\n\
     \t1. Compute integration estimate by Simpson's rule\n\
     \t2. Compute integration estimate by trapezium rule\n\
-    \t3. Show help message\n\
-    \t4. Exit\n");
+    \t3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate\n\
+    \t   with an error estimate from those (Richardson extrapolation)\n\
+    \t4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate\n\
+    \t5. Show help message\n\
+    \t6. Exit\n");
 
     char input;
 
     // Loop until valid input received
     while (1) {
-        input = getchar();
-        input -= 48; // 48 is the character 0 in ASCII; by subtracting this offset, input is an
+        int c = getchar();
+        if (c == EOF) { return 6; }
+        input = c - 48; // 48 is the character 0 in ASCII; by subtracting this offset, input is an
                      // integer corresponding to the chosen option's number
 
-        if (input >= 1 && input <= 4) { // valid range of choices
+        if (input >= 1 && input <= 6) { // valid range of choices
             return input;
         } else {
             printf("You have selected an invalid option. Please try again.\n");
@@ -277,6 +1528,92 @@ int menu() {
     }
 }
 
+/*
+ * Function: read_line(stream, length, arena)
+ *
+ * Description: Reads one line of any length from a stream. The buffer starts small and doubles
+ *              whenever it fills, so reading is linear in the length of the line.
+ * Parameters: stream - the stream to read from
+ *             length - where the number of characters read (excluding the newline) is written
+ *             arena - the arena to allocate the buffer from
+ * Returns: Null-terminated buffer holding the line without its newline. NULL if the stream was
+ *          already at its end (or memory ran out).
+ */
+
+char *read_line(FILE *stream, size_t *length, struct Arena *arena) {
+    size_t capacity = 64;
+    size_t used = 0;
+    char *buffer = arena_alloc(arena, capacity);
+    if (buffer == NULL) { return NULL; }
+
+    while (fgets(buffer + used, (int)(capacity - used), stream) != NULL) {
+        used += strlen(buffer + used);
+
+        if (used > 0 && buffer[used-1] == '\n') { break; } // got the whole line
+
+        // Buffer filled before the line ended, so make it bigger and keep reading
+        // (the old buffer is left in the arena, but the doubling means that at most the same
+        // amount again is wasted)
+        if (used == capacity - 1) {
+            char *bigger = arena_alloc(arena, capacity * 2);
+            if (bigger == NULL) { return NULL; }
+            memcpy(bigger, buffer, used);
+            buffer = bigger;
+            capacity *= 2;
+        }
+    }
+
+    if (used == 0 && feof(stream)) { return NULL; }
+
+    // get rid of the newline (and carriage return, for files written on Windows)
+    while (used > 0 && (buffer[used-1] == '\n' || buffer[used-1] == '\r')) { used--; }
+    buffer[used] = '\0';
+
+    *length = used;
+    return buffer;
+}
+
+/*
+ * Function: read_file(path, length, arena)
+ *
+ * Description: Reads the whole of a file into memory, e.g. for an expression that is too long to
+ *              type in
+ * Parameters: path - the file to read
+ *             length - where the number of characters read is written
+ *             arena - the arena to allocate the buffer from
+ * Returns: Null-terminated buffer holding the file's contents (with trailing newlines removed).
+ *          NULL if the file couldn't be read.
+ */
+
+char *read_file(const char *path, size_t *length, struct Arena *arena) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) { return NULL; }
+
+    size_t capacity = 4096;
+    size_t used = 0;
+    char *buffer = arena_alloc(arena, capacity);
+
+    while (buffer != NULL) {
+        used += fread(buffer + used, 1, capacity - used - 1, file);
+        if (used < capacity - 1) { break; } // short read: end of file (or an error)
+
+        char *bigger = arena_alloc(arena, capacity * 2);
+        if (bigger != NULL) { memcpy(bigger, buffer, used); }
+        buffer = bigger;
+        capacity *= 2;
+    }
+
+    int failed = (buffer == NULL || ferror(file));
+    fclose(file);
+    if (failed) { return NULL; }
+
+    while (used > 0 && (buffer[used-1] == '\n' || buffer[used-1] == '\r')) { used--; }
+    buffer[used] = '\0';
+
+    *length = used;
+    return buffer;
+}
+
 /*
  * Function: get_double_input(prompt)
  * 
@@ -289,15 +1626,17 @@ int menu() {
  */
 
 double get_double_input(const char* prompt) {
-    char buffer[255]; // Holder for string input
+    char buffer[INPUT_BUFFER_SIZE]; // Holder for string input
     char *n_end; // Pointer given to strtod which signifies the end of valid numerical input
     double output;
 
     // Loop until satisfactory input is received, at which point function returns said input
     while (1) {
         printf(prompt);
-        fgets(buffer, 256, stdin); // Assign stdin stream data to buffer; 256 not 255 because \n is
-                                   // counted when the user presses Enter
+        // Assign stdin stream data to buffer (sizeof includes room for the \0 fgets adds)
+        if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
+            exit(EXIT_SUCCESS); // stdin closed, so there's nothing left to do
+        }
         output = strtod(buffer, &n_end);
         
         if (n_end == buffer) { // If no numerical input was found
@@ -310,27 +1649,28 @@ double get_double_input(const char* prompt) {
 }
 
 /*
- * Function: get_double_input(prompt)
+ * Function: get_long_input(prompt)
  * 
  * Description: Displays a prompt to the user (as passed to the function) and interprets input as a 
- *              double type - with some error checking
+ *              long type (so that strip counts past 2^31 can be given) - with some error checking
  * Parameters: prompt - a character array (string) prompt which is given to printf() 
  *             to be shown to the user to inform their choice
- * Returns: double corresponding to interpretation (strtod). Will not return 0 unless the user 
- *          actually entered 0; invalid input is handled
+ * Returns: long corresponding to interpretation (strtol). Never 0; invalid input is handled
  */
 
-int get_int_input(const char* prompt) {
-    char buffer[255]; // Holder for string input
+long get_long_input(const char* prompt) {
+    char buffer[INPUT_BUFFER_SIZE]; // Holder for string input
     char *n_end; // Pointer given to strtod which signifies the end of valid numerical input
-    int output;
+    long output;
 
     // Loop until satisfactory input is received, at which point function returns said input
     while (1) {
         printf(prompt);
-        fgets(buffer, 256, stdin); // Assign stdin stream data to buffer; 256 not 255 because \n is
-                                   // counted when the user presses Enter
-        output = (int)strtol(buffer, &n_end, 10); // base10
+        // Assign stdin stream data to buffer (sizeof includes room for the \0 fgets adds)
+        if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
+            exit(EXIT_SUCCESS); // stdin closed, so there's nothing left to do
+        }
+        output = strtol(buffer, &n_end, 10); // base10
         
         if (n_end == buffer || output == 0) { // If no numerical input was found
             printf("Please enter a valid number.\n");
@@ -347,8 +1687,11 @@ int get_int_input(const char* prompt) {
  * Please select from the following options:
  *     	1. Compute integration estimate by Simpson's rule
  *     	2. Compute integration estimate by trapezium rule
- *     	3. Show help message
- *     	4. Exit
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
  * 1
  * 
  * Please enter an expression to perform integration of: 4(sin(x))^2 + 2
@@ -357,15 +1700,18 @@ int get_int_input(const char* prompt) {
  * Please enter the upper limit of integration: 6
  * Please enter the number of strips to use: 100
  * 
- * Integration result: 9.556762 [analytical result: 9.52593116462]
+ * Integration result: 9.525931 [analytical result: 9.52593116462]
  * 
  * ------------------------------------------------------------------------------------------------
  *
  * Please select from the following options:
  *     	1. Compute integration estimate by Simpson's rule
  *     	2. Compute integration estimate by trapezium rule
- *     	3. Show help message
- *     	4. Exit
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
  * 2
  * 
  * Please enter an expression to perform integration of: 4x^2 - 24x + 4.2
@@ -374,15 +1720,19 @@ int get_int_input(const char* prompt) {
  * Please enter the upper limit of integration: 4
  * Please enter the number of strips to use: 100
  * 
- * Integration result: -22.785600 [analytical result: -22.8]
+ * Integration result: -22.800000 [analytical result: -22.8]
+ * (exact, as the expression is a polynomial)
  * 
  * ------------------------------------------------------------------------------------------------
  *
  * Please select from the following options:
  *     	1. Compute integration estimate by Simpson's rule
  *     	2. Compute integration estimate by trapezium rule
- *     	3. Show help message
- *     	4. Exit
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
  * 1
  * 
  * Please enter an expression to perform integration of: x
@@ -391,19 +1741,26 @@ int get_int_input(const char* prompt) {
  * Please enter the upper limit of integration: 100
  * Please enter the number of strips to use: 100
  * 
- * Integration result: 5066.666667 [analytical result: 5000]
+ * Integration result: 5000.000000 [analytical result: 5000]
+ * (exact, as the expression is a polynomial)
  * 
  * Please select from the following options:
  *     	1. Compute integration estimate by Simpson's rule
  *     	2. Compute integration estimate by trapezium rule
- *     	3. Show help message
- *     	4. Exit
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
  * 
  * Please select from the following options:
  *     	1. Compute integration estimate by Simpson's rule
  *     	2. Compute integration estimate by trapezium rule
- *     	3. Show help message
- *     	4. Exit
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
  * 1
  * 
  * Please enter an expression to perform integration of: 4ln(x) + exp(2x)
@@ -412,8 +1769,58 @@ int get_int_input(const char* prompt) {
  * Please enter the upper limit of integration: 10
  * Please enter the number of strips to use: 100
  * 
- * Integration result: 261988040.308490 [analytical result 242581153.149, in terms of % error still
- *                                       not bad, absolute error is a bit high though]
+ * Integration result: 242581432.123691 [analytical result 242581153.149, about 1 part in a million
+ *                                       off; see accuracy.c for how that improves with strips]
+ * 
+ * ------------------------------------------------------------------------------------------------
+ *
+ * Please select from the following options:
+ *     	1. Compute integration estimate by Simpson's rule
+ *     	2. Compute integration estimate by trapezium rule
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
+ * 3
+ * 
+ * Please enter an expression to perform integration of: 4ln(x) + exp(2x)
+ * 
+ * Please enter the lower limit of integration: 4
+ * Please enter the upper limit of integration: 10
+ * Please enter the number of strips to use: 100
+ * 
+ * Integration result: 242581154.670079 (+/- 2.8e+02)
+ * 	Trapezium rule: 242872180.637672
+ * 	Midpoint rule (half as many strips): 241999935.095729
+ * 	Simpson's rule: 242581432.123691
+ * 	Richardson extrapolation of those: 242581154.670079
+ * (101 evaluations)
+ * [analytical result 242581153.149: from the same 101 evaluations as Simpson's rule above, and the
+ *  error is within the estimate]
+ * 
+ * ------------------------------------------------------------------------------------------------
+ *
+ * Please select from the following options:
+ *     	1. Compute integration estimate by Simpson's rule
+ *     	2. Compute integration estimate by trapezium rule
+ *     	3. Compute the trapezium, midpoint and Simpson's rules at once, and a better estimate
+ *     	   with an error estimate from those (Richardson extrapolation)
+ *     	4. Compute integration estimate by Clenshaw-Curtis quadrature, with an error estimate
+ *     	5. Show help message
+ *     	6. Exit
+ * 4
+ * 
+ * Please enter an expression to perform integration of: 4ln(x) + exp(2x)
+ * 
+ * Please enter the lower limit of integration: 4
+ * Please enter the upper limit of integration: 10
+ * Please enter the most strips to use (rounded up to a power of two): 100
+ * 
+ * Integration result: 242581153.148596 (+/- 3.0e-03)
+ * (33 evaluations, at Chebyshev points)
+ * [analytical result 242581153.149: converged after doubling from 17 points to 33, well short of
+ *  the 128 strips it was allowed]
  * 
  * 
  */
\ No newline at end of file
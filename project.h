@@ -1,9 +1,84 @@
 #ifndef MAIN_H_INCLUDED
 #define MAIN_H_INCLUDED // Include guards
 
+#include <stdio.h> // FILE
+#include "arena.h"
+#include "token.h"
+#include "parser.h"
+#include "perf.h"
+#include "integrate.h"
+#include "stats.h"
+#include "program_file.h"
+#include "result_cache.h"
+
+// --- Type declarations ---
+
+// Settings from the commandline that apply to every request
+struct Settings {
+    int show_stats; // --stats or --perf
+    int show_profile; // --profile
+    struct Perf_Counters perf; // Opened if --perf was given
+    enum Integration_Precision precision; // --float
+    double tolerance; // --float's tolerance, or 0 for the default
+    int use_surrogate; // --surrogate
+    double surrogate_tolerance; // --surrogate's tolerance, or 0 for the default
+    int force_numeric; // --numeric
+    enum Non_Finite_Policy non_finite; // --non-finite
+    struct Checkpoint_Writer *checkpoint; // Opened if --checkpoint was given, otherwise NULL
+    int workers; // --workers, or 0 to run batch jobs in this process
+    const struct Program_File *programs; // Opened if --programs was given, otherwise NULL
+    int threads; // --threads, or 0 to run sweeps in one thread per processor
+    struct Kernel_Cache *kernels; // Opened if --aot was given, otherwise NULL
+    struct Result_Cache *results; // Opened if --cache was given, otherwise NULL
+};
+
+// The surrogate fitted for the last expression integrated with --surrogate, kept for the requests
+// after it. The expression is copied, since requests' memory is reset between them.
+struct Surrogate_Cache {
+    char *expression; // NULL if nothing has been fitted
+    size_t length;
+    struct Chebyshev_Surrogate surrogate;
+};
+
+// What a worker process needs to run batch jobs (see run_worker_job()). Each worker has its own
+// copy, made when it is forked.
+struct Batch_Worker {
+    struct Arena *arena;
+    const struct Settings *settings;
+    struct Surrogate_Cache surrogates;
+};
+
+// --- Function declarations ---
+
 int menu();
+char *read_line(FILE *stream, size_t *length, struct Arena *arena);
+char *read_file(const char *path, size_t *length, struct Arena *arena);
 double get_double_input(const char *prompt);
-int get_int_input(const char *prompt);
-int main();
+long get_long_input(const char *prompt);
+const struct Chebyshev_Surrogate *cached_surrogate(struct Surrogate_Cache *cache,
+                                                   const char *expression, size_t length,
+                                                   const struct Program *program, double start,
+                                                   double end, double tolerance,
+                                                   struct Arena *arena);
+void free_surrogate_cache(struct Surrogate_Cache *cache);
+void handle_signal(int signal_number);
+int run_batch(const char *path, struct Arena *arena, const struct Settings *settings);
+int job_program(const struct Settings *settings, const char *expression, size_t length,
+                int number, struct Arena *arena, struct Program *program, FILE *output);
+void run_fused_job(const char *expressions, size_t length, double start, double end,
+                   const struct Integration_Options *options, struct Arena *arena,
+                   const struct Settings *settings, struct Request_Stats *stats, FILE *output);
+int parse_sweep(const char *text, size_t length, struct Arena *arena, const char **names,
+                int *name_count, double **parameters, long *set_count, FILE *output);
+void run_sweep_job(const char *text, size_t length, double start, double end,
+                   const struct Integration_Options *options, struct Arena *arena,
+                   const struct Settings *settings, struct Request_Stats *stats, FILE *output);
+void run_job(const char *line, size_t line_length, struct Arena *arena,
+             const struct Settings *settings, struct Surrogate_Cache *surrogates,
+             struct Request_Stats *stats, FILE *output);
+int run_batch_workers(FILE *input, struct Arena *arena, const struct Settings *settings);
+int save_programs(const char *input_path, const char *output_path, struct Arena *arena);
+void run_worker_job(const char *line, size_t length, FILE *output, void *context);
+int main(int argc, char *argv[]);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "result_cache.h"
+
+// Attempts at writing a slot before giving up, if other processes keep taking them first
+#define STORE_ATTEMPTS 4
+
+// ------ Result cache definitions ------
+
+/*
+ * Function: slot_count_for(size)
+ *
+ * Description: Works out how many slots fit in a file of about the given size
+ * Parameters: size - the size asked for, in bytes
+ * Returns: The largest power of two of slots that fits (at least RESULT_CACHE_PROBES)
+ */
+
+static uint64_t slot_count_for(size_t size) {
+    uint64_t count = RESULT_CACHE_PROBES;
+    while (sizeof(struct Result_Cache_Header) + 2 * count * sizeof(struct Result_Cache_Slot) <=
+           size) {
+        count *= 2;
+    }
+    return count;
+}
+
+/*
+ * Function: result_cache_open(path, size, cache)
+ *
+ * Description: Opens a result cache file, creating it if it doesn't exist (or is empty). Several
+ *              processes can open the same file at once; a file lock makes sure only one of them
+ *              creates it.
+ * Parameters: path - the file
+ *             size - about how big to make the file, in bytes, if it is created now (0 for
+ *                    RESULT_CACHE_DEFAULT_SIZE); an existing file keeps its size
+ *             cache - where the open cache is written
+ * Returns: 0 on success, or a (negative) enum Result_Cache_Error
+ */
+
+int result_cache_open(const char *path, size_t size, struct Result_Cache *cache) {
+    int descriptor = open(path, O_RDWR | O_CREAT, 0644);
+    if (descriptor < 0) { return Result_Cache_Unreadable; }
+
+    if (flock(descriptor, LOCK_EX) != 0) {
+        close(descriptor);
+        return Result_Cache_Unreadable;
+    }
+
+    int error = 0;
+    struct stat status;
+    struct Result_Cache_Header header = { 0 };
+    if (fstat(descriptor, &status) != 0) {
+        error = Result_Cache_Unreadable;
+    } else if (status.st_size > 0 &&
+               pread(descriptor, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        error = Result_Cache_Invalid;
+    } else if (header.magic == 0) {
+        // New (or a process creating it stopped before writing the header): size it, and write
+        // the header. The slots start out zeroed, which is empty.
+        uint64_t slot_count = slot_count_for((size > 0) ? size : RESULT_CACHE_DEFAULT_SIZE);
+        header = (struct Result_Cache_Header){
+            .magic = RESULT_CACHE_MAGIC,
+            .version = RESULT_CACHE_VERSION,
+            .byte_order = RESULT_CACHE_BYTE_ORDER,
+            .slot_size = sizeof(struct Result_Cache_Slot),
+            .slot_count = slot_count,
+            .file_size = sizeof(struct Result_Cache_Header) +
+                         slot_count * sizeof(struct Result_Cache_Slot)
+        };
+        if (ftruncate(descriptor, 0) != 0 || ftruncate(descriptor, header.file_size) != 0 ||
+            pwrite(descriptor, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            error = Result_Cache_Unreadable;
+        }
+    } else {
+        int valid = header.magic == RESULT_CACHE_MAGIC && header.version == RESULT_CACHE_VERSION &&
+                    header.byte_order == RESULT_CACHE_BYTE_ORDER &&
+                    header.slot_size == sizeof(struct Result_Cache_Slot) &&
+                    header.slot_count >= RESULT_CACHE_PROBES &&
+                    (header.slot_count & (header.slot_count - 1)) == 0 &&
+                    header.file_size == (uint64_t)status.st_size &&
+                    header.slot_count <= (header.file_size - sizeof(header)) /
+                                         sizeof(struct Result_Cache_Slot);
+        if (!valid) { error = Result_Cache_Invalid; }
+    }
+
+    flock(descriptor, LOCK_UN);
+    if (error != 0) {
+        close(descriptor);
+        return error;
+    }
+
+    size_t file_size = sizeof(struct Result_Cache_Header) +
+                       header.slot_count * sizeof(struct Result_Cache_Slot);
+    void *memory = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor); // the mapping keeps the file open
+    if (memory == MAP_FAILED) { return Result_Cache_Unreadable; }
+
+    cache->memory = memory;
+    cache->size = file_size;
+    cache->header = memory;
+    cache->slots = (struct Result_Cache_Slot *)(cache->header + 1);
+    cache->mask = header.slot_count - 1;
+    return 0;
+}
+
+/*
+ * Function: result_cache_key(key, program, start, end, options)
+ *
+ * Description: Makes the key a job's result is kept under
+ * Parameters: key - where the key is written
+ *             program - the compiled expression
+ *             start, end - the limits of integration
+ *             options - how it is integrated
+ * Returns: none
+ */
+
+void result_cache_key(struct Result_Cache_Key *key, const struct Program *program, double start,
+                      double end, const struct Integration_Options *options) {
+    memset(key, 0, sizeof(*key));
+    key->program_hash = program_hash(program);
+    key->start = start;
+    key->end = end;
+    key->strips = options->strips;
+    key->method = options->method;
+    key->precision = options->precision;
+    // The tolerance only matters in single precision (which Clenshaw-Curtis quadrature doesn't
+    // use, having one of its own), and is 0 for the default
+    if (options->method == Method_Clenshaw_Curtis) {
+        key->tolerance = options->coefficient_tolerance;
+    } else if (options->precision == Precision_Float) {
+        key->tolerance = options->tolerance;
+    }
+    key->force_numeric = options->force_numeric;
+    key->non_finite = options->non_finite;
+}
+
+/*
+ * Function: key_hash(key)
+ *
+ * Description: Hashes a key's bytes (64-bit FNV-1a, then mixed, since the low bits pick the
+ *              slot)
+ * Parameters: key - the key
+ * Returns: The hash, which is never 0
+ */
+
+static uint64_t key_hash(const struct Result_Cache_Key *key) {
+    const unsigned char *bytes = (const unsigned char *)key;
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < sizeof(*key); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211u;
+    }
+    hash ^= hash >> 32;
+    return (hash != 0) ? hash : 1;
+}
+
+/*
+ * Function: result_cache_lookup(cache, key, result, status)
+ *
+ * Description: Looks up a job's result. Nothing is locked: if a slot is being written at the
+ *              same time, it is just not found.
+ * Parameters: cache - the open result cache
+ *             key - the job's key, from result_cache_key()
+ *             result - where the result is written, if it is found (with no evaluations)
+ *             status - where what integrate() returned for it is written, if it is found
+ * Returns: 1 if the result was found, 0 if not
+ */
+
+int result_cache_lookup(struct Result_Cache *cache, const struct Result_Cache_Key *key,
+                        struct Integration_Result *result, int *status) {
+    uint64_t hash = key_hash(key);
+
+    for (int p = 0; p < RESULT_CACHE_PROBES; p++) {
+        struct Result_Cache_Slot *slot = &cache->slots[(hash + p) & cache->mask];
+
+        uint32_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (before % 2 != 0) { continue; } // being written
+        int used = slot->used;
+        uint64_t slot_hash = slot->hash;
+        struct Result_Cache_Key slot_key = slot->key;
+        struct Result_Cache_Value value = slot->value;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before) { continue; }
+
+        if (!used) { return 0; } // slots are never emptied, so the key isn't further on
+        if (slot_hash != hash || memcmp(&slot_key, key, sizeof(*key)) != 0) { continue; }
+
+        atomic_store_explicit(&slot->last_used, atomic_fetch_add(&cache->header->clock, 1),
+                              memory_order_relaxed);
+
+        result->value = value.value;
+        result->evaluations = 0;
+        result->nan_results = value.nan_results;
+        result->inf_results = value.inf_results;
+        result->precision = value.precision;
+        result->precision_loss = value.precision_loss;
+        result->from_surrogate = 0;
+        result->exact = value.exact;
+        result->bad_start = value.bad_start;
+        result->bad_end = value.bad_end;
+        result->trapezium = value.trapezium;
+        result->midpoint = value.midpoint;
+        result->simpson = value.simpson;
+        result->error_estimate = value.error_estimate;
+        result->resumed_from = 0;
+        *status = value.status;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Function: writer_died(slot)
+ *
+ * Description: Checks whether a slot that is being written was left half-written by a writer that
+ *              has since died. A slot whose writer hasn't recorded itself yet is taken as alive.
+ * Parameters: slot - the slot, whose sequence number is odd
+ * Returns: 1 if its writer is gone, 0 if not
+ */
+
+static int writer_died(struct Result_Cache_Slot *slot) {
+    pid_t writer = atomic_load_explicit(&slot->writer, memory_order_relaxed);
+    return writer != 0 && kill(writer, 0) != 0 && errno == ESRCH;
+}
+
+/*
+ * Function: result_cache_store(cache, key, result, status)
+ *
+ * Description: Keeps a job's result: in the slot already holding its key, or an empty one, or
+ *              else in place of whichever of its slots was used longest ago (a slot whose writer
+ *              died part way through counting as the oldest). If other processes keep writing
+ *              those slots at the same moment, it gives up rather than waiting.
+ * Parameters: cache - the open result cache
+ *             key - the job's key, from result_cache_key()
+ *             result - its result
+ *             status - what integrate() returned
+ * Returns: none
+ */
+
+void result_cache_store(struct Result_Cache *cache, const struct Result_Cache_Key *key,
+                        const struct Integration_Result *result, int status) {
+    uint64_t hash = key_hash(key);
+    struct Result_Cache_Value value = {
+        .value = result->value,
+        .error_estimate = result->error_estimate,
+        .trapezium = result->trapezium,
+        .midpoint = result->midpoint,
+        .simpson = result->simpson,
+        .bad_start = result->bad_start,
+        .bad_end = result->bad_end,
+        .precision_loss = result->precision_loss,
+        .nan_results = result->nan_results,
+        .inf_results = result->inf_results,
+        .status = status,
+        .exact = result->exact,
+        .precision = result->precision
+    };
+
+    for (int attempt = 0; attempt < STORE_ATTEMPTS; attempt++) {
+        // Choose a slot. What is read here may be changing under us, but if it is, the slot's
+        // sequence number will have moved on, and taking it below fails.
+        struct Result_Cache_Slot *victim = NULL;
+        uint32_t victim_sequence = 0;
+        uint64_t oldest = UINT64_MAX;
+        for (int p = 0; p < RESULT_CACHE_PROBES; p++) {
+            struct Result_Cache_Slot *slot = &cache->slots[(hash + p) & cache->mask];
+            uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            uint64_t last_used = 0;
+            if (sequence % 2 != 0) {
+                if (!writer_died(slot)) { continue; } // being written
+            } else if (!slot->used ||
+                       (slot->hash == hash && memcmp(&slot->key, key, sizeof(*key)) == 0)) {
+                victim = slot;
+                victim_sequence = sequence;
+                break;
+            } else {
+                last_used = atomic_load_explicit(&slot->last_used, memory_order_relaxed);
+            }
+            if (last_used < oldest) {
+                victim = slot;
+                victim_sequence = sequence;
+                oldest = last_used;
+            }
+        }
+        if (victim == NULL) { continue; }
+
+        // The next odd number: one on from an even one, or two on from a dead writer's
+        uint32_t taken = victim_sequence + 1 + victim_sequence % 2;
+        if (!atomic_compare_exchange_strong_explicit(&victim->sequence, &victim_sequence, taken,
+                                                     memory_order_acquire, memory_order_relaxed)) {
+            continue; // another writer took it first
+        }
+        atomic_store_explicit(&victim->writer, (int32_t)getpid(), memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        victim->hash = hash;
+        victim->key = *key;
+        victim->value = value;
+        victim->used = 1;
+        atomic_store_explicit(&victim->last_used, atomic_fetch_add(&cache->header->clock, 1),
+                              memory_order_relaxed);
+        atomic_store_explicit(&victim->writer, 0, memory_order_relaxed);
+        atomic_store_explicit(&victim->sequence, taken + 1, memory_order_release);
+        return;
+    }
+}
+
+/*
+ * Function: result_cache_close(cache)
+ *
+ * Description: Closes a result cache, unmapping it. Everything stored is already in the file.
+ * Parameters: cache - the open result cache
+ * Returns: none
+ */
+
+void result_cache_close(struct Result_Cache *cache) {
+    if (cache->memory != NULL) { munmap(cache->memory, cache->size); }
+    cache->memory = NULL;
+}
+
+/*
+ * Function: result_cache_error_message(error)
+ *
+ * Description: Describes a result cache error for the user
+ * Parameters: error - an enum Result_Cache_Error
+ * Returns: The description
+ */
+
+const char *result_cache_error_message(int error) {
+    switch (error) {
+        case Result_Cache_Unreadable:
+            return "the file couldn't be opened, created or mapped";
+        case Result_Cache_Invalid:
+            return "not a result cache, or one written by a different version of this program";
+        default:
+            return "unknown error";
+    }
+}
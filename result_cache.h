@@ -0,0 +1,118 @@
+#ifndef RESULT_CACHE_H_INCLUDED
+#define RESULT_CACHE_H_INCLUDED // Include guards
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <stdatomic.h>
+#include "parser.h" // struct Program
+#include "integrate.h" // struct Integration_Options, struct Integration_Result
+
+// ------ Result cache ------
+// Batch runs often integrate exactly the same thing as an earlier run did. The result cache keeps
+// every job's result in a file, keyed by what decides it (the compiled program's hash, the limits,
+// the method and strips, and the options that change the value), so a job that has been done
+// before is answered from the file without evaluating anything.
+//
+// The file is a fixed-size hash table, mapped into memory by every process using it: a header,
+// then a power of two of slots. A key's slot is found by open addressing, looking at up to
+// RESULT_CACHE_PROBES slots from the one its hash picks. When those are all full, the one used
+// longest ago is overwritten, so the file never grows past the size it was made with.
+//
+// Any number of processes (and threads) can read and write the table at once, with no locks.
+// Each slot has a sequence number (a seqlock), which is odd while the slot is being written:
+// a writer takes a slot by moving its number from even to odd with a compare-and-swap, so only one
+// can write it at a time, and moves it on to the next even number when it is done. A reader copies
+// the slot and checks the number didn't change while it did, so it never uses half of one write
+// and half of another. A file lock is only taken while the file is being created.
+//
+// A writer that dies part way through would leave its slot odd for good, so the writer's process
+// ID is kept in the slot while it writes, and a later writer that finds that process gone takes
+// the slot over (moving the number on to the next odd one, so only one can). This assumes every
+// process using the file is on the same machine.
+
+#define RESULT_CACHE_MAGIC 0x52504349u // "ICPR"
+#define RESULT_CACHE_VERSION 2
+#define RESULT_CACHE_BYTE_ORDER 0x01020304u // reads differently on a machine of the other order
+
+// Slots looked at for each key
+#define RESULT_CACHE_PROBES 16
+
+// Size of a new cache file if the user doesn't say, in bytes
+#define RESULT_CACHE_DEFAULT_SIZE (16 << 20)
+
+// --- Type declarations ---
+
+enum Result_Cache_Error {
+    Result_Cache_Unreadable = -1, // the file couldn't be opened, created or mapped
+    Result_Cache_Invalid = -2 // not a result cache, or one written by a different build
+};
+
+// Everything that decides a job's result. Doubles are compared bit for bit, and there is no
+// padding, so keys can be hashed and compared as bytes.
+struct Result_Cache_Key {
+    uint64_t program_hash; // program_hash() of the expression
+    double start, end;
+    int64_t strips;
+    double tolerance; // Integration_Options.tolerance (coefficient_tolerance for Clenshaw-Curtis)
+    uint32_t method, precision, force_numeric, non_finite; // The Integration_Options of the same
+};
+
+// What is kept of a result: everything but the counts of evaluations, which are 0 for a result
+// from the cache
+struct Result_Cache_Value {
+    double value;
+    double error_estimate;
+    double trapezium, midpoint, simpson;
+    double bad_start, bad_end;
+    double precision_loss;
+    int64_t nan_results, inf_results;
+    int32_t status; // enum Integration_Status returned by integrate()
+    int32_t exact;
+    int32_t precision; // The precision actually used
+    int32_t reserved;
+};
+
+struct Result_Cache_Slot {
+    _Atomic uint32_t sequence; // Odd while being written
+    uint32_t used; // 0 until the slot is first written
+    _Atomic int32_t writer; // Process ID of whoever is writing it, or 0
+    uint32_t reserved;
+    _Atomic uint64_t last_used; // The header's clock when it was last looked up or written
+    uint64_t hash; // Of the key
+    struct Result_Cache_Key key;
+    struct Result_Cache_Value value;
+};
+
+struct Result_Cache_Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order; // RESULT_CACHE_BYTE_ORDER
+    uint32_t slot_size; // sizeof(struct Result_Cache_Slot)
+    uint64_t slot_count; // A power of two
+    uint64_t file_size;
+    _Atomic uint64_t clock; // Goes up by one on every lookup that finds something, and every write
+    uint64_t reserved[3];
+};
+
+// An open result cache
+struct Result_Cache {
+    void *memory; // The mapping
+    size_t size;
+    struct Result_Cache_Header *header;
+    struct Result_Cache_Slot *slots;
+    uint64_t mask; // slot_count - 1
+};
+
+// --- Function declarations ---
+
+int result_cache_open(const char *path, size_t size, struct Result_Cache *cache);
+void result_cache_key(struct Result_Cache_Key *key, const struct Program *program, double start,
+                      double end, const struct Integration_Options *options);
+int result_cache_lookup(struct Result_Cache *cache, const struct Result_Cache_Key *key,
+                        struct Integration_Result *result, int *status);
+void result_cache_store(struct Result_Cache *cache, const struct Result_Cache_Key *key,
+                        const struct Integration_Result *result, int status);
+void result_cache_close(struct Result_Cache *cache);
+const char *result_cache_error_message(int error);
+
+#endif
@@ -5,280 +5,331 @@
 #include "shunting.h"
 #include "token.h"
 #include "stack.h"
+#include "functions.h"
 
+// ------ Shunting yard definitions ------
+// The algorithm is written as a state (struct Shunting_Yard) that tokens are pushed into one at a
+// time, rather than a loop over an array of tokens. That way the same code converts an array of
+// tokens (shunting_yard()) or tokens read straight from the expression by the lexer
+// (compile_expression() in parser.c) without needing the array.
 
-// Function: shunting_yard(input_tokenized, token_count, output_tokenized)
-// Description: Performs Dijkestra's shunting-yard algorithm on a tokenized infix expression to
-//              generate a tokenized RPN expression
-// Parameters: input_tokenized, a ptr to the start of an array where tokens are stored backwards
-//             token_count, an integer equal to the number of tokens in the array
-//             output_tokenized, a ptr to the start of an array where the output should be stored
-// Outputs: An integer corresponding to the number of tokens in the final expression (which is not
-//          equal to token_count, because parentheses are removed). This value is -1 if mismatched
-//          parentheses were detected. It will also return -2 if the program attempted to access
-//          the top of the operator stack when it was empty, i.e. if the expression contains an
-//          operator first.
-// Attributions: Adapted from pseudocode at 
+// Function: emit(state, token)
+// Description: Appends a token to the RPN output, and keeps track of how deep the evaluation stack
+//              would be at this point. That catches expressions with missing operands (like *4 or
+//              4+) here, once, so that evaluate_rpn() never has to check.
+// Parameters: state, the shunting-yard state
+//             token, the token to append
+// Outputs: 0 on success, Parse_Missing_Operand if the token doesn't have enough operands
+
+static int emit(struct Shunting_Yard *state, const struct Token *token) {
+    if (token->type == Number || token->type == Variable || token->type == Parameter) {
+        state->depth++;
+        if (state->depth > state->max_depth) { state->max_depth = state->depth; }
+    } else if (token->type == Function ||
+               (token->type == Operator && token->operator_type == Op_Negate)) {
+        if (state->depth < 1) { return Parse_Missing_Operand; }
+    } else { // binary operator: takes two values and leaves one
+        if (state->depth < 2) { return Parse_Missing_Operand; }
+        state->depth--;
+    }
+
+    state->output[state->output_count++] = *token;
+    return 0;
+}
+
+// Function: pop_to_output(state)
+// Description: Moves the top of the operator stack to the output
+// Parameters: state, the shunting-yard state
+// Outputs: 0 on success, Parse_Missing_Operand if the operator doesn't have enough operands
+
+static int pop_to_output(struct Shunting_Yard *state) {
+    struct Token top = token_stack_pop(&state->op_stack);
+    return emit(state, &top);
+}
+
+// Function: push_operator(state, token)
+// Description: Pushes a token onto the operator stack
+// Parameters: state, the shunting-yard state
+//             token, the token to push
+// Outputs: 0 on success, Parse_Out_Of_Memory if the stack was full and couldn't grow
+
+static int push_operator(struct Shunting_Yard *state, const struct Token *token) {
+    if (token_stack_push(&state->op_stack, *token) != STACK_OK) { return Parse_Out_Of_Memory; }
+    return 0;
+}
+
+// Function: shunting_init(state, arena, output)
+// Description: Prepares to convert an infix expression to RPN. The operator stack starts out
+//              inside the state, so for all but deeply nested expressions nothing is allocated.
+// Parameters: state, the shunting-yard state to initialize
+//             arena, the arena to grow the operator stack into if needed (NULL for the heap)
+//             output, a ptr to the start of an array where the RPN should be written, with room
+//             for as many tokens as will be pushed
+// Outputs: None
+
+void shunting_init(struct Shunting_Yard *state, struct Arena *arena, struct Token *output) {
+    token_stack_init(&state->op_stack, arena);
+    state->output = output;
+    state->output_count = 0;
+    state->depth = 0;
+    state->max_depth = 0;
+    state->error = 0;
+}
+
+// Function: shunting_push(state, token)
+// Description: Feeds the next token of the infix expression to Dijkstra's shunting-yard algorithm
+// Parameters: state, the shunting-yard state
+//             token, the token
+// Outputs: 0 on success, or a (negative) enum Parse_Error. Once an error has occurred, all further
+//          tokens are ignored and shunting_finish() returns the error.
+// Attributions: Adapted from pseudocode at
 //               https://en.wikipedia.org/wiki/Shunting-yard_algorithm#The_algorithm_in_detail
 
+int shunting_push(struct Shunting_Yard *state, const struct Token *token) {
+    if (state->error != 0) { return state->error; }
 
+    int rc = 0;
+    struct Token *op_stack_top;
 
-int shunting_yard(struct Token *input_tokenized, 
-                            int token_count, 
-                            struct Token *output_tokenized) {
-    // Initialize operator stack
-    // printf("Allocating operator stack...");
-    struct Stack *op_stack = init_stack(token_count);
-    // Initialize output stack
-    // printf("Allocating output stack.....");
-    struct Stack *ret_stack = init_stack(token_count);
-    // counter for output stack length - hard to know once written to memory
-    int output_token_count;
-    // Top of operator stack - so we don't have to access it every single time
-    struct Token *op_stack_top = get_stack_start(op_stack);
-
-    // remember the tokenized input is backwards, so compensate for that
-    for (int i = token_count-1; i >=0; i--) { 
-        // Loop through all the tokens to be read in
-        struct Token *token = (input_tokenized + i);
-
-        // What type of token is it?
-        if (token->type == Number || token->type == Variable) {
-            push_stack(ret_stack, *token);
-        } else if (token->type == Function) {
-            push_stack(op_stack, *token);
-        } else if (token->type == Operator) {
-            // Check we aren't looking at an empty stack (this means an operator was put first,
-            // for instance *4*4 isn't a valid expression)
-            // printf("[Shunting] Operator found. Operator stack top: %p\n", op_stack_top);
-            if (is_stack_empty(op_stack) || op_stack_top == NULL) { 
-                // printf("Operator stack was empty. Pushing and continuing loop.\n");
-                push_stack(op_stack, *token); 
-                continue; 
-            }
-            // I'm really sorry about this boolean check
-            while (
+    // What type of token is it?
+    if (token->type == Number || token->type == Variable || token->type == Parameter) {
+        rc = emit(state, token);
+    } else if (token->type == Function || token->type == Bracket_Left ||
+               (token->type == Operator && token->operator_type == Op_Negate)) {
+        // Prefix operators wait on the stack until their operand has been output
+        rc = push_operator(state, token);
+    } else if (token->type == Operator) {
+        // Output everything on the stack that binds at least as tightly as this operator
+        while ((op_stack_top = token_stack_top(&state->op_stack)) != NULL && rc == 0 && (
+                op_stack_top->type == Function ||
                 (
-                    (
-                        op_stack_top->type == Function
-                    ) ||
-                    (
-                        op_stack_top->type == Operator && 
-                        op_stack_top->precedence > token->precedence
-                    ) ||
-                    (
-                        op_stack_top->type == Operator && 
-                        op_stack_top->precedence == token->precedence &&
-                        op_stack_top->associativity == Assoc_Left
-                    ) 
-                ) && op_stack_top->type != Bracket_Left
-            ) { 
-                // printf("Popped operator from stack onto output stack.\n");
-                push_stack(ret_stack, pop_stack(op_stack)); 
-                op_stack_top = get_stack_top(op_stack); // otherwise an infinite loop results
-                if (op_stack_top == NULL) { break; } // if stack just emptied, we'll get a null ptr
-                // (and if we attempt to do stuff with that on the next run of the loop, bad stuff
-                // is going to happen)
-            }
+                    op_stack_top->type == Operator &&
+                    op_stack_top->precedence > token->precedence
+                ) ||
+                (
+                    op_stack_top->type == Operator &&
+                    op_stack_top->precedence == token->precedence &&
+                    token->associativity == Assoc_Left
+                )
+            )) {
+            rc = pop_to_output(state);
+        }
 
-            push_stack(op_stack, *token);
-        } else if (token->type == Bracket_Left) {
-            push_stack(op_stack, *token);
-        } else if (token->type == Bracket_Right) {
-            while (op_stack_top->type != Bracket_Left) {
-                push_stack(ret_stack, pop_stack(op_stack));
-                op_stack_top = get_stack_top(op_stack);
-                if (op_stack_top == NULL) { break; }
-            }
-            // Once that loop is done, the operator stack will either be empty or have a left 
-            // parentheses on top. If it's empty, that means there are mismatched parentheses.
-            if (is_stack_empty(op_stack)) {
-                return -1; // error return code (rc)
-            } else if (op_stack_top->type == Bracket_Left) {
-                pop_stack(op_stack); // Discard top
-                //op_stack_top = get_stack_top(op_stack);
-            }
+        if (rc == 0) { rc = push_operator(state, token); }
+    } else if (token->type == Bracket_Right) {
+        while ((op_stack_top = token_stack_top(&state->op_stack)) != NULL && rc == 0 &&
+               op_stack_top->type != Bracket_Left) {
+            rc = pop_to_output(state);
         }
+        // Once that loop is done, the operator stack will either be empty or have a left
+        // parentheses on top. If it's empty, that means there are mismatched parentheses.
+        if (rc == 0 && op_stack_top == NULL) {
+            rc = Parse_Mismatched_Brackets;
+        } else if (rc == 0) {
+            token_stack_pop(&state->op_stack); // Discard the bracket
 
-        // Update top stack pointer
-        // printf("[Shunting] (i = %d) Finished evaluating token of type %d\n", i, token->type);
-        // printf("[Shunting] Getting new stack top: Stack start (%p), Stack top (%p), ",
-        //      op_stack->start, op_stack_top);
-        op_stack_top = get_stack_top(op_stack);
-        
-        // if (op_stack_top == NULL) { break; } It's possible for the operator stack to be emptied
-        // during the running of the program, I think. So it's mainly important to check for NULL
-        // during loops when the stack top will *immediately* be accessed again, whereas here the
-        // next iteration may add to it, so a break is unnecessary.
-
-        // printf("New stack top (%p)\n", op_stack_top);
+            // If the bracket belonged to a function call, the function is done too
+            op_stack_top = token_stack_top(&state->op_stack);
+            if (op_stack_top != NULL && op_stack_top->type == Function) {
+                rc = pop_to_output(state);
+            }
+        }
     }
 
+    state->error = rc;
+    return rc;
+}
+
+// Function: shunting_finish(state)
+// Description: Outputs whatever is left on the operator stack once the whole expression has been
+//              pushed, checks that the RPN is complete, and frees the operator stack
+// Parameters: state, the shunting-yard state
+// Outputs: The number of tokens in the RPN expression (which is not the number of tokens pushed,
+//          because brackets are removed), or a (negative) enum Parse_Error:
+//              Parse_Mismatched_Brackets if brackets were mismatched
+//              Parse_Missing_Operand if an operator was missing an operand, e.g. *4*4 or 4+
+//              Parse_Out_Of_Memory if the operator stack couldn't grow
+
+int shunting_finish(struct Shunting_Yard *state) {
+    int rc = state->error;
+
     // Pop remainder of operator stack onto output queue
-    // printf("Popping contents of operator stack into output stack...\n");
-    while (!is_stack_empty(op_stack)) {
-        if (
-            op_stack_top->type == Bracket_Left || 
-            op_stack_top->type == Bracket_Right
-        ) { // There were mismatched parentheses
-            return -1;
+    while (rc == 0 && !token_stack_is_empty(&state->op_stack)) {
+        if (token_stack_top(&state->op_stack)->type == Bracket_Left) {
+            rc = Parse_Mismatched_Brackets; // There were mismatched parentheses
         } else {
-            push_stack(ret_stack, pop_stack(op_stack));
+            rc = pop_to_output(state);
         }
     }
 
-    // Write output stack to memory location given
-    int j = 0;
-    while (!is_stack_empty(ret_stack)) {
-        struct Token to_write = pop_stack(ret_stack);
-        memcpy(output_tokenized + j, &to_write, sizeof(to_write));
-        j++;
+    // A complete expression leaves exactly one value on the evaluation stack (or none if it was
+    // empty)
+    if (rc == 0 && state->output_count > 0 && state->depth != 1) {
+        rc = Parse_Missing_Operand;
     }
 
     // Cleanup
-    delete_stack(op_stack);
-    delete_stack(ret_stack);
+    token_stack_free(&state->op_stack);
 
-    return j; // rc for success: number of tokens in the final rpn expression
+    return (rc != 0) ? rc : state->output_count;
 }
 
-// Safety net: sometimes once we pop the last element off the operator stack we will try and get
-// the top of an empty stack, which generates a null pointer.
-void refresh_op_stack_top(struct Token *stack_top_ptr, struct Stack *stack) {
-    if (!is_stack_empty(stack)) {
-        stack_top_ptr = get_stack_top(stack);
+// Function: shunting_yard(input_tokenized, token_count, output_tokenized, arena)
+// Description: Performs Dijkstra's shunting-yard algorithm on a tokenized infix expression to
+//              generate a tokenized RPN expression
+// Parameters: input_tokenized, a ptr to the start of an array of tokens (e.g. from exp_to_tokens)
+//             token_count, an integer equal to the number of tokens in the array
+//             output_tokenized, a ptr to the start of an array where the output should be stored,
+//             with room for token_count tokens
+//             arena, the arena to grow the operator stack into if needed (NULL for the heap)
+// Outputs: An integer corresponding to the number of tokens in the final expression, or a
+//          (negative) enum Parse_Error, as for shunting_finish()
+
+int shunting_yard(struct Token *input_tokenized,
+                            int token_count,
+                            struct Token *output_tokenized,
+                            struct Arena *arena) {
+    struct Shunting_Yard state;
+    shunting_init(&state, arena, output_tokenized);
+    for (int i = 0; i < token_count; i++) {
+        if (shunting_push(&state, input_tokenized + i) != 0) { break; }
     }
+
+    return shunting_finish(&state);
 }
 
-// Evaluate RPN expression
-double evaluate_rpn(struct Token *input_rpn, int num_tokens, double x) {
-    // Variables used during iteration
-    struct Token *token;
-    struct Token operand1;
-    struct Token operand2;
+// Function: apply_token(token, x, eval_stack)
+// Description: Executes one token of an RPN expression: pops its operands (if any) off the operand
+//              stack and works out its value. Shared by evaluate_rpn() and evaluate_rpn_profiled(),
+//              and inlined into both.
+// Parameters: token, the token
+//             x, the value of the variable
+//             eval_stack, the operand stack, which must hold the token's operands
+// Outputs: The value, to be pushed back onto the stack
+
+static inline double apply_token(const struct Token *token, double x,
+                                 struct Value_Stack *eval_stack) {
     double operand1_value;
     double operand2_value;
     double operation_result;
-    
-    // Initialize operand stack
-    struct Stack *eval_stack = init_stack(num_tokens); 
-    // In theory it doesn't need to be this big, but stack overflow errors are hard to debug due
-    // to the website of the same name taking up all the Google results, so better to be safe ;)
-
-    // Loop through all tokens (again, the arrays are backwards because they're generated by
-    // popping stacks starting at the top)
-    for (int i = num_tokens-1; i >= 0; i--) {
-        token = (input_rpn + i);
-        if (token == NULL) { break; }
-        
-        //printf("Token: ");
-        //print_token(token);
-        
-
-        if (token->type == Operator) {
-            // Get two most recent operands & their values
-            // Their value depends on if they're a number or a variable
-            operand1 = pop_stack(eval_stack);
-            operand2 = pop_stack(eval_stack);
-            
-
-            operand1_value = get_token_value(&operand1, x);
-            operand2_value = get_token_value(&operand2, x);
-
-            // Now perform the calculation. Sorry again about this Great Wall of China replica
-            switch (token->operator_type) {
-                case Op_Power:
-                    operation_result = pow(operand2_value, operand1_value);
-                    // printf("%f ^ %f = %f", operand2_value, operand1_value, operation_result);
-                    break;
-                case Op_Multiply:
-                    operation_result = operand2_value * operand1_value;
-                    // printf("%f * %f = %f", operand2_value, operand1_value, operation_result);
-                    break;
-                case Op_Divide:
-                    operation_result = operand2_value / operand1_value;
-                    // printf("%f / %f = %f", operand2_value, operand1_value, operation_result);
-                    break;
-                case Op_Add:
-                    operation_result = operand2_value + operand1_value;
-                    // printf("%f + %f = %f", operand2_value, operand1_value, operation_result);
-                    break;
-                case Op_Subtract:
-                    operation_result = operand2_value - operand1_value;
-                    // printf("%f - %f = %f", operand2_value, operand1_value, operation_result);
-                    break;
-                default:
-                    printf("invalid operator???");
-                    exit(EXIT_FAILURE);
-            }
-            // printf("\n");
 
-            //printf(" | Operation result: %f", operation_result);
+    if (token->type == Number) {
+        operation_result = token->value;
+    }
+    else if (token->type == Variable) {
+        operation_result = x;
+    }
+    else if (token->type == Function) {
+        // Pop the most recent value off the stack and use it as the paremeter to the function
+        // Every registered function has an arity of 1 (constants never reach this point), so
+        // this is valid for all cases.
+        operand1_value = value_stack_pop(eval_stack);
 
-            // Once we have the result, push it back to the stack
-            struct Token result = {
-                .type = Number,
-                .value = operation_result
-            };
+        // Functions are looked up in the registry rather than switched on, so adding a
+        // function doesn't add a branch here
+        operation_result = function_table[token->function_type].scalar(operand1_value);
+    }
+    else if (token->operator_type == Op_Negate) {
+        operation_result = -value_stack_pop(eval_stack);
+    }
+    else {
+        // Get two most recent operands
+        operand1_value = value_stack_pop(eval_stack);
+        operand2_value = value_stack_pop(eval_stack);
 
-            push_stack(eval_stack, result);
+        // Now perform the calculation. Sorry again about this Great Wall of China replica
+        switch (token->operator_type) {
+            case Op_Power:
+                operation_result = pow(operand2_value, operand1_value);
+                // printf("%f ^ %f = %f", operand2_value, operand1_value, operation_result);
+                break;
+            case Op_Multiply:
+                operation_result = operand2_value * operand1_value;
+                // printf("%f * %f = %f", operand2_value, operand1_value, operation_result);
+                break;
+            case Op_Divide:
+                operation_result = operand2_value / operand1_value;
+                // printf("%f / %f = %f", operand2_value, operand1_value, operation_result);
+                break;
+            case Op_Add:
+                operation_result = operand2_value + operand1_value;
+                // printf("%f + %f = %f", operand2_value, operand1_value, operation_result);
+                break;
+            case Op_Subtract:
+                operation_result = operand2_value - operand1_value;
+                // printf("%f - %f = %f", operand2_value, operand1_value, operation_result);
+                break;
+            default:
+                operation_result = NAN; // should never happen
+                break;
         }
-        else if (token->type == Function) {
-            // Pop the most recent value off the stack and use it as the paremeter to the function
-            // I haven't implemented any functions which take more than one value, so this is valid
-            // for all cases.
-            operand1 = pop_stack(eval_stack);
-            operand1_value = get_token_value(&operand1, x);
-
-            switch (token->function_type) {
-                case Func_Sin:
-                    operation_result = sin(operand1_value);
-                    break;
-                case Func_Cos:
-                    operation_result = cos(operand1_value);
-                    break;
-                case Func_Tan:
-                    operation_result = tan(operand1_value);
-                    break;
-                case Func_Ln:
-                    operation_result = log(operand1_value);
-                    break;
-                case Func_Log:
-                    operation_result = log10(operand1_value);
-                    break;
-                case Func_Exp:
-                    operation_result = exp(operand1_value);
-                    break;
-            }
+    }
 
-            struct Token result = {
-                .type = Number,
-                .value = operation_result
-            };
+    return operation_result;
+}
 
-            push_stack(eval_stack, result);
-        }
-        else if (token->type == Number) {
-            push_stack(eval_stack, *token);
-        } 
-        else if (token->type == Variable) {
-            
-            // If there are no more tokens after this x, it won't get converted into a number
-            // where it normally would during the operator evaluation process
-            // So we should convert it ASAP or it might stay as x
-            struct Token result = { 
-                .type = Number,
-                .value = x
-            };
-
-            push_stack(eval_stack, result);
-        }
+// Evaluate RPN expression
+// The RPN must be complete, as checked by shunting_finish(): every operator has its operands, so
+// nothing needs checking here. The operand stack holds the first 32 values on the C stack; only
+// expressions that nest deeper than that use scratch memory from `scratch`, which is handed back
+// before returning, so evaluating many times doesn't use up any more memory or call malloc
+double evaluate_rpn(const struct Token *input_rpn, int num_tokens, double x,
+                    struct Arena *scratch) {
+    // Initialize operand stack
+    struct Arena_Mark mark = arena_mark(scratch);
+    struct Value_Stack eval_stack;
+    value_stack_init(&eval_stack, scratch);
+
+    // Loop through all tokens, which are in the order they should be evaluated
+    for (int i = 0; i < num_tokens; i++) {
+        //printf("Token: ");
+        //print_token(input_rpn + i);
 
+        // Once we have the result, push it back to the stack
+        double operation_result = apply_token(input_rpn + i, x, &eval_stack);
+        if (value_stack_push(&eval_stack, operation_result) != STACK_OK) {
+            arena_release(scratch, mark);
+            return NAN; // out of memory
+        }
     }
     // Clean up
     // In theory once that loop is done, the result should be the lone value on the stack
-    double result = pop_stack(eval_stack).value;
-    delete_stack(eval_stack);
+    double result = value_stack_is_empty(&eval_stack) ? 0 : value_stack_pop(&eval_stack);
+    arena_release(scratch, mark);
+
+    return result;
+}
+
+// Function: evaluate_rpn_profiled(input_rpn, num_tokens, x, scratch, profile)
+// Description: Does the same as evaluate_rpn(), but also counts each token executed and the cycles
+//              it took in a profile (see profile.h). Much slower, so only used when asked for.
+// Parameters: As for evaluate_rpn(), plus
+//             profile, the profile to add to
+// Outputs: The value of the expression
+
+double evaluate_rpn_profiled(const struct Token *input_rpn, int num_tokens, double x,
+                             struct Arena *scratch, struct Eval_Profile *profile) {
+    struct Arena_Mark mark = arena_mark(scratch);
+    struct Value_Stack eval_stack;
+    value_stack_init(&eval_stack, scratch);
+
+    for (int i = 0; i < num_tokens; i++) {
+        unsigned long long started = profile_cycles();
+        double operation_result = apply_token(input_rpn + i, x, &eval_stack);
+        unsigned long long cycles = profile_cycles() - started;
+
+        int slot = profile_slot(input_rpn + i);
+        profile->executions[slot]++;
+        profile->cycles[slot] += cycles;
+
+        if (value_stack_push(&eval_stack, operation_result) != STACK_OK) {
+            arena_release(scratch, mark);
+            return NAN;
+        }
+    }
+
+    double result = value_stack_is_empty(&eval_stack) ? 0 : value_stack_pop(&eval_stack);
+    arena_release(scratch, mark);
 
     return result;
 }
@@ -3,11 +3,40 @@
 
 #include "stack.h" // for various types referenced
 #include "token.h"
+#include "arena.h"
+#include "profile.h"
+
+// --- Type declarations ---
+
+// Errors from converting an expression to RPN. All are negative so that they can share a return
+// value with a token count.
+enum Parse_Error {
+    Parse_Mismatched_Brackets = -1,
+    Parse_Missing_Operand = -2, // e.g. *4*4 or 4+
+    Parse_Unknown_Token = -3,
+    Parse_Out_Of_Memory = -4
+};
+
+// In-progress state of the shunting-yard algorithm
+struct Shunting_Yard {
+    struct Token_Stack op_stack; // Operators (and brackets/functions) waiting to be output
+    struct Token *output; // RPN written so far
+    int output_count;
+    int depth; // Number of values the RPN written so far leaves on the evaluation stack
+    int max_depth; // Most values on the evaluation stack at any point
+    int error; // First error encountered, or 0
+};
 
 // --- Function declarations ---
 
-int shunting_yard(struct Token *input_ptr, int token_count, struct Token *output_ptr);
-void refresh_op_stack_top(struct Token *stack_top_ptr, struct Stack *stack);
-double evaluate_rpn(struct Token *input_rpn, int num_tokens, double x);
+void shunting_init(struct Shunting_Yard *state, struct Arena *arena, struct Token *output);
+int shunting_push(struct Shunting_Yard *state, const struct Token *token);
+int shunting_finish(struct Shunting_Yard *state);
+int shunting_yard(struct Token *input_ptr, int token_count, struct Token *output_ptr,
+                  struct Arena *arena);
+double evaluate_rpn(const struct Token *input_rpn, int num_tokens, double x,
+                    struct Arena *scratch);
+double evaluate_rpn_profiled(const struct Token *input_rpn, int num_tokens, double x,
+                             struct Arena *scratch, struct Eval_Profile *profile);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,25 +1,105 @@
 #ifndef STACK_H_INCLUDED
 #define STACK_H_INCLUDED // Include guards: block the same header from being included twice in a file
+
+#include <stdlib.h>
+#include <string.h>
 #include "token.h"
+#include "arena.h"
+
+// ------ Stack definitions ------
+// The stack is a datatype that can be thought of like a stack of plates or books.
+// You can add (push) items or remove (pop) them from the top, but you can't access arbitrary
+// indices like you can with a normal array.
+//
+// DEFINE_STACK(Name, prefix, Type, INLINE_CAPACITY) defines `struct Name`, a stack of Type, along
+// with its functions prefix_init(), prefix_push() etc. The first INLINE_CAPACITY items are stored
+// inside the struct itself, so a stack declared as a local variable keeps shallow contents on the
+// C stack and never allocates. Past that, the storage doubles in size each time it fills, taken
+// from the arena given to prefix_init() (or the heap if that was NULL).
+//
+// Because the inline items live inside the struct, a stack must not be copied (by assignment or
+// by value) once initialized; pass pointers to it instead.
+
+// Return codes of push
+#define STACK_OK 0
+#define STACK_OVERFLOW -1 // the stack was full and couldn't grow, so the value was not pushed
 
-// Stacks
-// --- Type declarations ---
+#define DEFINE_STACK(Name, prefix, Type, INLINE_CAPACITY)                                        \
+                                                                                                 \
+struct Name {                                                                                    \
+    Type *items; /* Pointer to the start of the array of values (inline_items until it grows) */ \
+    int size; /* Current size of array */                                                       \
+    int capacity; /* Size the array can reach before it has to grow */                          \
+    struct Arena *arena; /* Where grown storage comes from, or NULL for the heap */              \
+    Type inline_items[INLINE_CAPACITY];                                                          \
+};                                                                                               \
+                                                                                                 \
+/* Factory method for initializing a stack in place */                                          \
+static inline void prefix##_init(struct Name *stack, struct Arena *arena) {                      \
+    stack->items = stack->inline_items;                                                          \
+    stack->size = 0;                                                                             \
+    stack->capacity = INLINE_CAPACITY;                                                           \
+    stack->arena = arena;                                                                        \
+}                                                                                                \
+                                                                                                 \
+/* Doubles the capacity of a full stack. Returns STACK_OK, or STACK_OVERFLOW if it couldn't */   \
+static inline int prefix##_grow(struct Name *stack) {                                            \
+    int capacity = stack->capacity * 2;                                                          \
+    Type *items;                                                                                 \
+                                                                                                 \
+    if (stack->arena != NULL) {                                                                  \
+        /* The old storage is left in the arena; doubling means at most as much again */        \
+        items = arena_alloc(stack->arena, capacity * sizeof(Type));                              \
+        if (items != NULL) { memcpy(items, stack->items, stack->size * sizeof(Type)); }          \
+    } else if (stack->items == stack->inline_items) {                                            \
+        items = malloc(capacity * sizeof(Type));                                                 \
+        if (items != NULL) { memcpy(items, stack->items, stack->size * sizeof(Type)); }          \
+    } else {                                                                                     \
+        items = realloc(stack->items, capacity * sizeof(Type));                                  \
+    }                                                                                            \
+                                                                                                 \
+    if (items == NULL) { return STACK_OVERFLOW; }                                                \
+    stack->items = items;                                                                        \
+    stack->capacity = capacity;                                                                  \
+    return STACK_OK;                                                                             \
+}                                                                                                \
+                                                                                                 \
+/* Adds a value to the top. Returns STACK_OK, or STACK_OVERFLOW if the stack couldn't grow */    \
+static inline int prefix##_push(struct Name *stack, Type value) {                                \
+    if (stack->size == stack->capacity && prefix##_grow(stack) != STACK_OK) {                    \
+        return STACK_OVERFLOW;                                                                   \
+    }                                                                                            \
+    stack->items[stack->size++] = value;                                                         \
+    return STACK_OK;                                                                             \
+}                                                                                                \
+                                                                                                 \
+/* Removes and returns the top value. The stack must not be empty */                            \
+static inline Type prefix##_pop(struct Name *stack) {                                            \
+    return stack->items[--stack->size];                                                          \
+}                                                                                                \
+                                                                                                 \
+/* Pointer to the top value, or NULL if the stack is empty */                                   \
+static inline Type *prefix##_top(struct Name *stack) {                                           \
+    return (stack->size == 0) ? NULL : &stack->items[stack->size - 1];                           \
+}                                                                                                \
+                                                                                                 \
+static inline int prefix##_is_empty(const struct Name *stack) {                                  \
+    return stack->size == 0;                                                                     \
+}                                                                                                \
+                                                                                                 \
+/* Frees grown heap storage (arena storage is freed with the arena) */                          \
+static inline void prefix##_free(struct Name *stack) {                                           \
+    if (stack->arena == NULL && stack->items != stack->inline_items) { free(stack->items); }     \
+    stack->items = stack->inline_items;                                                          \
+    stack->size = 0;                                                                             \
+    stack->capacity = INLINE_CAPACITY;                                                           \
+}
 
-struct Stack {
-    struct Token *start; // Pointer to start of memory allocated for array of values
-    struct Token *top; // Pointer to last defined value in array
-    int size; // Current size of array
-    int capacity; // Maximum size
-};
+// --- Stack types used by the program ---
 
-// --- Function declarations ---
-struct Stack *init_stack(int capacity);
-void push_stack(struct Stack* stack, struct Token value);
-struct Token pop_stack(struct Stack* stack);
-struct Token *get_stack_top(struct Stack* stack);
-struct Token* get_stack_start(struct Stack* stack);
-int is_stack_empty(struct Stack* stack);
-int get_stack_size(struct Stack* stack);
-void delete_stack(struct Stack* stack);
+// Operators waiting to be output by the shunting-yard algorithm
+DEFINE_STACK(Token_Stack, token_stack, struct Token, 32)
+// Operands of the RPN evaluator
+DEFINE_STACK(Value_Stack, value_stack, double, 32)
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+// Names of the stages, as printed
+static const char *stage_names[Stage_Count] = { "read", "compile", "integrate" };
+
+/*
+ * ----------------------------------------------
+ * Function definitions
+ * ----------------------------------------------
+ */
+
+/*
+ * Function: stats_begin(stats, enabled, perf, arena)
+ *
+ * Description: Starts recording the statistics of a request
+ * Parameters: stats - the statistics to reset
+ *             enabled - whether to record anything
+ *             perf - hardware counters to read around each stage as well, or NULL
+ *             arena - the arena the request allocates from, so that its allocations can be counted
+ * Returns: none
+ */
+
+void stats_begin(struct Request_Stats *stats, int enabled, const struct Perf_Counters *perf,
+                 const struct Arena *arena) {
+    memset(stats, 0, sizeof(*stats));
+    stats->enabled = enabled;
+    stats->perf = (perf != NULL && perf->open_count > 0) ? perf : NULL;
+
+    // Counters that couldn't be opened are left out, even for stages that never run
+    for (int i = 0; i < Stage_Count && stats->perf != NULL; i++) {
+        for (int c = 0; c < Perf_Counter_Count; c++) {
+            if (perf->fds[c] < 0) { stats->stage_counts[i][c] = -1; }
+        }
+    }
+
+    // Counted from here, and the difference taken in stats_end()
+    stats->block_allocations = -arena->block_allocations;
+}
+
+/*
+ * Function: stats_add_counts(stats, stage)
+ *
+ * Description: Adds what the hardware counters counted since stats_start() to a stage. Called by
+ *              stats_stop().
+ * Parameters: stats - the request's statistics
+ *             stage - the stage that has just finished
+ * Returns: none
+ */
+
+void stats_add_counts(struct Request_Stats *stats, enum Stats_Stage stage) {
+    long long now[Perf_Counter_Count];
+    perf_read(stats->perf, now);
+
+    for (int i = 0; i < Perf_Counter_Count; i++) {
+        long long *count = &stats->stage_counts[stage][i];
+        if (now[i] < 0 || stats->perf_started[i] < 0) {
+            *count = -1; // the counter isn't available (or couldn't be read)
+        } else if (*count >= 0) {
+            *count += now[i] - stats->perf_started[i];
+        }
+    }
+}
+
+/*
+ * Function: stats_add_result(stats, result)
+ *
+ * Description: Adds the counters of an integration to a request's statistics
+ * Parameters: stats - the request's statistics
+ *             result - the result of the integration
+ * Returns: none
+ */
+
+void stats_add_result(struct Request_Stats *stats, const struct Integration_Result *result) {
+    stats->evaluations += result->evaluations;
+    stats->nan_results += result->nan_results;
+    stats->inf_results += result->inf_results;
+    stats->precision = result->precision;
+}
+
+/*
+ * Function: stats_end(stats, arena)
+ *
+ * Description: Finishes recording the statistics of a request
+ * Parameters: stats - the request's statistics
+ *             arena - the arena the request allocated from
+ * Returns: none
+ */
+
+void stats_end(struct Request_Stats *stats, const struct Arena *arena) {
+    stats->block_allocations += arena->block_allocations;
+    stats->arena_capacity = arena->total_capacity;
+}
+
+/*
+ * Function: stats_print(stats, stream)
+ *
+ * Description: Prints a human-readable summary of a request's statistics
+ * Parameters: stats - the request's statistics
+ *             stream - where to print them
+ * Returns: none
+ */
+
+void stats_print(const struct Request_Stats *stats, FILE *stream) {
+    double total_ns = 0;
+    for (int i = 0; i < Stage_Count; i++) { total_ns += stats->stage_ns[i]; }
+
+    fprintf(stream, "Statistics:\n");
+    for (int i = 0; i < Stage_Count; i++) {
+        fprintf(stream, "\t%-10s %12.3f ms (%5.1f%%)\n", stage_names[i], stats->stage_ns[i] / 1e6,
+                (total_ns > 0) ? 100 * stats->stage_ns[i] / total_ns : 0);
+    }
+    fprintf(stream, "\texpression: %zu characters, %d RPN tokens\n", stats->expression_length,
+            stats->program_length);
+    fprintf(stream, "\tevaluations: %ld (%.1f ns each), %ld NaN, %ld infinite\n",
+            stats->evaluations,
+            (stats->evaluations > 0) ? stats->stage_ns[Stage_Integrate] / stats->evaluations : 0,
+            stats->nan_results, stats->inf_results);
+    fprintf(stream, "\tallocations: %ld (arena size %zu bytes)\n", stats->block_allocations,
+            stats->arena_capacity);
+
+    if (stats->perf != NULL) {
+        for (int i = 0; i < Stage_Count; i++) {
+            const long long *counts = stats->stage_counts[i];
+            fprintf(stream, "\t%-10s", stage_names[i]);
+            for (int c = 0; c < Perf_Counter_Count; c++) {
+                if (counts[c] >= 0) {
+                    fprintf(stream, " %lld %s", counts[c], perf_counter_name(c));
+                }
+            }
+            if (counts[Perf_Cycles] > 0 && counts[Perf_Instructions] >= 0) {
+                fprintf(stream, " (IPC %.2f)",
+                        (double)counts[Perf_Instructions] / counts[Perf_Cycles]);
+            }
+            fprintf(stream, "\n");
+        }
+
+        // Per evaluation, which is what the evaluator's speed comes down to
+        if (stats->evaluations > 0) {
+            fprintf(stream, "\tper evaluation:");
+            for (int c = 0; c < Perf_Counter_Count; c++) {
+                long long count = stats->stage_counts[Stage_Integrate][c];
+                if (count >= 0) {
+                    fprintf(stream, " %.2f %s", (double)count / stats->evaluations,
+                            perf_counter_name(c));
+                }
+            }
+            fprintf(stream, "\n");
+        }
+    }
+    fprintf(stream, "\n");
+}
+
+/*
+ * Function: stats_print_json(stats, stream)
+ *
+ * Description: Prints a request's statistics as one line of JSON, for batch mode
+ * Parameters: stats - the request's statistics
+ *             stream - where to print them
+ * Returns: none
+ */
+
+void stats_print_json(const struct Request_Stats *stats, FILE *stream) {
+    fprintf(stream, "{");
+    for (int i = 0; i < Stage_Count; i++) {
+        fprintf(stream, "\"%s_ns\": %.0f, ", stage_names[i], stats->stage_ns[i]);
+    }
+    if (stats->perf != NULL) {
+        for (int i = 0; i < Stage_Count; i++) {
+            const long long *counts = stats->stage_counts[i];
+            for (int c = 0; c < Perf_Counter_Count; c++) {
+                if (counts[c] >= 0) {
+                    fprintf(stream, "\"%s_%s\": %lld, ", stage_names[i], perf_counter_name(c),
+                            counts[c]);
+                }
+            }
+            if (counts[Perf_Cycles] > 0 && counts[Perf_Instructions] >= 0) {
+                fprintf(stream, "\"%s_ipc\": %.3f, ", stage_names[i],
+                        (double)counts[Perf_Instructions] / counts[Perf_Cycles]);
+            }
+        }
+    }
+    fprintf(stream, "\"expression_length\": %zu, \"program_length\": %d, \"evaluations\": %ld, "
+                    "\"nan_results\": %ld, \"inf_results\": %ld, \"allocations\": %ld, "
+                    "\"arena_bytes\": %zu, \"precision\": \"%s\"}\n",
+            stats->expression_length, stats->program_length, stats->evaluations,
+            stats->nan_results, stats->inf_results, stats->block_allocations,
+            stats->arena_capacity, (stats->precision == Precision_Float) ? "single" : "double");
+}
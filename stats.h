@@ -0,0 +1,84 @@
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED // Include guards
+
+#include <stdio.h> // FILE
+#include <time.h>
+#include "arena.h"
+#include "integrate.h"
+#include "perf.h"
+
+// ------ Request statistics ------
+// Where the time of one integration request went, and some counts of what it did. Each stage is
+// timed with a pair of stats_start()/stats_stop() calls around it; these are inline and do
+// nothing but test a flag when statistics are disabled, so they can stay in the code for good.
+// If hardware counters are given to stats_begin(), they are read around each stage too.
+
+// --- Type declarations ---
+
+// The stages of a request. Tokenizing and shunting-yard are one stage, because the parser does
+// both in one pass (see compile_expression()).
+enum Stats_Stage {
+    Stage_Read, // Reading the expression (from a file or a batch job; not the user typing it)
+    Stage_Compile, // Tokenizing and converting to RPN
+    Stage_Integrate, // Evaluating the expression at each point and summing
+    Stage_Count
+};
+
+struct Request_Stats {
+    int enabled; // If 0, nothing is timed or recorded
+    double stage_ns[Stage_Count]; // Time spent in each stage
+    double stage_started; // When the stage currently being timed started
+    size_t expression_length; // Characters in the expression
+    int program_length; // Tokens in the compiled RPN
+    long evaluations; // Number of times the expression was evaluated
+    long nan_results; // Evaluations that gave NaN...
+    long inf_results; // ...or +/- infinity
+    enum Integration_Precision precision; // Precision the integrand was evaluated in
+    long block_allocations; // Number of times the request's arena called malloc
+    size_t arena_capacity; // Size of the request's arena afterwards
+    const struct Perf_Counters *perf; // Hardware counters to read around each stage, or NULL
+    long long perf_started[Perf_Counter_Count]; // Counters when the current stage started
+    long long stage_counts[Stage_Count][Perf_Counter_Count]; // Counted in each stage (-1: n/a)
+};
+
+// --- Function declarations ---
+
+void stats_begin(struct Request_Stats *stats, int enabled, const struct Perf_Counters *perf,
+                 const struct Arena *arena);
+void stats_add_counts(struct Request_Stats *stats, enum Stats_Stage stage);
+void stats_add_result(struct Request_Stats *stats, const struct Integration_Result *result);
+void stats_end(struct Request_Stats *stats, const struct Arena *arena);
+void stats_print(const struct Request_Stats *stats, FILE *stream);
+void stats_print_json(const struct Request_Stats *stats, FILE *stream);
+
+/*
+ * Function: stats_now()
+ *
+ * Description: Reads the monotonic clock, which is a vDSO call (no system call) on Linux
+ * Parameters: none
+ * Returns: The time in nanoseconds since an arbitrary point
+ */
+
+static inline double stats_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Starts timing a stage
+static inline void stats_start(struct Request_Stats *stats) {
+    if (stats->enabled) {
+        if (stats->perf != NULL) { perf_read(stats->perf, stats->perf_started); }
+        stats->stage_started = stats_now();
+    }
+}
+
+// Stops timing a stage, adding the time since stats_start() to it
+static inline void stats_stop(struct Request_Stats *stats, enum Stats_Stage stage) {
+    if (stats->enabled) {
+        stats->stage_ns[stage] += stats_now() - stats->stage_started;
+        if (stats->perf != NULL) { stats_add_counts(stats, stage); }
+    }
+}
+
+#endif
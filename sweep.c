@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sweep.h"
+#include "checkpoint.h"
+
+// Initial size of each thread's working memory
+#define SWEEP_ARENA_SIZE (64 * 1024)
+
+// --- Type declarations ---
+
+// A sweep, shared by the threads working on it
+struct Sweep_Work {
+    const struct Program *program;
+    const double *parameters; // set_count sets of parameter_count values, one set after another
+    int parameter_count;
+    long set_count;
+    double start, end;
+    long strips;
+    const struct Integration_Options *options;
+
+    long part_points; // Grid points in each part, except perhaps the last
+    int part_count;
+    long block_count; // Blocks of VECTOR_BLOCK sets
+    long item_count; // block_count * part_count
+    struct Checkpoint_State *states; // Each set's sums for each part, at [part * set_count + set]
+
+    atomic_long next_item; // The next item to take
+    atomic_int status; // Integration_Ok, or the first error a thread ran into
+};
+
+// ------ Parameter sweep definitions ------
+
+/*
+ * Function: run_item(work, item, block, scratch)
+ *
+ * Description: Does one item of a sweep: a block of sets over one part of the grid
+ * Parameters: work - the sweep
+ *             item - which item
+ *             block - working memory for the sets' values, one block per parameter
+ *             scratch - arena for working memory
+ * Returns: Integration_Ok, or the error from integrate_sweep_part()
+ */
+
+static int run_item(struct Sweep_Work *work, long item, double *block, struct Arena *scratch) {
+    long first_set = (item / work->part_count) * VECTOR_BLOCK;
+    int part = item % work->part_count;
+    int n = (work->set_count - first_set < VECTOR_BLOCK) ? work->set_count - first_set :
+                                                            VECTOR_BLOCK;
+
+    // The sets are stored one after another, but the evaluator wants each parameter's values
+    // together
+    for (int k = 0; k < work->parameter_count; k++) {
+        for (int j = 0; j < n; j++) {
+            block[k * VECTOR_BLOCK + j] = work->parameters[(first_set + j) *
+                                                           work->parameter_count + k];
+        }
+    }
+
+    // Part 0 starts with both ends (point 0); the points in between are split up from 1
+    long first = (part == 0) ? 0 : 1 + part * work->part_points;
+    long last = 1 + (part + 1) * work->part_points;
+    if (last > work->strips) { last = work->strips; }
+
+    return integrate_sweep_part(work->program, block, n, work->start, work->end, work->strips,
+                                first, last, work->options,
+                                work->states + part * work->set_count + first_set, scratch);
+}
+
+/*
+ * Function: sweep_thread(argument)
+ *
+ * Description: A thread working on a sweep: takes items one at a time until there are none left,
+ *              or something has gone wrong
+ * Parameters: argument - the sweep
+ * Returns: NULL
+ */
+
+static void *sweep_thread(void *argument) {
+    struct Sweep_Work *work = argument;
+    struct Arena arena;
+    if (arena_init(&arena, SWEEP_ARENA_SIZE) != 0) {
+        atomic_store(&work->status, Integration_Out_Of_Memory);
+        return NULL;
+    }
+
+    int blocks = (work->parameter_count > 0) ? work->parameter_count : 1;
+    double *block = arena_alloc(&arena, (size_t)blocks * VECTOR_BLOCK * sizeof(double));
+    while (block != NULL && atomic_load(&work->status) == Integration_Ok) {
+        long item = atomic_fetch_add(&work->next_item, 1);
+        if (item >= work->item_count) { break; }
+
+        int rc = run_item(work, item, block, &arena);
+        if (rc != Integration_Ok) {
+            int ok = Integration_Ok;
+            atomic_compare_exchange_strong(&work->status, &ok, rc);
+        }
+    }
+    if (block == NULL) { atomic_store(&work->status, Integration_Out_Of_Memory); }
+
+    arena_free(&arena);
+    return NULL;
+}
+
+/*
+ * Function: sweep_integrate(program, parameters, parameter_count, set_count, start, end, options,
+ *                           threads, values, errors, summary)
+ *
+ * Description: Integrates an expression with parameters once for each of a list of sets of values
+ *              of its parameters (see sweep.h), across several threads
+ * Parameters: program - the expression, compiled with compile_parameterized()
+ *             parameters - the sets of values: parameter k of set i is
+ *                          parameters[i * parameter_count + k]
+ *             parameter_count - the number of parameters the expression was compiled with
+ *             set_count - the number of sets
+ *             start, end - the limits of integration (in either order)
+ *             options - how to integrate, as for integrate(), but always numerically and in
+ *                       double precision: the precision, surrogate, profile and checkpoint are
+ *                       unused, and polynomials aren't integrated exactly. The method has to be
+ *                       one with a grid of points, so not Method_Clenshaw_Curtis.
+ *             threads - the number of threads to use (0 for one per processor; see
+ *                       sweep_default_threads())
+ *             values - where each set's integral is written (set_count of them)
+ *             errors - where each set's estimated error is written for Method_Richardson, or NULL
+ *             summary - where the totals over all the sets are written, or NULL
+ * Returns: Integration_Ok (even if some sets were stopped by a NaN or infinity), or a (negative)
+ *          enum Integration_Status: Integration_Invalid_Options, Integration_Interrupted or
+ *          Integration_Out_Of_Memory, in which case none of the values are written
+ */
+
+int sweep_integrate(const struct Program *program, const double *parameters,
+                    int parameter_count, long set_count, double start, double end,
+                    const struct Integration_Options *options, int threads, double *values,
+                    double *errors, struct Sweep_Summary *summary) {
+    if (options->strips <= 0 || options->method == Method_Clenshaw_Curtis ||
+        parameter_count < 0 || parameter_count > SWEEP_MAX_PARAMETERS || set_count < 0) {
+        return Integration_Invalid_Options;
+    }
+    if (summary != NULL) { memset(summary, 0, sizeof(struct Sweep_Summary)); }
+    if (set_count == 0) { return Integration_Ok; }
+
+    if (start > end) {
+        double tmp = start;
+        start = end;
+        end = tmp;
+    }
+
+    struct Sweep_Work work = {
+        .program = program,
+        .parameters = parameters,
+        .parameter_count = parameter_count,
+        .set_count = set_count,
+        .start = start,
+        .end = end,
+        .strips = integrate_strips(options),
+        .options = options,
+        .block_count = (set_count + VECTOR_BLOCK - 1) / VECTOR_BLOCK
+    };
+
+    // Split the grid up only as far as it takes to make SWEEP_TARGET_ITEMS items, and into whole
+    // blocks of points. This depends only on the sweep, so every number of threads gets the same
+    // answer.
+    long inner_points = work.strips - 1; // the points between the ends
+    long most_parts = (inner_points + SWEEP_PART_POINTS - 1) / SWEEP_PART_POINTS;
+    long wanted_parts = (SWEEP_TARGET_ITEMS + work.block_count - 1) / work.block_count;
+    work.part_count = (wanted_parts < most_parts) ? wanted_parts : most_parts;
+    if (work.part_count < 1) { work.part_count = 1; }
+    long part_blocks = (inner_points + (long)work.part_count * VECTOR_BLOCK - 1) /
+                       ((long)work.part_count * VECTOR_BLOCK);
+    work.part_points = (part_blocks > 0) ? part_blocks * VECTOR_BLOCK : VECTOR_BLOCK;
+    work.item_count = work.block_count * work.part_count;
+    atomic_init(&work.next_item, 0);
+    atomic_init(&work.status, Integration_Ok);
+
+    work.states = malloc((size_t)work.part_count * set_count * sizeof(struct Checkpoint_State));
+    if (work.states == NULL) { return Integration_Out_Of_Memory; }
+
+    // This thread is one of the threads
+    if (threads <= 0) { threads = sweep_default_threads(); }
+    if (threads > work.item_count) { threads = work.item_count; }
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    if (ids != NULL) {
+        while (started < threads - 1 &&
+               pthread_create(&ids[started], NULL, sweep_thread, &work) == 0) {
+            started++;
+        }
+    }
+    sweep_thread(&work);
+    for (int t = 0; t < started; t++) { pthread_join(ids[t], NULL); }
+    free(ids);
+
+    int status = atomic_load(&work.status);
+    if (status == Integration_Ok) {
+        for (long i = 0; i < set_count; i++) {
+            struct Integration_Result result;
+            int rc = integrate_sweep_finish(work.states + i, work.part_count, set_count, start,
+                                            end, options, &result);
+            values[i] = result.value;
+            if (errors != NULL) { errors[i] = result.error_estimate; }
+            if (summary != NULL) {
+                summary->evaluations += result.evaluations;
+                summary->nan_results += result.nan_results;
+                summary->inf_results += result.inf_results;
+                if (rc == Integration_Not_Finite) { summary->not_finite++; }
+            }
+        }
+    }
+
+    free(work.states);
+    return status;
+}
+
+/*
+ * Function: sweep_default_threads()
+ *
+ * Description: The number of threads a sweep uses if it isn't told: one per processor
+ * Parameters: none
+ * Returns: The number of threads
+ */
+
+int sweep_default_threads() {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return (processors > 0) ? (int)processors : 1;
+}
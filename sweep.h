@@ -0,0 +1,49 @@
+#ifndef SWEEP_H_INCLUDED
+#define SWEEP_H_INCLUDED // Include guards
+
+#include "parser.h" // struct Program
+#include "integrate.h"
+#include "vector.h" // VECTOR_BLOCK
+
+// ------ Parameter sweeps ------
+// Integrating f(x; p) for thousands of sets of parameters p one at a time means writing each set's
+// values into the expression and compiling it again. A sweep instead compiles the expression once,
+// with its parameters left in it (see compile_parameterized()), and integrates it for every set at
+// once. The evaluator runs across VECTOR_BLOCK sets at each point of the grid rather than along the
+// grid (see evaluate_rpn_parameters()), so anything that depends only on x is worked out once per
+// point for all of them.
+//
+// The work is split into items, each a block of sets over part of the grid, which threads take in
+// turn. The grid is only split up when there are too few blocks of sets to keep the threads busy,
+// and how it is split doesn't depend on the number of threads, so the results don't either. When
+// it isn't split, each set's integral is exactly what integrating the expression with that set's
+// values written into it gives (with --numeric).
+
+// Grid points in each part of the grid, at most (a multiple of VECTOR_BLOCK, so that the points go
+// in the same blocks however the grid is split)
+#define SWEEP_PART_POINTS (256 * VECTOR_BLOCK)
+
+// Items a sweep is split into, at least, if the grid is long enough to split up
+#define SWEEP_TARGET_ITEMS 256
+
+// Most parameters an expression can have
+#define SWEEP_MAX_PARAMETERS 16
+
+// --- Type declarations ---
+
+// Totals over all the sets of a sweep
+struct Sweep_Summary {
+    long evaluations; // Of the expression, for each set at each point
+    long nan_results, inf_results;
+    long not_finite; // Sets stopped by a NaN or infinity (with Non_Finite_Stop), whose value is NaN
+};
+
+// --- Function declarations ---
+
+int sweep_integrate(const struct Program *program, const double *parameters,
+                    int parameter_count, long set_count, double start, double end,
+                    const struct Integration_Options *options, int threads, double *values,
+                    double *errors, struct Sweep_Summary *summary);
+int sweep_default_threads();
+
+#endif
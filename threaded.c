@@ -0,0 +1,219 @@
+#include <math.h>
+#include "threaded.h"
+#include "functions.h"
+#include "token.h"
+
+// Computed goto is a GCC extension (which clang has too); anything else gets the switch
+#if defined(__GNUC__)
+#define THREADED_DISPATCH 1
+#endif
+
+// Values on the stack kept on the C stack; only deeper programs use scratch memory
+#define LOCAL_STACK_SIZE 32
+
+#define ADD(l, r) ((l) + (r))
+#define SUBTRACT(l, r) ((l) - (r))
+#define MULTIPLY(l, r) ((l) * (r))
+#define DIVIDE(l, r) ((l) / (r))
+
+// ------ Threaded evaluation definitions ------
+
+#ifdef THREADED_DISPATCH
+#define CASE(name) label_##name
+#define NEXT() goto *(op = ip++)->handler
+#define HANDLER_ADDRESS(name) [Threaded_##name] = &&label_##name,
+#else
+#define CASE(name) case Threaded_##name
+#define NEXT() continue
+#endif
+
+// The six instructions for one operator (see enum Threaded_Opcode). The stack holds every value
+// but the one on top, which is in `top`; sp is the next free entry.
+#define BINARY_HANDLERS(Name, combine)                                                           \
+    CASE(Name): top = combine(sp[-1], top); sp--; NEXT();                                        \
+    CASE(Name##_Number): top = combine(top, op->value); NEXT();                                  \
+    CASE(Name##_Variable): top = combine(top, x); NEXT();                                        \
+    CASE(Variable_##Name##_Number): *sp++ = top; top = combine(x, op->value); NEXT();            \
+    CASE(Number_##Name##_Variable): *sp++ = top; top = combine(op->value, x); NEXT();            \
+    CASE(Variable_##Name##_Variable): *sp++ = top; top = combine(x, x); NEXT();
+
+/*
+ * Function: run(ip, x, stack, handlers)
+ *
+ * Description: Runs threaded code. The first push puts whatever was in `top` (nothing) onto the
+ *              stack, so the stack needs as many entries as values on it at once.
+ *              Called with handlers set, it only writes out where each instruction's code is, for
+ *              threaded_compile(): the labels can't be seen outside this function.
+ * Parameters: ip - the first instruction
+ *             x - the value of x
+ *             stack - the stack, with room for the program's max_depth values
+ *             handlers - if not NULL, where the table of code addresses is written
+ * Returns: The value of the expression (0 for an empty program)
+ */
+
+static double run(const struct Threaded_Instruction *ip, double x, double *stack,
+                  const void *const **handlers) {
+#ifdef THREADED_DISPATCH
+    static const void *const table[Threaded_Opcode_Count] = {
+        THREADED_OPCODES(HANDLER_ADDRESS)
+    };
+#else
+    static const void *const table[Threaded_Opcode_Count] = { NULL };
+#endif
+    if (handlers != NULL) {
+        *handlers = table;
+        return 0;
+    }
+
+    const struct Threaded_Instruction *op;
+    double *sp = stack;
+    double top = 0;
+
+#ifdef THREADED_DISPATCH
+    NEXT();
+#else
+    for (;;) switch ((op = ip++)->opcode) {
+#endif
+    CASE(Number): *sp++ = top; top = op->value; NEXT();
+    CASE(Variable): *sp++ = top; top = x; NEXT();
+    CASE(Function): top = op->function(top); NEXT();
+    CASE(Variable_Function): *sp++ = top; top = op->function(x); NEXT();
+    CASE(Negate): top = -top; NEXT();
+
+    BINARY_HANDLERS(Add, ADD)
+    BINARY_HANDLERS(Subtract, SUBTRACT)
+    BINARY_HANDLERS(Multiply, MULTIPLY)
+    BINARY_HANDLERS(Divide, DIVIDE)
+    BINARY_HANDLERS(Power, pow)
+
+    CASE(End): return (sp == stack) ? 0 : top;
+#ifndef THREADED_DISPATCH
+    default: return NAN; // should never happen
+    }
+#endif
+}
+
+/*
+ * Function: is_binary(token)
+ *
+ * Description: Checks whether a token is an operator with two operands
+ * Parameters: token - the token, or NULL
+ * Returns: 1 if it is, 0 if not
+ */
+
+static inline int is_binary(const struct Token *token) {
+    return token != NULL && token->type == Operator && token->operator_type >= Op_Add &&
+           token->operator_type <= Op_Power;
+}
+
+/*
+ * Function: threaded_compile(program, code, threaded)
+ *
+ * Description: Translates a compiled expression into threaded code, merging runs of tokens into
+ *              superinstructions where it can
+ * Parameters: program - the compiled expression, which must be complete (as checked by the
+ *                       parser) and not have parameters
+ *             code - where the instructions are written, with room for program->length + 1
+ *             threaded - where the threaded program is written, pointing at code
+ * Returns: The number of instructions, or -1 if the program has parameters
+ */
+
+int threaded_compile(const struct Program *program, struct Threaded_Instruction *code,
+                     struct Threaded_Program *threaded) {
+    const void *const *handlers;
+    run(NULL, 0, NULL, &handlers);
+
+    int length = 0;
+    for (int t = 0; t < program->length; length++) {
+        const struct Token *a = &program->code[t];
+        const struct Token *b = (t + 1 < program->length) ? &program->code[t + 1] : NULL;
+        const struct Token *c = (t + 2 < program->length) ? &program->code[t + 2] : NULL;
+        struct Threaded_Instruction *instruction = &code[length];
+        int opcode;
+
+        if ((a->type == Variable || a->type == Number) && b != NULL &&
+            (b->type == Variable || b->type == Number) && is_binary(c) &&
+            !(a->type == Number && b->type == Number)) {
+            // Two operands and their operator
+            if (a->type == Variable && b->type == Number) {
+                opcode = Threaded_Variable_Add_Number;
+                instruction->value = b->value;
+            } else if (a->type == Number) {
+                opcode = Threaded_Number_Add_Variable;
+                instruction->value = a->value;
+            } else {
+                opcode = Threaded_Variable_Add_Variable;
+            }
+            opcode += c->operator_type;
+            t += 3;
+        } else if (a->type == Variable && b != NULL && b->type == Function) {
+            opcode = Threaded_Variable_Function;
+            instruction->function = function_table[b->function_type].scalar;
+            t += 2;
+        } else if (a->type == Number && is_binary(b)) {
+            opcode = Threaded_Add_Number + b->operator_type;
+            instruction->value = a->value;
+            t += 2;
+        } else if (a->type == Variable && is_binary(b)) {
+            opcode = Threaded_Add_Variable + b->operator_type;
+            t += 2;
+        } else if (a->type == Number) {
+            opcode = Threaded_Number;
+            instruction->value = a->value;
+            t++;
+        } else if (a->type == Variable) {
+            opcode = Threaded_Variable;
+            t++;
+        } else if (a->type == Function) {
+            opcode = Threaded_Function;
+            instruction->function = function_table[a->function_type].scalar;
+            t++;
+        } else if (a->type == Operator && a->operator_type == Op_Negate) {
+            opcode = Threaded_Negate;
+            t++;
+        } else if (is_binary(a)) {
+            opcode = Threaded_Add + a->operator_type;
+            t++;
+        } else {
+            return -1; // parameters (and brackets, which never make it into compiled code)
+        }
+
+        instruction->opcode = opcode;
+        instruction->handler = handlers[opcode];
+    }
+
+    code[length].opcode = Threaded_End;
+    code[length].handler = handlers[Threaded_End];
+    length++;
+
+    threaded->code = code;
+    threaded->length = length;
+    threaded->max_depth = program->max_depth;
+    return length;
+}
+
+/*
+ * Function: evaluate_threaded(threaded, x, scratch)
+ *
+ * Description: Evaluates threaded code at one value of x. Gives exactly what evaluate_rpn() gives
+ *              for the program it was translated from.
+ * Parameters: threaded - the threaded program, from threaded_compile()
+ *             x - the value of x
+ *             scratch - arena for the stack, if the program nests too deeply for the C stack;
+ *                       handed back before returning
+ * Returns: The value of the expression, or NaN if there wasn't enough memory for the stack
+ */
+
+double evaluate_threaded(const struct Threaded_Program *threaded, double x,
+                         struct Arena *scratch) {
+    if (threaded->max_depth <= LOCAL_STACK_SIZE) {
+        double stack[LOCAL_STACK_SIZE];
+        return run(threaded->code, x, stack, NULL);
+    }
+
+    struct Arena_Mark mark = arena_mark(scratch);
+    double *stack = arena_alloc(scratch, threaded->max_depth * sizeof(double));
+    double result = (stack != NULL) ? run(threaded->code, x, stack, NULL) : NAN;
+    arena_release(scratch, mark);
+    return result;
+}
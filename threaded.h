@@ -0,0 +1,73 @@
+#ifndef THREADED_H_INCLUDED
+#define THREADED_H_INCLUDED // Include guards
+
+#include "parser.h" // struct Program
+#include "arena.h"
+
+// ------ Threaded evaluation ------
+// evaluate_rpn() works out each token by going down an if/else chain on its type, and then a
+// switch on its operator: several branches per token, which the processor can't predict well,
+// since every token goes through the same ones. For one value of x at a time, this is faster:
+// the program is first translated into instructions that each hold the address of the code that
+// runs them, and each instruction jumps straight to the next one's code when it is done (direct
+// threading, with GCC's computed goto). Each jump has a branch of its own, which the processor
+// learns the pattern of. Without computed goto it falls back to one switch on the instruction.
+//
+// The value on top of the stack is kept in a register rather than in the stack's memory, and the
+// commonest short runs of tokens are merged into single instructions (superinstructions), so
+// there are fewer instructions and most of them don't touch the stack's memory at all. In the
+// benchmark corpus these are an operator with x or a number as its right-hand operand (x 2 ^ in
+// polynomials, 2 / in exp(-x/2)), a number times x (3 x * in sin(3x)), x x *, c x ^, and a
+// function of x (x sin). Every instruction works out exactly what evaluate_rpn() does, in the
+// same order, so the results are the same bit for bit.
+//
+// It is only used where the program really is evaluated one x at a time: the library's
+// integration_evaluate(). Integration evaluates VECTOR_BLOCK points at once with the block
+// evaluator (or a native kernel), which already pays for each token once per block rather than
+// once per point, and the profiled evaluator has to run token by token to count them.
+
+// --- Type declarations ---
+
+// What each instruction does. An operator instruction's operands are the two values on top of
+// the stack, unless its name says otherwise: Multiply_Number is (top) * number,
+// Variable_Multiply_Number pushes x * number, and Number_Power_Variable pushes number ^ x.
+#define THREADED_BINARY(X, before, after)                                                        \
+    X(before##Add##after) X(before##Subtract##after) X(before##Multiply##after)                  \
+    X(before##Divide##after) X(before##Power##after)
+
+#define THREADED_OPCODES(X)                                                                      \
+    X(Number) X(Variable) X(Function) X(Variable_Function) X(Negate) X(End)                      \
+    THREADED_BINARY(X, , ) THREADED_BINARY(X, , _Number) THREADED_BINARY(X, , _Variable)         \
+    THREADED_BINARY(X, Variable_, _Number) THREADED_BINARY(X, Number_, _Variable)                \
+    THREADED_BINARY(X, Variable_, _Variable)
+
+#define THREADED_OPCODE_ENUM(name) Threaded_##name,
+
+// Each group of five operator instructions is in the order of enum Operator_Type, so that the
+// instruction for an operator is the group's first plus its operator_type
+enum Threaded_Opcode {
+    THREADED_OPCODES(THREADED_OPCODE_ENUM)
+    Threaded_Opcode_Count
+};
+
+struct Threaded_Instruction {
+    const void *handler; // The address of the code that runs it, for computed goto
+    int opcode; // enum Threaded_Opcode, for the switch without computed goto
+    double value; // The number, for instructions with one
+    double (*function)(double); // The function, for instructions with one
+};
+
+struct Threaded_Program {
+    const struct Threaded_Instruction *code; // Ending with Threaded_End
+    int length; // Instructions in code, including the Threaded_End
+    int max_depth; // Most values on the stack at once
+};
+
+// --- Function declarations ---
+
+int threaded_compile(const struct Program *program, struct Threaded_Instruction *code,
+                     struct Threaded_Program *threaded);
+double evaluate_threaded(const struct Threaded_Program *threaded, double x,
+                         struct Arena *scratch);
+
+#endif
@@ -1,13 +1,29 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h> // SIZE_MAX
+#include <limits.h>
 #include "token.h"
+#include "functions.h"
 
-double get_token_value(struct Token *token, double x) {
-    // Gets a tokens value - which is done in different ways depending on whether it's a number or
-    // a variable.
-    if (token->type == Number) { return token->value; }
-    else if (token->type == Variable) { return x; }
-    else { printf("bad RPN generated for expression"); exit(EXIT_FAILURE); } // should never happen
+// Function: max_tokens_for_length(expression_length)
+// Description: Upper bound on the number of tokens an expression can produce, used to size token
+//              arrays before tokenizing. Every character produces at most one token, and the only
+//              tokens that don't correspond to a character are the implicit multiplications, of
+//              which there can be at most one per character (e.g. '()()()' is 6 characters and 8
+//              tokens), so the bound is twice the length. Token counts are ints, and the array
+//              still has to have a size in bytes that fits in a size_t, so longer expressions than
+//              that are rejected.
+// Parameters: expression_length, the number of characters in the expression
+// Outputs: The maximum number of tokens, or 0 if the expression is too long (only an empty
+//          expression has 0 otherwise)
+
+size_t max_tokens_for_length(size_t expression_length) {
+    size_t longest = INT_MAX / 2;
+    if (longest > SIZE_MAX / (2 * sizeof(struct Token))) {
+        longest = SIZE_MAX / (2 * sizeof(struct Token));
+    }
+    if (expression_length > longest) { return 0; }
+    return 2 * expression_length;
 }
 
 // Function: print_tokenized(token_arr_ptr, token_count)
@@ -19,14 +35,12 @@ double get_token_value(struct Token *token, double x) {
 
 void print_tokenized(struct Token *token_arr_ptr, int token_count) {
     printf("["); // opening/closing brackets
-    struct Token token;
-    
-    // array is backwards due to being generated by popping a stack, so loop accordingly
-    for (int i = token_count-1; i >= 0; i--) {
+
+    for (int i = 0; i < token_count; i++) {
         print_token(token_arr_ptr+i);
 
         // Print separator
-        if (i != 0) {
+        if (i != token_count-1) {
             printf(", ");
         }
     }
@@ -51,27 +65,14 @@ void print_token(struct Token *token) {
                 printf("'+'"); break;
             case Op_Subtract:
                 printf("'-'"); break;
+            case Op_Negate:
+                printf("'neg'"); break;
             default:
                 break;
         }
     }
     else if (token->type == Function) {
-        switch (token->function_type) {
-            case Func_Sin:
-                printf("'sin'"); break;
-            case Func_Cos:
-                printf("'cos'"); break;
-            case Func_Tan:
-                printf("'tan'"); break;
-            case Func_Ln:
-                printf("'ln'"); break;
-            case Func_Exp:
-                printf("'exp'"); break;
-            case Func_Log:
-                printf("'log'"); break;
-            default:
-                break;
-        }
+        printf("'%s'", function_table[token->function_type].name);
     }
     else if (token->type == Bracket_Left) {
         printf("'('");
@@ -82,7 +83,14 @@ void print_token(struct Token *token) {
     else if (token->type == Variable) {
         printf("'x'");
     }
+    else if (token->type == Parameter) {
+        printf("'%.*s'", token->text_length, token->text);
+    }
     else if (token->type == Number) {
-        printf("'%.2f'", token->value);
+        if (token->text_length > 0) {
+            printf("'%.*s'", token->text_length, token->text); // as it was written
+        } else {
+            printf("'%.2f'", token->value);
+        }
     }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef TOKEN_H_INCLUDED
 #define TOKEN_H_INCLUDED // Include guards: block the same header from being included twice in a file
 
+#include <stddef.h> // size_t
+
 
 // --- Type declarations ---
 
@@ -10,7 +12,8 @@ enum Token_Type {
     Variable,
     Bracket_Left, // having a separate enum for bracket and (left, right) seems a bit silly to me
     Bracket_Right,
-    Function
+    Function,
+    Parameter // Only in programs compiled with parameters, which only sweeps run (see sweep.h)
 };
 
 enum Operator_Type {
@@ -18,7 +21,8 @@ enum Operator_Type {
     Op_Subtract,
     Op_Multiply,
     Op_Divide,
-    Op_Power
+    Op_Power,
+    Op_Negate // unary minus, the only operator that takes one operand
 };
 
 enum Function_Type {
@@ -27,7 +31,20 @@ enum Function_Type {
     Func_Tan,
     Func_Ln,
     Func_Exp,
-    Func_Log // log10
+    Func_Log, // log10
+    Func_Sqrt,
+    Func_Abs,
+    Func_Sinh,
+    Func_Cosh,
+    Func_Tanh,
+    Func_Asin,
+    Func_Acos,
+    Func_Atan,
+    // Named constants share the registry with functions (see functions.h), but never appear in a
+    // token as a function: the tokenizer substitutes their value as a Number
+    Const_Pi,
+    Const_E,
+    Func_Count // number of registry entries, not a real function
 };
 
 
@@ -45,7 +62,8 @@ enum Associativity {
 
 struct Token {
     enum Token_Type type;
-    // Number-exclusive property, but as Stack is monotype all tokens must have these properties
+    // Number-exclusive property, but as one struct is used for every kind of token all tokens must
+    // have these properties
     // They will be null/uninitialized for token types that don't use them, though
     double value; 
     // Operator-exclusive properties
@@ -54,11 +72,17 @@ struct Token {
     enum Associativity associativity;
     // Function-exclusive properties
     enum Function_Type function_type;
+    // Where the token came from: a span of the original expression string rather than a copy of
+    // it. Tokens the tokenizer inserts itself (implicit multiplication) have a length of 0
+    const char *text;
+    int text_length;
+    // Parameter-exclusive property: which of the parameters it is, from 0
+    int parameter;
 };
 
 // Functions
 
-double get_token_value(struct Token *token, double x);
+size_t max_tokens_for_length(size_t expression_length);
 void print_token(struct Token *token);
 void print_tokenized(struct Token *token, int num_tokens);
 
@@ -3,13 +3,65 @@
 #include <string.h>
 #include <math.h>
 #include <ctype.h>
-#define PCRE2_CODE_UNIT_WIDTH 8 // this comes before pcre2 include otherwise it breaks :/
-#include <pcre2.h> // perl-compatible regexes, more modern
-#include "stack.h"
 #include "tokenize.h"
-#include "shunting.h"
-
-// ------ Shunting yard / RPN-related definitions ------
+#include "functions.h"
+
+// ------ Tokenizer definitions ------
+
+// Numbers longer than this are parsed via a heap copy rather than a copy on the C stack
+#define NUMBER_BUFFER_SIZE 64
+
+// All preset tokens (i.e. all except numbers and functions)
+#pragma region Token_Defs
+
+static const struct Token bracket_l = {
+    .type = Bracket_Left,
+};
+static const struct Token bracket_r = {
+    .type = Bracket_Right,
+};
+static const struct Token power = {
+    .type = Operator,
+    .operator_type = Op_Power,
+    .precedence = 5,
+    .associativity = Assoc_Right
+};
+// Unary minus binds tighter than * and / but not ^, so -x^2 is -(x^2) and 2^-x is 2^(-x)
+static const struct Token negate = {
+    .type = Operator,
+    .operator_type = Op_Negate,
+    .precedence = 4,
+    .associativity = Assoc_Right
+};
+static const struct Token multiply = {
+    .type = Operator,
+    .operator_type = Op_Multiply,
+    .precedence = 3,
+    .associativity = Assoc_Left
+};
+static const struct Token divide = {
+    .type = Operator,
+    .operator_type = Op_Divide,
+    .precedence = 3,
+    .associativity = Assoc_Left
+};
+static const struct Token add = {
+    .type = Operator,
+    .operator_type = Op_Add,
+    .precedence = 2,
+    .associativity = Assoc_Left
+};
+static const struct Token subtract = {
+    .type = Operator,
+    .operator_type = Op_Subtract,
+    .precedence = 2,
+    .associativity = Assoc_Left
+};
+static const struct Token x_var = {
+    .type = Variable
+};
+
+#pragma endregion
 
 /*
  * ----------------------------------------------
@@ -17,353 +69,272 @@
  * ----------------------------------------------
  */
 
-// Function: exp_to_tokens(expression)
-// Description: Tokenizes expression, e.g. "3sin(0.1)" -> ["3", "sin", "(", "0.1", ")"]
-// Parameters: expression, the string to be tokenized
-// Outputs: A stack of all tokens
-
-int exp_to_tokens(char *expression, struct Token *tokenized) {
-    // Starting at the pointer for the string, run several regexes on the remainder of the string
-    // until a token is recognized. Then move the pointer forward by the number of characters
-    // in the recognized token, and repeat until the pointer points to \0
-    
-    // Initialize output
-    // Same idea for calculating max number of tokens
-    int max_tokens = (int)(ceil(strlen(expression) * 1.333333333));
-    struct Stack *output = init_stack(max_tokens); 
-    
-    // Initialize all preset tokens
-    // (i.e. all except numbers)
-    // Could do this as and when they are needed, but that would be during a loop so they'd get
-    // declared for every token which would make this O(n) rather than O(1)
-    // I'd also have liked to put this outside of the scope of the function, in a #define macro,
-    // but I don't think those support complex types like structs :(
-    #pragma region Token_Defs
-
-    const struct Token bracket_l = {
-        .type = Bracket_Left,
-    };
-    const struct Token bracket_r = {
-        .type = Bracket_Right,
-    };
-    const struct Token power = {
-        .type = Operator,
-        .operator_type = Op_Power,
-        .precedence = 4,
-        .associativity = Assoc_Right
-    };
-    const struct Token multiply = {
-        .type = Operator,
-        .operator_type = Op_Multiply,
-        .precedence = 3,
-        .associativity = Assoc_Left
-    };
-    const struct Token divide = {
-        .type = Operator,
-        .operator_type = Op_Divide,
-        .precedence = 3,
-        .associativity = Assoc_Left
-    };
-    const struct Token add = {
-        .type = Operator,
-        .operator_type = Op_Add,
-        .precedence = 2,
-        .associativity = Assoc_Left
-    };
-    const struct Token subtract = {
-        .type = Operator,
-        .operator_type = Op_Subtract,
-        .precedence = 2,
-        .associativity = Assoc_Left
-    };
-    const struct Token sin = {
-        .type = Function,
-        .function_type = Func_Sin
-    };
-    const struct Token cos = {
-        .type = Function,
-        .function_type = Func_Cos
-    };
-    const struct Token tan = {
-        .type = Function, 
-        .function_type = Func_Tan
-    };
-    const struct Token ln = {
-        .type = Function,
-        .function_type = Func_Ln
-    };
-    const struct Token log = {
-        .type = Function,
-        .function_type = Func_Log
-    };
-    const struct Token exp = {
-        .type = Function,
-        .function_type = Func_Exp
-    };
-    const struct Token x_var = {
-        .type = Variable
-    };
-
-    #pragma endregion
-
-    // Will also be helpful to keep track of the last token for filling in implicit multiplication
-    // i.e. "if last token was a number and this token is a function" for things like 4sin(45)
-    struct Token prev_token;
-    // Initialize regex options
-    int errornumber;
-    int find_all = 0; // only want one match from regexes
-    pcre2_match_data *match_data;
-    int rc1;
-    int rc2;
-    PCRE2_SPTR subject;
-    PCRE2_SIZE *ovector;
-
-    // Initialize all needed regexes outside of the loop for efficiency
-    // Number token regex:
-    // Match any number of digits, then, optionally, a decimal point followed by more digits
-    pcre2_code *num_regex_comp;
-    char *num_regex = "^\\d+(\\.\\d+)?"; 
-    compile_regex(num_regex, &num_regex_comp);
-
-    // Function token regex:
-    // Match functions in a list (much easier than matching any 2-3 chars and checking if valid)
-    pcre2_code *func_regex_comp;
-    char *func_regex = "^(sin|cos|tan|ln|exp|log)";
-    compile_regex(func_regex, &func_regex_comp);
-    
-    // The remaining possible tokens (brackets, operators, etc) are all one-character so don't need
-    // their own regex
-
-    // Loop of matching
-    while (expression != NULL && expression[0] != '\0') {
-        //printf("Operating on substring %s\n", expression);
-        switch(expression[0]) {
-            case '(':
-                // Implicit multiplication - if '4(' or ')(' is detected, substitute a * inbetween
-                if (prev_token.type == Number || prev_token.type == Bracket_Right) { 
-                    push_stack(output, multiply); 
-                }
+// Function: parse_number(text, length)
+// Description: Converts a span of digits (with optional decimal point) to a double. strtod() can't
+//              be given the span directly, as it would read past the end of it for input like
+//              '2e5' or '0x1', which here mean 2*e*5 and 0*x*1.
+// Parameters: text, length, the span containing the number
+// Outputs: The value of the number
+
+static double parse_number(const char *text, int length) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *copy = buffer;
+
+    if (length >= NUMBER_BUFFER_SIZE) {
+        copy = malloc(length + 1); // only for absurdly long literals
+        if (copy == NULL) { return NAN; }
+    }
+
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    double d = strtod(copy, NULL); // we know it's valid input so don't error check
+
+    if (copy != buffer) { free(copy); }
+    return d;
+}
+
+// Function: ends_operand(type) / starts_operand(type)
+// Description: Whether a token of this type can be the last/first token of an operand. A token
+//              that starts an operand straight after one that ends an operand means there is an
+//              implicit multiplication between them, e.g. '4(', ')(', 'x sin', '2pi'
+// Parameters: type, the token type
+// Outputs: 1 if so, 0 if not
+
+static int ends_operand(enum Token_Type type) {
+    return type == Number || type == Variable || type == Parameter || type == Bracket_Right;
+}
+
+static int starts_operand(enum Token_Type type) {
+    return type == Number || type == Variable || type == Parameter || type == Function ||
+           type == Bracket_Left;
+}
+
+// Function: lexer_init(lexer, expression, length)
+// Description: Prepares a lexer to read tokens from an expression
+// Parameters: lexer, the lexer to initialize
+//             expression, the string to be tokenized (need not be null-terminated)
+//             length, the number of characters in expression
+// Outputs: None
+
+void lexer_init(struct Lexer *lexer, const char *expression, size_t length) {
+    lexer->cursor = expression;
+    lexer->end = expression + length;
+    // The start of the expression behaves like the position after an operator
+    lexer->prev_type = Operator;
+    lexer->has_pending = 0;
+    lexer->parameters = NULL;
+    lexer->parameter_count = 0;
+}
+
+// Function: lexer_set_parameters(lexer, names, count)
+// Description: Gives the lexer names to read as parameters, e.g. a and b in 'a sin(b x)', each of
+//              which becomes a Parameter token numbered by its place in the list. A parameter's
+//              name is matched before a function's or constant's, so a parameter called e hides
+//              the constant.
+// Parameters: lexer, the lexer
+//             names, the parameters' names, which must be valid (see valid_parameter_name()), and
+//             must last as long as the lexer is used
+//             count, the number of names
+// Outputs: None
+
+void lexer_set_parameters(struct Lexer *lexer, const char *const *names, int count) {
+    lexer->parameters = names;
+    lexer->parameter_count = count;
+}
+
+// Function: valid_parameter_name(name)
+// Description: Whether a name can be used for a parameter: it must be letters only, so that it is
+//              read as one identifier, and can't start with x, which is always read as x
+// Parameters: name, the null-terminated name
+// Outputs: 1 if it can, 0 if not
+
+int valid_parameter_name(const char *name) {
+    if (name[0] == '\0' || name[0] == 'x') { return 0; }
+    for (const char *c = name; *c != '\0'; c++) {
+        if (!isalpha((unsigned char)*c)) { return 0; }
+    }
+    return 1;
+}
+
+// Function: lookup_parameter(lexer, name, length)
+// Description: Finds a parameter by name
+// Parameters: lexer, the lexer whose parameters to look through
+//             name, length, the name (need not be null-terminated)
+// Outputs: The parameter's number, or -1 if there isn't one called that
+
+static int lookup_parameter(const struct Lexer *lexer, const char *name, int length) {
+    for (int i = 0; i < lexer->parameter_count; i++) {
+        const char *parameter = lexer->parameters[i];
+        if (strncmp(parameter, name, length) == 0 && parameter[length] == '\0') { return i; }
+    }
+    return -1;
+}
+
+// Function: lexer_next(lexer, token)
+// Description: Reads the next token of the expression. Starting at the cursor, one token is
+//              recognized and the cursor moves forward by the number of characters in it, so
+//              reading a whole expression is linear in its length. The lexer also fills in what
+//              the expression leaves implicit, so that whatever consumes the tokens doesn't need
+//              to look back at the previous one:
+//                  * implicit multiplication, e.g. 4sin(x) gives the same tokens as 4*sin(x)
+//                  * unary minus (a '-' with no operand before it) becomes Op_Negate, and unary
+//                    plus is dropped
+// Parameters: lexer, the lexer to read from
+//             token, where the token is written
+// Outputs: Lex_Token if a token was read, Lex_End at the end of the expression, or Lex_Error if
+//          the character at the cursor isn't part of any token (the cursor is left on it)
+
+int lexer_next(struct Lexer *lexer, struct Token *token) {
+    // The token that followed an implicit multiplication
+    if (lexer->has_pending) {
+        lexer->has_pending = 0;
+        *token = lexer->pending;
+        lexer->prev_type = token->type;
+        return Lex_Token;
+    }
 
-                push_stack(output, bracket_l);
-                prev_token = bracket_l;
-                expression++; // Move forward 1 character
-                continue; // Next iteration of the loop
-            case ')':
-                push_stack(output, bracket_r);
-                prev_token = bracket_r;
-                expression++;
-                continue;
-            case '^':
-                push_stack(output, power);
-                prev_token = power;
-                expression++;
-                continue;
-            case '*':
-                push_stack(output, multiply);
-                prev_token = multiply;
-                expression++;
-                continue;
-            case '/':
-                push_stack(output, divide);
-                prev_token = divide;
-                expression++;
-                continue;
+    const char *expression = lexer->cursor;
+    struct Token read;
+    int read_length = 1;
+
+    while (1) {
+        if (expression >= lexer->end) {
+            lexer->cursor = expression;
+            return Lex_End;
+        }
+
+        int skip = 0;
+        switch (expression[0]) {
+            case '(': read = bracket_l; break;
+            case ')': read = bracket_r; break;
+            case '^': read = power; break;
+            case '*': read = multiply; break;
+            case '/': read = divide; break;
             case '+':
-                push_stack(output, add);
-                prev_token = add;
-                expression++;
-                continue;
+                // Unary plus doesn't do anything, so drop it
+                if (ends_operand(lexer->prev_type)) { read = add; } else { skip = 1; }
+                break;
             case '-':
-                push_stack(output, subtract);
-                prev_token = subtract;
-                expression++;
-                continue;
-            case 'x':
-                if (prev_token.type == Number || prev_token.type == Bracket_Right) {
-                    push_stack(output, multiply); 
-                }
-                push_stack(output, x_var);
-                prev_token = x_var;
-                expression++;
-                continue;
+                read = ends_operand(lexer->prev_type) ? subtract : negate;
+                break;
+            case 'x': read = x_var; break;
             case ' ': // no action required, move on
-                expression++;
-                continue;
-            default: // break out to regex statements
+            case '\t':
+            case '\n': // expressions read from files may span several lines
+            case '\r':
+                skip = 1;
+                break;
+            default: // break out to number/identifier matching
+                read_length = 0;
                 break;
         }
-        
-        // If none of those matched, then start using regex
-        // (this can only be reached by avoiding the above continues)
-
-        // Number regex
-        subject = (PCRE2_SPTR)expression;
-        match_data = pcre2_match_data_create_from_pattern(num_regex_comp, NULL);
-
-        rc1 = pcre2_match(
-            num_regex_comp,
-            expression,
-            strlen(expression),
-            0,
-            0,
-            match_data,
-            NULL
-        );
-        
-        // If number regex matched
-        if (rc1 > 0) {
-            ovector = pcre2_get_ovector_pointer(match_data);
-            //printf("Number match succeesed at offset %d\n", (int)ovector[0]);
-
-            // Normally this is done in a loop for match groups, but not interested in those, only
-            // the full match
-            PCRE2_SPTR substring_start = subject + ovector[0];
-            size_t substring_length = ovector[1] - ovector[0];
-            
-            // End disclaimer, this next bit I understand 
-            // Make a space to copy the string into               
-            char *substring = malloc(substring_length * sizeof(char));
-            memcpy(substring, substring_start, substring_length);
-
-            // Convert said string to a double
-            double d = strtod(substring, NULL); // we know it's valid input so don't error check
-            // No longer need it, so
-            free(substring);
-            //printf("\tMatch found (length %d): %f\n", substring_length, d);
-
-            struct Token num_token = {
-                .type = Number,
-                .value = d
-            };
 
-            push_stack(output, num_token);
-            prev_token = num_token;
-            expression += substring_length;
+        if (!skip) { break; }
+        expression++;
+    }
 
-            pcre2_match_data_free(match_data);
-            continue;
-        }
+    // If none of those matched, it must be a number or an identifier
+    if (read_length == 0) {
+        int remaining = (int)(lexer->end - expression);
 
-        match_data = pcre2_match_data_create_from_pattern(func_regex_comp, NULL);
-        
-        rc2 = pcre2_match(
-            func_regex_comp,
-            expression,
-            strlen(expression),
-            0,
-            0,
-            match_data,
-            NULL
-        );
-
-        // If function regex matched
-        if (rc2 > 0) {
-            if (prev_token.type == Number || prev_token.type == Bracket_Right) {
-                // Implicit multiplication again, checking for e.g. '4sin' or ')sin'
-                push_stack(output, multiply);
+        // Number: any number of digits, then, optionally, a decimal point followed by more digits
+        if (isdigit((unsigned char)expression[0])) {
+            while (read_length < remaining && isdigit((unsigned char)expression[read_length])) {
+                read_length++;
             }
-            ovector = pcre2_get_ovector_pointer(match_data);
-            PCRE2_SPTR substring_start = subject + ovector[0];
-            size_t substring_length = ovector[1] - ovector[0];
-
-            char *substring = malloc(substring_length * sizeof(char));
-            memcpy(substring, substring_start, substring_length);
-            substring[substring_length] = 0; // memcpy didn't add the terminating character
-
-            // Convert said string to a token
-            // Bit messy. Would've preferred to use cases but you can't in C because Dennis Ritchie
-            // clearly had something against second-year university students enjoying life when he 
-            // decided to make strings arrays meaning they can't be used in switches
-            enum Function_Type ft;
-
-            // Lowercase the substring in case people choose to write things weirdly
-            for (int i = 0; i < substring_length; i++) {
-                substring[i] = tolower(substring[i]);
+            if (read_length + 1 < remaining && expression[read_length] == '.' &&
+                isdigit((unsigned char)expression[read_length + 1])) {
+                read_length++;
+                while (read_length < remaining &&
+                       isdigit((unsigned char)expression[read_length])) {
+                    read_length++;
+                }
             }
-            
-            // printf("Found match for function regex of length %d\n", substring_length);
-            
-
-            if (strcmp(substring, "sin") == 0) { ft = Func_Sin; }
-            else if (strcmp(substring, "cos") == 0) { ft = Func_Cos; }
-            else if (strcmp(substring, "tan") == 0) { ft = Func_Tan; }
-            else if (strcmp(substring, "ln") == 0) { ft = Func_Ln; }
-            else if (strcmp(substring, "exp") == 0) { ft = Func_Exp; }
-            else if (strcmp(substring, "log") == 0) { ft = Func_Log; }
-
-            struct Token func_token = {
-                .type = Function,
-                .function_type = ft
-            };
-
-            push_stack(output, func_token);
-            prev_token = func_token;
-            expression += substring_length;
 
-            free(substring);
-            pcre2_match_data_free(match_data);
-            continue;
-        }
+            read = (struct Token){
+                .type = Number,
+                .value = parse_number(expression, read_length)
+            };
+        } else {
+            // Identifier: take the run of letters and find the longest prefix of it which names a
+            // registered function or constant, so that e.g. 'pix' is read as 'pi' then 'x'
+            while (read_length < remaining && isalpha((unsigned char)expression[read_length])) {
+                read_length++;
+            }
 
-        // Now, the only way you can be down here is if something went quite wrong
+            int ft = -1;
+            int parameter = -1;
+            while (read_length > 0) {
+                parameter = lookup_parameter(lexer, expression, read_length);
+                if (parameter >= 0) { break; }
+                ft = lookup_function(expression, read_length);
+                if (ft >= 0) { break; }
+                read_length--;
+            }
 
-        if (rc1 == PCRE2_ERROR_NOMATCH && rc2 == PCRE2_ERROR_NOMATCH) { 
-            printf("Unrecognized token found in input expression: '%c'\n", expression[0]);
-            expression++;
-        }    
-        else if (rc1 != PCRE2_ERROR_NOMATCH && rc2 != PCRE2_ERROR_NOMATCH) {
-            printf("Something went wrong in either regex match attempt for token %c \
-            (rc1 = %d / rc2 = %d)", expression[0], rc1, rc2);
-            expression++;
+            if (parameter >= 0) {
+                read = (struct Token){
+                    .type = Parameter,
+                    .parameter = parameter
+                };
+            } else if (ft < 0) {
+                // Now, the only way you can be down here is if the character isn't part of any
+                // token
+                lexer->cursor = expression;
+                return Lex_Error;
+            } else if (function_table[ft].arity == 0) {
+                // Constants go straight into the expression as their value
+                read = (struct Token){
+                    .type = Number,
+                    .value = function_table[ft].value
+                };
+            } else {
+                read = (struct Token){
+                    .type = Function,
+                    .function_type = ft
+                };
+            }
         }
-
-        pcre2_match_data_free(match_data);
     }
 
-    // printf("Iteration complete. Popping stack of size %d\n", get_stack_size(output));
-    // Take the output stack and pop it into an array at the address `tokenized`
-    // Note that because this array is generated by taking the elements popped off the top of the
-    // stack first, it's actually backwards compared to the input
-    // The reason why we generate an array even though shunting yard, where it goes next, uses
-    // stacks: it's not possible to iterate through the elements of my Stack type without modifying
-    // it, which makes it impossible to debug the program :(
-    int i = 0;
-    // printf("i = ");
-    while (!is_stack_empty(output)) {
-        // printf("%d...", get_stack_size(output));
-        // Write to the pointer given to the function (expected to be from malloc)
-        struct Token value = pop_stack(output);
-        memcpy(tokenized + i, &value, sizeof(value));
-        i++;
-    }
+    read.text = expression;
+    read.text_length = read_length;
+    lexer->cursor = expression + read_length;
 
-    // We're now done with the stack + others, so free the memory
-    delete_stack(output);
+    if (ends_operand(lexer->prev_type) && starts_operand(read.type)) {
+        // Implicit multiplication: hand back a * first, and the token just read next time
+        lexer->pending = read;
+        lexer->has_pending = 1;
 
-    pcre2_code_free(num_regex_comp);
-    pcre2_code_free(func_regex_comp);
+        *token = multiply;
+        token->text = expression;
+        token->text_length = 0;
+    } else {
+        *token = read;
+    }
 
-    return i;
+    lexer->prev_type = token->type;
+    return Lex_Token;
 }
 
-// Function: compile_regex
-// Description: Compiles and optimizes (by way of pcre_study) a regex & handles any errors
-// Parameters: regex_str, the string literal regular expression,
-//             output, the pointer to the pcre object which the compilation result is saved to
-// Outputs: None
+// Function: exp_to_tokens(expression, length, tokenized)
+// Description: Tokenizes expression, e.g. "3sin(0.1)" -> ["3", "*", "sin", "(", "0.1", ")"]
+// Parameters: expression, the string to be tokenized (need not be null-terminated)
+//             length, the number of characters in expression
+//             tokenized, the array to write the tokens to, with room for at least
+//             max_tokens_for_length(length) tokens
+// Outputs: The number of tokens written, which are in the same order as the expression, or
+//          Lex_Error if an unrecognized character was found
+
+int exp_to_tokens(const char *expression, size_t length, struct Token *tokenized) {
+    struct Lexer lexer;
+    lexer_init(&lexer, expression, length);
 
-void compile_regex(char *regex_str, pcre2_code **output) {
-    int error_num;
-    PCRE2_SIZE error_offset;
-    
-    PCRE2_SPTR pattern = (PCRE2_SPTR)regex_str;
-    *output = pcre2_compile(pattern, PCRE2_ZERO_TERMINATED, 0, &error_num, &error_offset, NULL);
-
-    if (output == NULL) {
-        PCRE2_UCHAR buffer[256];
-        pcre2_get_error_message(error_num, buffer, sizeof(buffer));
-        printf("Regex compilation error (offset = %d): could not compile regex '%s': %s\n",
-            (int)error_offset, buffer);
-        exit(EXIT_FAILURE);
+    int i = 0;
+    int rc;
+    while ((rc = lexer_next(&lexer, tokenized + i)) == Lex_Token) {
+        i++;
     }
+
+    return (rc == Lex_Error) ? Lex_Error : i;
 }
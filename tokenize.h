@@ -1,12 +1,36 @@
 #ifndef RPN_H_INCLUDED
 #define RPN_H_INCLUDED // Include guards: block the same header from being included twice in a file
 
-#define PCRE2_CODE_UNIT_WIDTH 8
-#include <pcre2.h> // type references
+#include <stddef.h> // size_t
 #include "token.h"
-#include "stack.h"
 
-int exp_to_tokens(char *input_exp, struct Token *output_token_arr_ptr);
-void compile_regex(char *regex_str, pcre2_code **output_re);
+// --- Type declarations ---
 
-#endif
\ No newline at end of file
+// Return codes of lexer_next()
+enum Lex_Result {
+    Lex_Error = -1,
+    Lex_End = 0,
+    Lex_Token = 1
+};
+
+// A lexer reads an expression one token at a time, so that it can be fed straight into the
+// shunting-yard algorithm without building an array of tokens first
+struct Lexer {
+    const char *cursor; // Next character to read
+    const char *end; // One past the last character of the expression
+    enum Token_Type prev_type; // Type of the last token handed out
+    struct Token pending; // Token to hand out after an implicit multiplication
+    int has_pending;
+    const char *const *parameters; // Names read as Parameter tokens (see lexer_set_parameters())
+    int parameter_count;
+};
+
+// --- Function declarations ---
+
+void lexer_init(struct Lexer *lexer, const char *expression, size_t length);
+void lexer_set_parameters(struct Lexer *lexer, const char *const *names, int count);
+int valid_parameter_name(const char *name);
+int lexer_next(struct Lexer *lexer, struct Token *token);
+int exp_to_tokens(const char *input_exp, size_t length, struct Token *output_token_arr_ptr);
+
+#endif
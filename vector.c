@@ -0,0 +1,200 @@
+#include <string.h>
+#include <math.h>
+#include "vector.h"
+#include "functions.h"
+#include "token.h"
+
+// ------ Block evaluation definitions ------
+// Both evaluators are generated from one definition, as with DEFINE_STACK. The loops are marked
+// `omp simd` (which needs only -fopenmp-simd, not OpenMP itself) so that they are vectorized
+// whatever the optimization level's cost model thinks.
+
+#define SIMD_LOOP _Pragma("omp simd")
+
+/*
+ * Function: name(program, x, values, count, scratch)
+ *
+ * Description: Evaluates a compiled expression at `count` values of x, VECTOR_BLOCK at a time
+ * Parameters: program - the compiled expression, which must be complete (as checked by the parser)
+ *             x - the values of x
+ *             values - where the values of the expression are written (may be the same as x)
+ *             count - the number of values
+ *             scratch - arena for the operand stack, handed back before returning
+ * Returns: 0 on success, -1 if there wasn't enough memory for the operand stack
+ */
+
+#define DEFINE_BLOCK_EVALUATOR(name, Type, vector_fn, pow_fn)                                     \
+                                                                                                 \
+int name(const struct Program *program, const Type *x, Type *values, int count,                  \
+         struct Arena *scratch) {                                                                \
+    struct Arena_Mark mark = arena_mark(scratch);                                                \
+    int max_depth = (program->max_depth > 0) ? program->max_depth : 1;                           \
+    Type *stack = arena_alloc(scratch, (size_t)max_depth * VECTOR_BLOCK * sizeof(Type));         \
+    if (stack == NULL) { return -1; }                                                            \
+                                                                                                 \
+    for (int done = 0; done < count; done += VECTOR_BLOCK) {                                     \
+        int n = (count - done < VECTOR_BLOCK) ? count - done : VECTOR_BLOCK;                     \
+        Type *top = stack; /* the next free block of the stack */                                \
+                                                                                                 \
+        for (int t = 0; t < program->length; t++) {                                              \
+            const struct Token *token = &program->code[t];                                       \
+                                                                                                 \
+            if (token->type == Number) {                                                         \
+                Type value = (Type)token->value;                                                 \
+                SIMD_LOOP for (int i = 0; i < n; i++) { top[i] = value; }                        \
+                top += VECTOR_BLOCK;                                                             \
+            } else if (token->type == Variable) {                                                \
+                memcpy(top, x + done, n * sizeof(Type));                                         \
+                top += VECTOR_BLOCK;                                                             \
+            } else if (token->type == Function) {                                                \
+                function_table[token->function_type].vector_fn(top - VECTOR_BLOCK, n);          \
+            } else if (token->operator_type == Op_Negate) {                                      \
+                Type *a = top - VECTOR_BLOCK;                                                    \
+                SIMD_LOOP for (int i = 0; i < n; i++) { a[i] = -a[i]; }                          \
+            } else {                                                                             \
+                /* Binary operator: a = a (op) b, where b is on top */                           \
+                Type *a = top - 2 * VECTOR_BLOCK;                                                \
+                const Type *b = top - VECTOR_BLOCK;                                              \
+                switch (token->operator_type) {                                                  \
+                    case Op_Add:                                                                 \
+                        SIMD_LOOP for (int i = 0; i < n; i++) { a[i] += b[i]; }                  \
+                        break;                                                                   \
+                    case Op_Subtract:                                                            \
+                        SIMD_LOOP for (int i = 0; i < n; i++) { a[i] -= b[i]; }                  \
+                        break;                                                                   \
+                    case Op_Multiply:                                                            \
+                        SIMD_LOOP for (int i = 0; i < n; i++) { a[i] *= b[i]; }                  \
+                        break;                                                                   \
+                    case Op_Divide:                                                              \
+                        SIMD_LOOP for (int i = 0; i < n; i++) { a[i] /= b[i]; }                  \
+                        break;                                                                   \
+                    case Op_Power:                                                               \
+                        for (int i = 0; i < n; i++) { a[i] = pow_fn(a[i], b[i]); }               \
+                        break;                                                                   \
+                    default:                                                                     \
+                        for (int i = 0; i < n; i++) { a[i] = NAN; } /* should never happen */    \
+                        break;                                                                   \
+                }                                                                                \
+                top -= VECTOR_BLOCK;                                                             \
+            }                                                                                    \
+        }                                                                                        \
+                                                                                                 \
+        /* The result is the lone block left on the stack (or nothing, for an empty program) */ \
+        if (top == stack) { memset(values + done, 0, n * sizeof(Type)); }                        \
+        else { memcpy(values + done, stack, n * sizeof(Type)); }                                 \
+    }                                                                                            \
+                                                                                                 \
+    arena_release(scratch, mark);                                                                \
+    return 0;                                                                                    \
+}
+
+DEFINE_BLOCK_EVALUATOR(evaluate_rpn_block, double, vector, pow)
+DEFINE_BLOCK_EVALUATOR(evaluate_rpn_block_float, float, vector_float, powf)
+
+// A binary operator applied to the top two entries of evaluate_rpn_parameters()'s stack, a = a
+// (op) b, where either, both or neither may be uniform. Only a uniform a and a uniform b leaves a
+// uniform result.
+#define PARAMETER_BINARY(loop, combine)                                                          \
+    if (*a_uniform && *b_uniform) {                                                              \
+        double l = *a_scalar, r = *b_scalar;                                                     \
+        *a_scalar = combine(l, r);                                                               \
+    } else if (*a_uniform) {                                                                     \
+        double l = *a_scalar;                                                                    \
+        loop for (int i = 0; i < n; i++) { double r = b[i]; a[i] = combine(l, r); }             \
+        *a_uniform = 0;                                                                          \
+    } else if (*b_uniform) {                                                                     \
+        double r = *b_scalar;                                                                    \
+        loop for (int i = 0; i < n; i++) { double l = a[i]; a[i] = combine(l, r); }             \
+    } else {                                                                                     \
+        loop for (int i = 0; i < n; i++) { double l = a[i], r = b[i]; a[i] = combine(l, r); }    \
+    }
+
+#define ADD(l, r) ((l) + (r))
+#define SUBTRACT(l, r) ((l) - (r))
+#define MULTIPLY(l, r) ((l) * (r))
+#define DIVIDE(l, r) ((l) / (r))
+
+/*
+ * Function: evaluate_rpn_parameters(program, x, parameters, values, n, scratch)
+ *
+ * Description: Evaluates a compiled expression with parameters (see compile_parameterized()) at
+ *              one value of x, for n sets of values of its parameters at once: here the block
+ *              runs across the sets of parameters rather than along x. Anything that doesn't
+ *              depend on the parameters (numbers, x, and whatever is worked out from only those,
+ *              like sin(x) and cos(x) in a sin(x) + b cos(x)) is the same for the whole block, so
+ *              it is kept as a single value and worked out once, not once per set.
+ * Parameters: program - the compiled expression, which must be complete (as checked by the parser)
+ *             x - the value of x
+ *             parameters - the sets of values, one block per parameter: parameter k of set i is
+ *                          parameters[k * VECTOR_BLOCK + i]
+ *             values - where the value for each set is written
+ *             n - the number of sets, at most VECTOR_BLOCK
+ *             scratch - arena for the operand stack, handed back before returning
+ * Returns: 0 on success, -1 if there wasn't enough memory for the operand stack
+ */
+
+int evaluate_rpn_parameters(const struct Program *program, double x, const double *parameters,
+                            double *values, int n, struct Arena *scratch) {
+    struct Arena_Mark mark = arena_mark(scratch);
+    int max_depth = (program->max_depth > 0) ? program->max_depth : 1;
+    double *stack = arena_alloc(scratch, (size_t)max_depth * VECTOR_BLOCK * sizeof(double));
+    double *scalars = arena_alloc(scratch, max_depth * sizeof(double)); // of uniform entries
+    char *uniform = arena_alloc(scratch, max_depth);
+    if (stack == NULL || scalars == NULL || uniform == NULL) {
+        arena_release(scratch, mark);
+        return -1;
+    }
+
+    int depth = 0;
+    for (int t = 0; t < program->length; t++) {
+        const struct Token *token = &program->code[t];
+        double *next = stack + (size_t)depth * VECTOR_BLOCK; // the next free entry
+        double *top = (depth > 0) ? next - VECTOR_BLOCK : stack; // the entry on top
+
+        if (token->type == Number || token->type == Variable) {
+            uniform[depth] = 1;
+            scalars[depth] = (token->type == Number) ? token->value : x;
+            depth++;
+        } else if (token->type == Parameter) {
+            uniform[depth] = 0;
+            memcpy(next, parameters + (size_t)token->parameter * VECTOR_BLOCK,
+                   n * sizeof(double));
+            depth++;
+        } else if (token->type == Function) {
+            const struct Function_Def *function = &function_table[token->function_type];
+            if (uniform[depth - 1]) { scalars[depth - 1] = function->scalar(scalars[depth - 1]); }
+            else { function->vector(top, n); }
+        } else if (token->operator_type == Op_Negate) {
+            if (uniform[depth - 1]) { scalars[depth - 1] = -scalars[depth - 1]; }
+            else { SIMD_LOOP for (int i = 0; i < n; i++) { top[i] = -top[i]; } }
+        } else {
+            double *a = top - VECTOR_BLOCK;
+            const double *b = top;
+            char *a_uniform = &uniform[depth - 2], *b_uniform = &uniform[depth - 1];
+            double *a_scalar = &scalars[depth - 2], *b_scalar = &scalars[depth - 1];
+            switch (token->operator_type) {
+                case Op_Add: PARAMETER_BINARY(SIMD_LOOP, ADD) break;
+                case Op_Subtract: PARAMETER_BINARY(SIMD_LOOP, SUBTRACT) break;
+                case Op_Multiply: PARAMETER_BINARY(SIMD_LOOP, MULTIPLY) break;
+                case Op_Divide: PARAMETER_BINARY(SIMD_LOOP, DIVIDE) break;
+                case Op_Power: PARAMETER_BINARY(, pow) break;
+                default: // should never happen
+                    *a_uniform = 1;
+                    *a_scalar = NAN;
+                    break;
+            }
+            depth--;
+        }
+    }
+
+    // The result is the lone entry left on the stack (or nothing, for an empty program)
+    if (depth == 0 || uniform[0]) {
+        double value = (depth == 0) ? 0 : scalars[0];
+        SIMD_LOOP for (int i = 0; i < n; i++) { values[i] = value; }
+    } else {
+        memcpy(values, stack, n * sizeof(double));
+    }
+
+    arena_release(scratch, mark);
+    return 0;
+}
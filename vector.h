@@ -0,0 +1,33 @@
+#ifndef VECTOR_H_INCLUDED
+#define VECTOR_H_INCLUDED // Include guards
+
+#include "parser.h" // struct Program
+#include "arena.h"
+
+// ------ Block evaluation ------
+// evaluate_rpn() works out one value of x at a time, so every token costs a branch on its type
+// and an indirect call or switch. These evaluators instead run each token over a whole block of
+// x values, so that the per-token overhead is paid once per block and each token is a simple loop
+// over an array, which the compiler turns into SIMD instructions. The operand stack holds one
+// block per entry; the program's max_depth says how many are needed.
+//
+// evaluate_rpn_block_float() does the same in single precision, which fits twice as many values
+// into each SIMD register (and is correct to about 7 significant figures).
+//
+// evaluate_rpn_parameters() runs the block across sets of values of an expression's parameters
+// instead, at one value of x, for sweeps over many sets (see sweep.h).
+
+// Number of values of x evaluated together. Small enough that the operand stack stays in the
+// L1 cache for typical expressions.
+#define VECTOR_BLOCK 64
+
+// --- Function declarations ---
+
+int evaluate_rpn_block(const struct Program *program, const double *x, double *values, int count,
+                       struct Arena *scratch);
+int evaluate_rpn_block_float(const struct Program *program, const float *x, float *values,
+                             int count, struct Arena *scratch);
+int evaluate_rpn_parameters(const struct Program *program, double x, const double *parameters,
+                            double *values, int n, struct Arena *scratch);
+
+#endif
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "workers.h"
+
+// Chunks each worker claims in a round, on average. More even out the workers' finishing times,
+// fewer mean less contention on the counter.
+#define CHUNKS_PER_WORKER 8
+
+// ------ Worker process definitions ------
+
+/*
+ * Function: job_pool_create(job_count)
+ *
+ * Description: Creates a pool of jobs in memory that will be shared with the workers. The caller
+ *              fills in each job's line and length before running them.
+ * Parameters: job_count - the number of jobs
+ * Returns: The pool, or NULL if the shared memory couldn't be mapped
+ */
+
+struct Job_Pool *job_pool_create(long job_count) {
+    size_t size = sizeof(struct Job_Pool) + job_count * (sizeof(struct Job) + sizeof(long));
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) { return NULL; }
+
+    // Anonymous mappings start out zeroed, so every job is already Job_Waiting with no attempts
+    struct Job_Pool *pool = memory;
+    pool->job_count = job_count;
+    pool->jobs = (struct Job *)(pool + 1);
+    pool->order = (long *)(pool->jobs + job_count);
+    pool->size = size;
+    for (long i = 0; i < job_count; i++) { atomic_init(&pool->jobs[i].state, Job_Waiting); }
+    atomic_init(&pool->next, 0);
+
+    return pool;
+}
+
+/*
+ * Function: is_interrupted(interrupted)
+ *
+ * Description: Reads the interrupted flag, which may not have been given
+ * Parameters: interrupted - the flag, or NULL
+ * Returns: 1 if the flag was given and is set, otherwise 0
+ */
+
+static inline int is_interrupted(const volatile sig_atomic_t *interrupted) {
+    return interrupted != NULL && *interrupted;
+}
+
+/*
+ * Function: run_worker(pool, function, context, interrupted)
+ *
+ * Description: A worker's loop: claims chunks of jobs from the pool and runs them until there are
+ *              none left (or it is interrupted, which leaves the rest of its chunk waiting). A job
+ *              whose output doesn't fit in JOB_OUTPUT_SIZE gets an error as its output instead.
+ * Parameters: pool - the job pool
+ *             function, context - what runs each job
+ *             interrupted - stops the worker once set, or NULL
+ * Returns: none
+ */
+
+static void run_worker(struct Job_Pool *pool, Job_Function function, void *context,
+                       const volatile sig_atomic_t *interrupted) {
+    pid_t self = getpid();
+
+    while (!is_interrupted(interrupted)) {
+        long first = atomic_fetch_add(&pool->next, pool->chunk);
+        if (first >= pool->order_count) { break; }
+        long last = (first + pool->chunk < pool->order_count) ? first + pool->chunk :
+                                                                pool->order_count;
+
+        for (long i = first; i < last && !is_interrupted(interrupted); i++) {
+            struct Job *job = &pool->jobs[pool->order[i]];
+            job->worker = self;
+            job->attempts++;
+            atomic_store(&job->state, Job_Running);
+
+            FILE *output = fmemopen(job->output, JOB_OUTPUT_SIZE, "w");
+            if (output == NULL) {
+                snprintf(job->output, JOB_OUTPUT_SIZE, "error: out of memory\n");
+            } else {
+                function(job->line, job->length, output, context);
+                // A write past the end of the buffer fails, and one that fills it leaves no room
+                // for the '\0', so either way the output has been cut short
+                int too_long = fflush(output) != 0 || ftell(output) >= JOB_OUTPUT_SIZE;
+                fclose(output);
+                if (too_long) {
+                    snprintf(job->output, JOB_OUTPUT_SIZE, "error: output too long (over %d "
+                             "characters)\n", JOB_OUTPUT_SIZE - 1);
+                }
+            }
+            job->output[JOB_OUTPUT_SIZE - 1] = '\0';
+
+            atomic_store(&job->state, Job_Done);
+        }
+    }
+}
+
+/*
+ * Function: start_worker(pool, function, context, interrupted)
+ *
+ * Description: Forks a worker process, which runs jobs from the pool and then exits
+ * Parameters: as run_worker()
+ * Returns: The worker's process ID, or -1 if it couldn't be started
+ */
+
+static pid_t start_worker(struct Job_Pool *pool, Job_Function function, void *context,
+                          const volatile sig_atomic_t *interrupted) {
+    // Otherwise anything still buffered would be written by the worker as well
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_worker(pool, function, context, interrupted);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(EXIT_SUCCESS); // skips atexit handlers and buffers that belong to the parent
+    }
+    return pid;
+}
+
+/*
+ * Function: worker_crashed(pool, pid, status)
+ *
+ * Description: Deals with a worker that has stopped: any job it was still running goes back
+ *              to waiting, to be tried again, unless it has had JOB_ATTEMPTS already, in which case
+ *              its output says how it crashed. Jobs it had claimed but not started are still
+ *              waiting anyway.
+ * Parameters: pool - the job pool
+ *             pid - the worker's process ID
+ *             status - the worker's status, from wait()
+ * Returns: none
+ */
+
+static void worker_crashed(struct Job_Pool *pool, pid_t pid, int status) {
+    for (long i = 0; i < pool->job_count; i++) {
+        struct Job *job = &pool->jobs[i];
+        if (atomic_load(&job->state) != Job_Running || job->worker != pid) { continue; }
+
+        if (job->attempts < JOB_ATTEMPTS) {
+            atomic_store(&job->state, Job_Waiting);
+        } else {
+            if (WIFSIGNALED(status)) {
+                snprintf(job->output, JOB_OUTPUT_SIZE, "error: the job crashed (signal %d)\n",
+                         WTERMSIG(status));
+            } else {
+                snprintf(job->output, JOB_OUTPUT_SIZE, "error: the job crashed (exit status %d)\n",
+                         WEXITSTATUS(status));
+            }
+            atomic_store(&job->state, Job_Done);
+        }
+    }
+}
+
+/*
+ * Function: job_pool_run(pool, workers, function, context, interrupted)
+ *
+ * Description: Runs every job in the pool across worker processes. This goes in rounds: each
+ *              round, the jobs not yet done are shared out among the workers, and a worker that
+ *              crashes is replaced by a new one so the round carries on at full speed. Jobs that
+ *              were running when a worker crashed are tried again in the next round.
+ *              If no worker can be started at all, the jobs are run in this process instead.
+ * Parameters: pool - the job pool
+ *             workers - the number of worker processes
+ *             function, context - what runs each job, in the workers
+ *             interrupted - if not NULL, no more jobs are started once it is set (e.g. by a signal
+ *                           handler, which should leave the workers running their current job).
+ *                           It is passed on to any worker still running if it is set here first.
+ * Returns: 0 on success, -1 if the jobs had to be run in this process
+ */
+
+int job_pool_run(struct Job_Pool *pool, int workers, Job_Function function, void *context,
+                 const volatile sig_atomic_t *interrupted) {
+    pid_t *pids = calloc(workers, sizeof(pid_t));
+    if (pids == NULL) { workers = 0; }
+    int in_process = 0;
+    long last_started = -1; // Job attempts started before the last round
+
+    while (!is_interrupted(interrupted)) {
+        pool->order_count = 0;
+        for (long i = 0; i < pool->job_count; i++) {
+            if (atomic_load(&pool->jobs[i].state) != Job_Done) {
+                pool->order[pool->order_count++] = i;
+            }
+        }
+        if (pool->order_count == 0) { break; }
+
+        // A round that doesn't start any job means the workers died before claiming one (rather
+        // than in one, which is counted against the job and retried), and would go round for
+        // ever. A round whose jobs all crash has still started them, so they get their retry.
+        long started = 0;
+        for (long i = 0; i < pool->job_count; i++) { started += pool->jobs[i].attempts; }
+        if (started == last_started) {
+            for (long i = 0; i < pool->order_count; i++) {
+                struct Job *job = &pool->jobs[pool->order[i]];
+                snprintf(job->output, JOB_OUTPUT_SIZE, "error: the job couldn't be run\n");
+                atomic_store(&job->state, Job_Done);
+            }
+            break;
+        }
+        last_started = started;
+
+        pool->chunk = pool->order_count / ((long)workers * CHUNKS_PER_WORKER + 1);
+        if (pool->chunk < 1) { pool->chunk = 1; }
+        atomic_store(&pool->next, 0);
+
+        int running = 0;
+        for (int w = 0; w < workers && w < pool->order_count; w++) {
+            pids[w] = start_worker(pool, function, context, interrupted);
+            if (pids[w] > 0) { running++; }
+        }
+        if (running == 0) {
+            run_worker(pool, function, context, interrupted);
+            in_process = 1;
+            continue;
+        }
+
+        int forwarded = 0;
+        while (running > 0) {
+            int status;
+            pid_t pid = wait(&status);
+            if (pid < 0) {
+                if (errno != EINTR) { break; }
+                // Interrupted while waiting: make sure the workers know, even if the signal was
+                // only sent to this process
+                if (is_interrupted(interrupted) && !forwarded) {
+                    for (int w = 0; w < workers; w++) {
+                        if (pids[w] > 0) { kill(pids[w], SIGINT); }
+                    }
+                    forwarded = 1;
+                }
+                continue;
+            }
+
+            int w = 0;
+            while (w < workers && pids[w] != pid) { w++; }
+            if (w == workers) { continue; } // not one of ours
+            pids[w] = 0;
+            running--;
+            // Even a worker that exited normally may have done so in the middle of a job (the job
+            // calling exit(), say), which would otherwise never be resolved
+            worker_crashed(pool, pid, status);
+            if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) { continue; }
+
+            if (atomic_load(&pool->next) < pool->order_count && !is_interrupted(interrupted)) {
+                pids[w] = start_worker(pool, function, context, interrupted);
+                if (pids[w] > 0) { running++; }
+            }
+        }
+    }
+
+    free(pids);
+    return in_process ? -1 : 0;
+}
+
+/*
+ * Function: job_pool_free(pool)
+ *
+ * Description: Unmaps a job pool's shared memory
+ * Parameters: pool - the job pool, or NULL
+ * Returns: none
+ */
+
+void job_pool_free(struct Job_Pool *pool) {
+    if (pool != NULL) { munmap(pool, pool->size); }
+}
@@ -0,0 +1,68 @@
+#ifndef WORKERS_H_INCLUDED
+#define WORKERS_H_INCLUDED // Include guards
+
+#include <stdio.h> // FILE
+#include <stdatomic.h>
+#include <signal.h> // sig_atomic_t
+#include <sys/types.h> // pid_t
+
+// ------ Worker processes ------
+// Runs a list of jobs (lines of a batch file) in several worker processes at once, rather than
+// threads, so that a job which crashes (or runs out of memory, or calls exit()) only takes its own
+// worker down with it. The jobs and their results live in memory shared between the processes:
+// workers claim jobs a few at a time by adding to a shared counter, and write each job's output
+// into its slot. The parent waits for the workers, starts a new worker in place of any that
+// crashed, and gives the job that was running when it crashed another go later (a job that
+// crashes every time gets an error as its output instead).
+
+// Most output a job can have (one line of results); a job with more gets an error instead
+#define JOB_OUTPUT_SIZE 256
+
+// Times a job is tried before it is given up on as crashing
+#define JOB_ATTEMPTS 2
+
+// --- Type declarations ---
+
+enum Job_State {
+    Job_Waiting = 0, // Not started (or to be tried again)
+    Job_Running, // Being run by the worker in Job.worker
+    Job_Done // Finished, with its output in Job.output
+};
+
+struct Job {
+    // The job's text, which lives in the parent's memory (workers get a copy when they're forked)
+    const char *line;
+    size_t length;
+
+    atomic_int state; // enum Job_State
+    pid_t worker; // The worker running it, while it's Job_Running
+    int attempts; // Number of times a worker has started it
+    char output[JOB_OUTPUT_SIZE];
+};
+
+// Shared between the parent and the workers
+struct Job_Pool {
+    long job_count;
+    struct Job *jobs;
+
+    // The jobs still to do this round (indexes into jobs), which the workers claim chunk jobs at a
+    // time, from next onwards
+    long *order;
+    long order_count;
+    long chunk;
+    atomic_long next;
+
+    size_t size; // Of the shared memory, including this
+};
+
+// Runs one job, writing its output to output
+typedef void (*Job_Function)(const char *line, size_t length, FILE *output, void *context);
+
+// --- Function declarations ---
+
+struct Job_Pool *job_pool_create(long job_count);
+int job_pool_run(struct Job_Pool *pool, int workers, Job_Function function, void *context,
+                 const volatile sig_atomic_t *interrupted);
+void job_pool_free(struct Job_Pool *pool);
+
+#endif